@@ -0,0 +1,273 @@
+#include "api_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+#include "base/memory/lock.h"
+
+namespace edgeview {
+
+namespace {
+
+constexpr size_t kKindCount = static_cast<size_t>(LatencyKind::kCount);
+
+const char* const kCategoryNames[] = {"exports", "events"};
+const char* const kKindNames[kKindCount] = {"queue_delay", "execution",
+                                            "total"};
+const double kPercentiles[] = {0.5, 0.9, 0.99};
+const char* const kPercentileNames[] = {"p50_us", "p90_us", "p99_us"};
+
+// Log bucketed histogram: 8 linear sub buckets per power of two, which keeps
+// the relative error of a reported value below 12.5% over the whole range.
+constexpr int kSubBucketBits = 3;
+constexpr uint64_t kSubBuckets = 1 << kSubBucketBits;
+constexpr size_t kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+size_t BucketFor(uint64_t value) {
+  if (value < kSubBuckets)
+    return static_cast<size_t>(value);
+
+  int msb = 63;
+  while (!(value >> msb))
+    --msb;
+  const uint64_t sub_bucket =
+      (value >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+  return (msb - kSubBucketBits + 1) * kSubBuckets + sub_bucket;
+}
+
+// Middle of the values counted in |bucket|
+double BucketValue(size_t bucket) {
+  if (bucket < kSubBuckets)
+    return static_cast<double>(bucket);
+
+  const int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+  const uint64_t lower = (kSubBuckets + bucket % kSubBuckets) << shift;
+  return lower + ((1ull << shift) - 1) / 2.0;
+}
+
+// Written by the owning thread only, read by GetStats
+struct Histogram {
+  std::atomic<uint32_t> buckets[kBucketCount]{};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> max{0};
+
+  void Record(uint64_t value) {
+    auto bump = [](auto& counter, uint64_t delta) {
+      counter.store(counter.load(std::memory_order_relaxed) + delta,
+                    std::memory_order_relaxed);
+    };
+
+    bump(buckets[BucketFor(value)], 1);
+    bump(count, 1);
+    bump(sum, value);
+    if (value > max.load(std::memory_order_relaxed))
+      max.store(value, std::memory_order_relaxed);
+  }
+};
+
+struct MergedHistogram {
+  uint64_t buckets[kBucketCount] = {};
+  uint64_t count = 0;
+  uint64_t sum = 0;
+  uint64_t max = 0;
+
+  void Add(const Histogram& histogram) {
+    for (size_t i = 0; i < kBucketCount; ++i)
+      buckets[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+    count += histogram.count.load(std::memory_order_relaxed);
+    sum += histogram.sum.load(std::memory_order_relaxed);
+    max = std::max<uint64_t>(max,
+                             histogram.max.load(std::memory_order_relaxed));
+  }
+
+  void Add(const MergedHistogram& other) {
+    for (size_t i = 0; i < kBucketCount; ++i)
+      buckets[i] += other.buckets[i];
+    count += other.count;
+    sum += other.sum;
+    max = std::max<uint64_t>(max, other.max);
+  }
+
+  json ToJSON() const {
+    json result = json::object();
+    result["count"] = count;
+    result["mean_us"] = count ? sum / 1000.0 / count : 0.0;
+    result["max_us"] = max / 1000.0;
+
+    for (size_t p = 0; p < std::size(kPercentiles); ++p) {
+      const uint64_t rank =
+          static_cast<uint64_t>(kPercentiles[p] * count + 0.5);
+      uint64_t seen = 0;
+      double value = 0;
+      for (size_t i = 0; i < kBucketCount && count; ++i) {
+        seen += buckets[i];
+        if (seen >= std::max<uint64_t>(rank, 1)) {
+          value = std::min<double>(BucketValue(i), max);
+          break;
+        }
+      }
+      result[kPercentileNames[p]] = value / 1000.0;
+    }
+
+    return result;
+  }
+};
+
+struct HistogramKey {
+  LatencyCategory category;
+  LatencyKind kind;
+  const char* name;
+
+  bool operator==(const HistogramKey& other) const {
+    return category == other.category && kind == other.kind &&
+           name == other.name;
+  }
+};
+
+struct HistogramKeyHash {
+  size_t operator()(const HistogramKey& key) const {
+    return std::hash<const char*>()(key.name) ^
+           (static_cast<size_t>(key.category) << 4 |
+            static_cast<size_t>(key.kind));
+  }
+};
+
+// Histograms of one thread. The map only changes on the owning thread, which
+// takes |lock| for that; readers on other threads take it to walk the map.
+struct ThreadShard {
+  base::Lock lock;
+  std::unordered_map<HistogramKey, std::unique_ptr<Histogram>, HistogramKeyHash>
+      histograms;
+
+  Histogram* Get(const HistogramKey& key) {
+    auto it = histograms.find(key);
+    if (it != histograms.end())
+      return it->second.get();
+
+    base::AutoLock auto_lock(lock);
+    return histograms.emplace(key, std::make_unique<Histogram>())
+        .first->second.get();
+  }
+};
+
+using MergedMap =
+    std::unordered_map<HistogramKey, MergedHistogram, HistogramKeyHash>;
+
+// Leaked, thread_local shard holders retire into these while the process
+// tears down, possibly after static destructors have already run.
+base::Lock& ShardsLock() {
+  static base::Lock* lock = new base::Lock("LatencyShards");
+  return *lock;
+}
+
+std::vector<ThreadShard*>& LiveShards() {
+  static std::vector<ThreadShard*>* shards = new std::vector<ThreadShard*>();
+  return *shards;
+}
+
+// Histograms of threads which already exited
+MergedMap& RetiredHistograms() {
+  static MergedMap* histograms = new MergedMap();
+  return *histograms;
+}
+
+class ThreadShardHolder {
+ public:
+  ThreadShardHolder() {
+    base::AutoLock auto_lock(ShardsLock());
+    LiveShards().push_back(&shard);
+  }
+
+  ~ThreadShardHolder() {
+    base::AutoLock auto_lock(ShardsLock());
+    for (const auto& it : shard.histograms)
+      RetiredHistograms()[it.first].Add(*it.second);
+
+    auto& live = LiveShards();
+    live.erase(std::remove(live.begin(), live.end(), &shard), live.end());
+  }
+
+  ThreadShard shard;
+};
+
+ThreadShard& CurrentShard() {
+  static thread_local ThreadShardHolder holder;
+  return holder.shard;
+}
+
+}  // namespace
+
+// "void __stdcall edgeview::GoBack(struct edgeview::BrowserData *)" and
+// "edgeview::Foo::<lambda_1>::operator ()(...)" -> "GoBack", "Foo"
+std::string ShortFunctionName(const char* function_name) {
+  std::string name = function_name;
+
+  size_t end = name.find("::<lambda");
+  if (end == std::string::npos)
+    end = name.find('(');
+  if (end != std::string::npos)
+    name.resize(end);
+
+  size_t begin = name.rfind("::");
+  if (begin != std::string::npos)
+    return name.substr(begin + 2);
+  begin = name.rfind(' ');
+  if (begin != std::string::npos)
+    return name.substr(begin + 1);
+
+  return name;
+}
+
+void RecordLatency(LatencyCategory category,
+                   const char* name,
+                   LatencyKind kind,
+                   int64_t nanoseconds) {
+  if (!name)
+    return;
+
+  CurrentShard()
+      .Get({category, kind, name})
+      ->Record(static_cast<uint64_t>(std::max<int64_t>(nanoseconds, 0)));
+}
+
+EV_EXPORTS(GetStats, LPCSTR)() {
+  MergedMap merged;
+  {
+    base::AutoLock auto_lock(ShardsLock());
+    merged = RetiredHistograms();
+    for (ThreadShard* shard : LiveShards()) {
+      base::AutoLock shard_lock(shard->lock);
+      for (const auto& it : shard->histograms)
+        merged[it.first].Add(*it.second);
+    }
+  }
+
+  // Different call sites may trim to the same name, merge them as well
+  std::map<std::string, MergedHistogram>
+      by_name[static_cast<size_t>(LatencyCategory::kCount)][kKindCount];
+  for (const auto& it : merged) {
+    by_name[static_cast<size_t>(it.first.category)]
+           [static_cast<size_t>(it.first.kind)]
+           [ShortFunctionName(it.first.name)]
+               .Add(it.second);
+  }
+
+  json stats = json::object();
+  for (size_t category = 0; category < std::size(by_name); ++category) {
+    json items = json::object();
+    for (size_t kind = 0; kind < kKindCount; ++kind) {
+      for (const auto& it : by_name[category][kind])
+        items[it.first][kKindNames[kind]] = it.second.ToJSON();
+    }
+    stats[kCategoryNames[category]] = std::move(items);
+  }
+  stats["hangs"] = GetHangStats();
+
+  return WrapComString(stats.dump().c_str());
+}
+
+}  // namespace edgeview
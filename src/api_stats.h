@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <string>
+#include <string_view>
+
+#include "cdp_recorder.h"
+#include "hang_watchdog.h"
+#include "trace_event.h"
+#include "util.h"
+
+namespace edgeview {
+
+// Where a latency sample comes from
+enum class LatencyCategory : uint8_t {
+  kExport = 0,  // Tasks posted by exports, keyed by the posting function
+  kEvent,       // BrowserEventDispatcher methods calling into the host
+  kCount,
+};
+
+enum class LatencyKind : uint8_t {
+  kQueueDelay = 0,  // Posted until the ui thread picks the task up
+  kExecution,       // Running on the ui thread
+  kTotal,           // Export entry until its sync wait returns
+  kCount,
+};
+
+inline int64_t LatencyNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Adds a sample to the histogram of the calling thread. |name| must be a
+// string with static storage, samples are keyed by its address.
+void RecordLatency(LatencyCategory category,
+                   const char* name,
+                   LatencyKind kind,
+                   int64_t nanoseconds);
+
+// Readable name of a std::source_location function name, which is what the
+// export samples are keyed by
+std::string ShortFunctionName(const char* function_name);
+
+// Times one dispatcher method, pass __func__ as |name|. Also shows up as a
+// slice of |browser| in the "host" trace category, and the hang watchdog
+// blames |name| and |browser| for stalls while it runs. Recorded in a
+// running CDP recording.
+class HostCallScope {
+ public:
+  HostCallScope(const char* name, const void* browser)
+      : HostCallScope(name, browser, std::string_view()) {}
+
+  // Methods delivering a WebView2 event also record its arguments, the
+  // JSON |args| returns, so a replay can make the call again. |args| only
+  // runs while recording.
+  template <std::invocable ArgsFunctor>
+  HostCallScope(const char* name, const void* browser, ArgsFunctor args)
+      : HostCallScope(name,
+                      browser,
+                      CDPRecording() ? args().dump() : std::string()) {}
+
+  HostCallScope(const char* name, const void* browser, std::string_view args)
+      : name(name), start(LatencyNow()), watched(HangWatchEnabled()) {
+    if (watched)
+      previous_call = EnterHostCall(name, browser);
+    if (CDPRecording())
+      RecordCDPTraffic(CDPRecordKind::kHostCall, browser, 0, name, {}, args);
+    AddTraceEvent('B', kTraceHostCalls, name, 0, browser);
+  }
+  ~HostCallScope() {
+    const int64_t elapsed = LatencyNow() - start;
+    RecordLatency(LatencyCategory::kEvent, name, LatencyKind::kExecution,
+                  elapsed);
+    if (watched)
+      LeaveHostCall(previous_call, name, elapsed);
+    AddTraceEvent('E', kTraceHostCalls, name);
+  }
+
+  HostCallScope(const HostCallScope&) = delete;
+  HostCallScope& operator=(const HostCallScope&) = delete;
+
+ private:
+  const char* name;
+  int64_t start;
+  const bool watched;
+  HostCallFrame previous_call;
+};
+
+// Histograms of every export and event seen so far, merged over all threads,
+// and the hang watchdog counts
+EV_EXPORTS(GetStats, LPCSTR)();
+
+}  // namespace edgeview
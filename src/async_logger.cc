@@ -0,0 +1,368 @@
+#include "async_logger.h"
+
+#include <algorithm>
+
+namespace edgeview {
+
+namespace {
+
+// Records per thread, about 64KB for every thread which logs
+constexpr uint32_t kRingSlots = 128;
+// Longer messages are cut
+constexpr size_t kMaxMessageSize = 480;
+// The writer wakes up at least this often to drain the rings
+constexpr DWORD kDrainIntervalMs = 50;
+
+const char* const kSeverityNames[] = {"INFO", "WARNING", "ERROR", "FATAL"};
+
+// Set while the thread is inside the logger, messages logged from there go
+// to the default destination instead of recursing
+thread_local bool in_logger = false;
+
+}  // namespace
+
+// Single producer (the owning thread), single consumer (whoever holds the
+// drain lock) ring of preformatted messages.
+class LogRing {
+ public:
+  struct Record {
+    int64_t time;  // FILETIME ticks, formatted by the writer
+    const char* file;
+    int line;
+    int severity;
+    uint32_t length;
+    char message[kMaxMessageSize];
+  };
+
+  LogRing() : thread_id(GetCurrentThreadId()) {}
+
+  // Returns the fill level after the push, or -1 when the ring was full
+  int Push(int severity,
+           const char* file,
+           int line,
+           const std::string& message) {
+    const uint32_t tail_pos = tail.load(std::memory_order_relaxed);
+    const uint32_t used = tail_pos - head.load(std::memory_order_acquire);
+    if (used >= kRingSlots) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return -1;
+    }
+
+    Record& record = slots[tail_pos % kRingSlots];
+    FILETIME now;
+    GetSystemTimePreciseAsFileTime(&now);
+    record.time = (static_cast<int64_t>(now.dwHighDateTime) << 32) |
+                  now.dwLowDateTime;
+    record.file = file;
+    record.line = line;
+    record.severity = severity;
+    record.length = static_cast<uint32_t>(
+        std::min<size_t>(message.size(), kMaxMessageSize));
+    memcpy(record.message, message.data(), record.length);
+
+    tail.store(tail_pos + 1, std::memory_order_release);
+    return static_cast<int>(used + 1);
+  }
+
+  // Calls |consumer| for every queued record, oldest first
+  template <typename Consumer>
+  void Consume(Consumer&& consumer) {
+    uint32_t head_pos = head.load(std::memory_order_relaxed);
+    const uint32_t tail_pos = tail.load(std::memory_order_acquire);
+
+    for (; head_pos != tail_pos; ++head_pos) {
+      consumer(slots[head_pos % kRingSlots]);
+      // Hand the slot back right away, the producer may be short of room
+      head.store(head_pos + 1, std::memory_order_release);
+    }
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_acquire) ==
+           tail.load(std::memory_order_acquire);
+  }
+
+  const DWORD thread_id;
+  std::atomic<uint64_t> dropped{0};
+  // Set by the owning thread while it checks |running| and pushes
+  std::atomic_bool pushing{false};
+  // Set when the owning thread exits, the writer frees the drained ring
+  std::atomic_bool orphaned{false};
+
+ private:
+  alignas(64) std::atomic<uint32_t> head{0};
+  alignas(64) std::atomic<uint32_t> tail{0};
+  Record slots[kRingSlots];
+};
+
+namespace {
+
+struct ThreadRing {
+  ~ThreadRing() {
+    if (ring)
+      ring->orphaned.store(true);
+  }
+
+  std::shared_ptr<LogRing> ring;
+};
+
+thread_local ThreadRing thread_ring;
+
+}  // namespace
+
+AsyncLogger* AsyncLogger::GetInstance() {
+  // Leaked on purpose, threads may still log during shutdown
+  static AsyncLogger* instance = new AsyncLogger();
+  return instance;
+}
+
+bool AsyncLogger::Start(const std::wstring& path,
+                        uint64_t max_size,
+                        int files) {
+  Stop();
+
+  FILE* new_file = _wfsopen(path.c_str(), L"ab", _SH_DENYWR);
+  if (!new_file)
+    return false;
+
+  {
+    base::AutoLock auto_lock(drain_lock);
+    file = new_file;
+    file_path = path;
+    _fseeki64(file, 0, SEEK_END);
+    file_size = _ftelli64(file);
+    max_file_size = max_size;
+    max_files = std::max<int>(files, 0);
+  }
+
+  if (!wake_event)
+    wake_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  running.store(true);
+  writer = std::thread(&AsyncLogger::WriterThread, this);
+
+  base::logging::SetLogMessageHandler(&AsyncLogger::HandleLogMessage);
+  return true;
+}
+
+void AsyncLogger::Stop() {
+  if (!running.exchange(false))
+    return;
+
+  // Late messages go to the default destination again
+  base::logging::SetLogMessageHandler(nullptr);
+
+  SetEvent(wake_event);
+  writer.join();
+
+  // A producer which saw |running| before it was cleared may still be
+  // pushing, its record goes into the last drain
+  {
+    base::AutoLock auto_lock(rings_lock);
+    for (const auto& ring : rings) {
+      while (ring->pushing.load())
+        std::this_thread::yield();
+    }
+  }
+  Drain();
+
+  base::AutoLock auto_lock(drain_lock);
+  if (file)
+    fclose(file);
+  file = nullptr;
+}
+
+void AsyncLogger::Flush() {
+  Drain();
+}
+
+json AsyncLogger::GetStats() {
+  uint64_t dropped = retired_dropped.load() + discarded.load();
+  size_t ring_count = 0;
+  {
+    base::AutoLock auto_lock(rings_lock);
+    for (const auto& ring : rings)
+      dropped += ring->dropped.load(std::memory_order_relaxed);
+    ring_count = rings.size();
+  }
+
+  json stats = json::object();
+  stats["running"] = running.load();
+  stats["written"] = written.load();
+  stats["written_bytes"] = written_bytes.load();
+  stats["dropped"] = dropped;
+  stats["rotations"] = rotations.load();
+  stats["rings"] = ring_count;
+
+  return stats;
+}
+
+// static
+bool AsyncLogger::HandleLogMessage(int severity,
+                                   const char* file,
+                                   int line,
+                                   const std::string& message) {
+  if (in_logger)
+    return false;
+
+  AsyncLogger* self = GetInstance();
+  if (!self->running.load(std::memory_order_relaxed))
+    return false;
+
+  in_logger = true;
+  LogRing* ring = self->CurrentRing();
+  // Announced before the check, Stop waits for it before the last drain
+  ring->pushing.store(true);
+  if (!self->running.load()) {
+    ring->pushing.store(false);
+    in_logger = false;
+    return false;
+  }
+
+  int fill = ring->Push(severity, file, line, message);
+  ring->pushing.store(false, std::memory_order_release);
+  if (severity >= base::logging::LOG_FATAL) {
+    // Nothing queued may get lost if the process goes down after this
+    self->Flush();
+  } else if (fill < 0 || fill >= static_cast<int>(kRingSlots / 2) ||
+             severity >= base::logging::LOG_ERROR) {
+    SetEvent(self->wake_event);
+  }
+  in_logger = false;
+
+  return true;
+}
+
+LogRing* AsyncLogger::CurrentRing() {
+  if (!thread_ring.ring) {
+    thread_ring.ring = std::make_shared<LogRing>();
+
+    base::AutoLock auto_lock(rings_lock);
+    rings.push_back(thread_ring.ring);
+  }
+
+  return thread_ring.ring.get();
+}
+
+void AsyncLogger::WriterThread() {
+  in_logger = true;
+  while (running.load()) {
+    WaitForSingleObject(wake_event, kDrainIntervalMs);
+    Drain();
+  }
+}
+
+void AsyncLogger::Drain() {
+  // A FATAL logged by the draining thread itself must not wait for itself
+  const bool nested = in_logger;
+  in_logger = true;
+
+  std::vector<std::shared_ptr<LogRing>> snapshot;
+  {
+    base::AutoLock auto_lock(rings_lock);
+    snapshot = rings;
+  }
+
+  {
+    base::AutoLock auto_lock(drain_lock);
+
+    size_t count = 0;
+    for (const auto& ring : snapshot) {
+      ring->Consume([this, &ring, &count](const LogRing::Record& record) {
+        // Reopening the file failed after a rotation
+        if (!file) {
+          discarded.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        ++count;
+
+        FILETIME utc_time, local_time;
+        utc_time.dwHighDateTime = static_cast<DWORD>(record.time >> 32);
+        utc_time.dwLowDateTime = static_cast<DWORD>(record.time);
+        SYSTEMTIME time;
+        FileTimeToLocalFileTime(&utc_time, &local_time);
+        FileTimeToSystemTime(&local_time, &time);
+
+        const int severity_index = std::clamp(record.severity, 0, 3);
+        LPCSTR file_name = record.file ? PathFindFileNameA(record.file) : "";
+
+        int header_size = fprintf(
+            file, "[%04d-%02d-%02d %02d:%02d:%02d.%03d][%lu][%s:%s(%d)] ",
+            time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute,
+            time.wSecond, time.wMilliseconds, ring->thread_id,
+            record.severity < 0 ? "VERBOSE" : kSeverityNames[severity_index],
+            file_name, record.line);
+        fwrite(record.message, 1, record.length, file);
+        fputc('\n', file);
+
+        const uint64_t size =
+            std::max<int>(header_size, 0) + uint64_t{record.length} + 1;
+        file_size += size;
+        written_bytes.fetch_add(size, std::memory_order_relaxed);
+
+        RotateIfNeeded();
+      });
+    }
+
+    if (count) {
+      written.fetch_add(count, std::memory_order_relaxed);
+      if (file)
+        fflush(file);
+    }
+  }
+
+  // Rings of exited threads go away once drained
+  {
+    base::AutoLock auto_lock(rings_lock);
+    auto it = std::remove_if(rings.begin(), rings.end(),
+                             [this](const std::shared_ptr<LogRing>& ring) {
+                               if (!ring->orphaned.load() || !ring->empty())
+                                 return false;
+                               retired_dropped.fetch_add(ring->dropped.load());
+                               return true;
+                             });
+    rings.erase(it, rings.end());
+  }
+
+  in_logger = nested;
+}
+
+void AsyncLogger::RotateIfNeeded() {
+  if (!max_file_size || file_size < max_file_size)
+    return;
+
+  fclose(file);
+  file = nullptr;
+
+  // path.N-1 -> path.N ... path -> path.1, the oldest one falls off
+  for (int i = max_files - 1; i >= 0; --i) {
+    std::wstring from = i ? file_path + L"." + std::to_wstring(i) : file_path;
+    std::wstring to = file_path + L"." + std::to_wstring(i + 1);
+    MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING);
+  }
+  if (!max_files)
+    DeleteFileW(file_path.c_str());
+
+  file = _wfsopen(file_path.c_str(), L"ab", _SH_DENYWR);
+  file_size = 0;
+  rotations.fetch_add(1, std::memory_order_relaxed);
+}
+
+EV_EXPORTS(SetLogFile, BOOL)(LPCSTR path, uint32_t max_size, int max_files) {
+  if (!path || !*path) {
+    AsyncLogger::GetInstance()->Stop();
+    return TRUE;
+  }
+
+  return AsyncLogger::GetInstance()->Start(Utf8Conv::Utf8ToUtf16(path),
+                                           max_size, max_files);
+}
+
+EV_EXPORTS(FlushLog, void)() {
+  AsyncLogger::GetInstance()->Flush();
+}
+
+EV_EXPORTS(GetLogStats, LPCSTR)() {
+  return WrapComString(AsyncLogger::GetInstance()->GetStats().dump().c_str());
+}
+
+}  // namespace edgeview
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "base/memory/lock.h"
+#include "util.h"
+
+namespace edgeview {
+
+class LogRing;
+
+// Background sink for base LOG(). A producer copies the message into a ring
+// owned by its thread and returns, a writer thread drains the rings into a
+// size rotated file and formats the record header there. Messages which find
+// their ring full, or are drained while the rotated file cannot be reopened,
+// are dropped and counted. FATAL messages flush everything queued before the
+// calling thread continues.
+class AsyncLogger {
+ public:
+  static AsyncLogger* GetInstance();
+
+  AsyncLogger(const AsyncLogger&) = delete;
+  AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+  // Replaces the running sink, if any. |max_files| rotated files are kept
+  // next to |path| as path.1 ... path.N.
+  bool Start(const std::wstring& path, uint64_t max_size, int files);
+  void Stop();
+
+  // Writes out everything queued so far on the calling thread
+  void Flush();
+
+  json GetStats();
+
+ private:
+  AsyncLogger() = default;
+  ~AsyncLogger() = default;
+
+  static bool HandleLogMessage(int severity,
+                               const char* file,
+                               int line,
+                               const std::string& message);
+
+  LogRing* CurrentRing();
+  void WriterThread();
+
+  // Drains every ring into the file, |drain_lock| serializes the consumers
+  void Drain();
+  void RotateIfNeeded();
+
+  std::atomic_bool running{false};
+  std::thread writer;
+  // Created by the first Start and kept, producers may still signal it
+  HANDLE wake_event = nullptr;
+
+  base::Lock rings_lock{"LogRings"};
+  std::vector<std::shared_ptr<LogRing>> rings;
+
+  base::Lock drain_lock{"LogDrain"};
+  FILE* file = nullptr;
+  std::wstring file_path;
+  uint64_t file_size = 0;
+  uint64_t max_file_size = 0;
+  int max_files = 0;
+
+  std::atomic<uint64_t> written{0};
+  std::atomic<uint64_t> written_bytes{0};
+  // Drops of rings already released with their thread
+  std::atomic<uint64_t> retired_dropped{0};
+  // Records drained while no file was open
+  std::atomic<uint64_t> discarded{0};
+  std::atomic<uint64_t> rotations{0};
+};
+
+EV_EXPORTS(SetLogFile, BOOL)(LPCSTR path, uint32_t max_size, int max_files);
+EV_EXPORTS(FlushLog, void)();
+EV_EXPORTS(GetLogStats, LPCSTR)();
+
+}  // namespace edgeview
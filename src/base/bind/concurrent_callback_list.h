@@ -0,0 +1,242 @@
+#ifndef BASE_BIND_CONCURRENT_CALLBACK_LIST_H_
+#define BASE_BIND_CONCURRENT_CALLBACK_LIST_H_
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "base/bind/callback.h"
+#include "base/memory/lock.h"
+#include "base/memory/ref_counted.h"
+
+namespace base {
+
+template <typename Signature>
+class ConcurrentCallbackList;
+
+// Multi subscriber list which can be notified from any thread. Notify() walks
+// an immutable snapshot of the callbacks without taking a lock, Add() and
+// dropping a subscription copy the snapshot and publish the new one. Callbacks
+// may subscribe and unsubscribe freely while a notification is running.
+//
+// Readers announce the snapshot they walk in a hazard slot. A replaced
+// snapshot is deleted by the next writer which finds no slot pointing at it.
+// When every slot is taken (deeply nested or very many concurrent
+// notifications) the reader copies the snapshot under the writer lock
+// instead of waiting for a slot.
+//
+// Removal is not synchronous with running notifications: one that already
+// took its snapshot may still run a callback whose subscription just went
+// away, the callback has to cope with that (bind a WeakPtr or refptr).
+template <typename... Args>
+class ConcurrentCallbackList<void(Args...)> {
+ public:
+  using CallbackType = RepeatingCallback<void(Args...)>;
+
+ private:
+  class Core;
+
+ public:
+  // Unsubscribes on destruction. May outlive the list.
+  class Subscription {
+   public:
+    Subscription() = default;
+    Subscription(Subscription&& other) noexcept
+        : core(std::move(other.core)), id(other.id) {}
+    Subscription& operator=(Subscription&& other) noexcept {
+      if (this != &other) {
+        Reset();
+        core = std::move(other.core);
+        id = other.id;
+      }
+      return *this;
+    }
+    ~Subscription() { Reset(); }
+
+    Subscription(const Subscription&) = delete;
+    Subscription& operator=(const Subscription&) = delete;
+
+    explicit operator bool() const { return !!core; }
+
+    void Reset() {
+      if (core) {
+        core->Remove(id);
+        core = nullptr;
+      }
+    }
+
+   private:
+    friend class ConcurrentCallbackList;
+
+    Subscription(scoped_refptr<Core> core, uint64_t id)
+        : core(std::move(core)), id(id) {}
+
+    scoped_refptr<Core> core;
+    uint64_t id = 0;
+  };
+
+  ConcurrentCallbackList() : core(new Core()) {}
+
+  ConcurrentCallbackList(const ConcurrentCallbackList&) = delete;
+  ConcurrentCallbackList& operator=(const ConcurrentCallbackList&) = delete;
+
+  [[nodiscard]] Subscription Add(CallbackType callback) {
+    if (callback.is_null())
+      return Subscription();
+
+    return Subscription(core, core->Add(std::move(callback)));
+  }
+
+  bool empty() const { return core->empty(); }
+
+  // Arguments are passed by reference to every callback, like
+  // RepeatingCallbackList::Notify().
+  template <typename... RunArgs>
+  void Notify(RunArgs&&... args) {
+    // A callback may destroy the list, keep the core alive until the end
+    scoped_refptr<Core> notify_core = core;
+    notify_core->Notify(args...);
+  }
+
+ private:
+  class Core : public RefCountedThreadSafe<Core> {
+   public:
+    Core() : current(new Snapshot()) {}
+
+    Core(const Core&) = delete;
+    Core& operator=(const Core&) = delete;
+
+    uint64_t Add(CallbackType callback) {
+      AutoLock auto_lock(write_lock);
+
+      Snapshot* next = new Snapshot(*current.load());
+      const uint64_t id = next_id++;
+      next->push_back({id, std::move(callback)});
+      Publish(next);
+
+      return id;
+    }
+
+    void Remove(uint64_t id) {
+      AutoLock auto_lock(write_lock);
+
+      const Snapshot* snapshot = current.load();
+      auto it =
+          std::find_if(snapshot->begin(), snapshot->end(),
+                       [id](const Entry& entry) { return entry.id == id; });
+      if (it == snapshot->end())
+        return;
+
+      Snapshot* next = new Snapshot();
+      next->reserve(snapshot->size() - 1);
+      for (const Entry& entry : *snapshot) {
+        if (entry.id != id)
+          next->push_back(entry);
+      }
+      Publish(next);
+    }
+
+    bool empty() const { return current.load()->empty(); }
+
+    template <typename... RunArgs>
+    void Notify(RunArgs&... args) {
+      std::atomic<const Snapshot*>* slot = AcquireSlot();
+      if (!slot) {
+        Snapshot snapshot;
+        {
+          AutoLock auto_lock(write_lock);
+          snapshot = *current.load();
+        }
+
+        for (const Entry& entry : snapshot)
+          entry.callback.Run(args...);
+        return;
+      }
+
+      // Announce the snapshot, then make sure it was not replaced in between:
+      // a writer retiring it afterwards is bound to see the slot.
+      const Snapshot* snapshot = nullptr;
+      do {
+        snapshot = current.load();
+        slot->store(snapshot);
+      } while (snapshot != current.load());
+
+      for (const Entry& entry : *snapshot)
+        entry.callback.Run(args...);
+
+      slot->store(nullptr, std::memory_order_release);
+    }
+
+   private:
+    friend class RefCountedThreadSafe<Core>;
+
+    struct Entry {
+      uint64_t id;
+      CallbackType callback;
+    };
+    using Snapshot = std::vector<Entry>;
+
+    // Lock free notifications per list, further ones copy the snapshot
+    static constexpr size_t kHazardSlots = 64;
+
+    ~Core() {
+      delete current.load();
+      for (const Snapshot* snapshot : retired)
+        delete snapshot;
+    }
+
+    // Marks a slot as taken before the reader stores its snapshot in it
+    static const Snapshot* ReservedSlot() {
+      static const Snapshot reserved;
+      return &reserved;
+    }
+
+    // Null when every slot is taken
+    std::atomic<const Snapshot*>* AcquireSlot() {
+      for (auto& slot : hazards) {
+        const Snapshot* expected = nullptr;
+        if (!slot.load(std::memory_order_relaxed) &&
+            slot.compare_exchange_strong(expected, ReservedSlot()))
+          return &slot;
+      }
+      return nullptr;
+    }
+
+    // |write_lock| must be held
+    void Publish(const Snapshot* next) {
+      retired.push_back(current.exchange(next));
+
+      std::vector<const Snapshot*> in_use;
+      for (const auto& slot : hazards) {
+        const Snapshot* snapshot = slot.load();
+        if (snapshot && snapshot != ReservedSlot())
+          in_use.push_back(snapshot);
+      }
+
+      auto it = std::remove_if(
+          retired.begin(), retired.end(), [&in_use](const Snapshot* snapshot) {
+            if (std::find(in_use.begin(), in_use.end(), snapshot) !=
+                in_use.end())
+              return false;
+            delete snapshot;
+            return true;
+          });
+      retired.erase(it, retired.end());
+    }
+
+    std::atomic<const Snapshot*> current;
+    std::atomic<const Snapshot*> hazards[kHazardSlots] = {};
+
+    Lock write_lock{"ConcurrentCallbackList"};
+    // Replaced snapshots a reader may still walk, guarded by |write_lock|
+    std::vector<const Snapshot*> retired;
+    uint64_t next_id = 1;
+  };
+
+  scoped_refptr<Core> core;
+};
+
+}  // namespace base
+
+#endif  // BASE_BIND_CONCURRENT_CALLBACK_LIST_H_
@@ -0,0 +1,92 @@
+// ConcurrentCallbackList notification cost against
+// base::RepeatingCallbackList (BM_CallbackListNotify in core_perftest.cc),
+// from one thread, from several threads at once and while another thread
+// keeps subscribing and unsubscribing.
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <vector>
+
+#include "base/bind/bind.h"
+#include "base/bind/concurrent_callback_list.h"
+
+namespace base {
+
+namespace {
+
+using IntList = ConcurrentCallbackList<void(int)>;
+
+class Counter : public RefCountedThreadSafe<Counter> {
+ public:
+  void Add(int value) { total.fetch_add(value, std::memory_order_relaxed); }
+
+  std::atomic<int64_t> total{0};
+
+ private:
+  friend class RefCountedThreadSafe<Counter>;
+  ~Counter() = default;
+};
+
+void BM_ConcurrentCallbackListNotify(benchmark::State& state) {
+  auto counter = MakeRefCounted<Counter>();
+  IntList list;
+  std::vector<IntList::Subscription> subscriptions;
+  for (int64_t i = 0; i < state.range(0); ++i)
+    subscriptions.push_back(list.Add(BindRepeating(&Counter::Add, counter)));
+
+  for (auto _ : state)
+    list.Notify(1);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ConcurrentCallbackListNotify)->Arg(1)->Arg(8)->Arg(64);
+
+// Leaked, shared by every thread of every run
+IntList* SharedList() {
+  static IntList* list = [] {
+    static auto* counter = new Counter();
+    counter->AddRef();
+    auto* list = new IntList();
+    for (int i = 0; i < 8; ++i) {
+      new IntList::Subscription(
+          list->Add(BindRepeating(&Counter::Add, counter)));
+    }
+    return list;
+  }();
+  return list;
+}
+
+void BM_ConcurrentCallbackListSharedNotify(benchmark::State& state) {
+  IntList* list = SharedList();
+  for (auto _ : state)
+    list->Notify(1);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ConcurrentCallbackListSharedNotify)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+// Thread 0 subscribes and unsubscribes, the others notify
+void BM_ConcurrentCallbackListNotifyWhileSubscribing(benchmark::State& state) {
+  IntList* list = SharedList();
+  if (state.thread_index() == 0) {
+    auto counter = MakeRefCounted<Counter>();
+    for (auto _ : state) {
+      IntList::Subscription subscription =
+          list->Add(BindRepeating(&Counter::Add, counter));
+      benchmark::DoNotOptimize(subscription);
+    }
+    return;
+  }
+
+  for (auto _ : state)
+    list->Notify(1);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ConcurrentCallbackListNotifyWhileSubscribing)
+    ->ThreadRange(2, 8)
+    ->UseRealTime();
+
+}  // namespace
+
+}  // namespace base
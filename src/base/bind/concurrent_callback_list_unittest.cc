@@ -0,0 +1,178 @@
+#include "base/bind/concurrent_callback_list.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "base/bind/bind.h"
+#include "gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+using IntList = ConcurrentCallbackList<void(int)>;
+
+class Counter : public RefCountedThreadSafe<Counter> {
+ public:
+  void Add(int value) { total += value; }
+
+  std::atomic<int64_t> total{0};
+
+ private:
+  friend class RefCountedThreadSafe<Counter>;
+  ~Counter() = default;
+};
+
+TEST(ConcurrentCallbackListTest, NotifiesEverySubscriber) {
+  auto first = MakeRefCounted<Counter>();
+  auto second = MakeRefCounted<Counter>();
+  IntList list;
+  EXPECT_TRUE(list.empty());
+
+  IntList::Subscription a = list.Add(BindRepeating(&Counter::Add, first));
+  IntList::Subscription b = list.Add(BindRepeating(&Counter::Add, second));
+  EXPECT_FALSE(list.empty());
+
+  list.Notify(3);
+  EXPECT_EQ(3, first->total);
+  EXPECT_EQ(3, second->total);
+}
+
+TEST(ConcurrentCallbackListTest, NullCallbackIsNotAdded) {
+  IntList list;
+  IntList::Subscription subscription = list.Add(IntList::CallbackType());
+  EXPECT_FALSE(subscription);
+  EXPECT_TRUE(list.empty());
+}
+
+TEST(ConcurrentCallbackListTest, ResetUnsubscribes) {
+  auto counter = MakeRefCounted<Counter>();
+  IntList list;
+  IntList::Subscription subscription =
+      list.Add(BindRepeating(&Counter::Add, counter));
+
+  subscription.Reset();
+  EXPECT_TRUE(list.empty());
+  list.Notify(1);
+  EXPECT_EQ(0, counter->total);
+}
+
+TEST(ConcurrentCallbackListTest, SubscriptionOutlivesList) {
+  auto counter = MakeRefCounted<Counter>();
+  IntList::Subscription subscription;
+  {
+    IntList list;
+    subscription = list.Add(BindRepeating(&Counter::Add, counter));
+  }
+  subscription.Reset();
+  EXPECT_FALSE(subscription);
+}
+
+TEST(ConcurrentCallbackListTest, ChangesDuringNotifyApplyToTheNextOne) {
+  auto counter = MakeRefCounted<Counter>();
+  IntList list;
+  IntList::Subscription added;
+  IntList::Subscription self;
+  self = list.Add(BindRepeating(
+      [](IntList* list, IntList::Subscription* self,
+         IntList::Subscription* added, scoped_refptr<Counter> counter,
+         int) {
+        *added = list->Add(BindRepeating(&Counter::Add, counter));
+        self->Reset();
+      },
+      &list, &self, &added, counter));
+
+  list.Notify(1);
+  EXPECT_EQ(0, counter->total);
+  EXPECT_FALSE(self);
+
+  list.Notify(1);
+  EXPECT_EQ(1, counter->total);
+}
+
+// Nesting deeper than the hazard slots falls back to copied snapshots
+TEST(ConcurrentCallbackListTest, NestedNotifyBeyondHazardSlots) {
+  constexpr int kDepth = 200;
+  IntList list;
+  int calls = 0;
+  IntList::Subscription subscription = list.Add(BindRepeating(
+      [](IntList* list, int* calls, int depth) {
+        ++*calls;
+        if (depth < kDepth)
+          list->Notify(depth + 1);
+      },
+      &list, &calls));
+
+  list.Notify(1);
+  EXPECT_EQ(kDepth, calls);
+}
+
+// Notifying threads race subscribing and unsubscribing threads. The
+// permanent subscriber must see every notification, the churning ones must
+// not crash or leak (run under ASan/TSan for the full check).
+TEST(ConcurrentCallbackListTest, StressNotifyWhileSubscribing) {
+  constexpr int kNotifiers = 4;
+  constexpr int kWriters = 2;
+  constexpr int kNotifies = 5000;
+
+  auto permanent = MakeRefCounted<Counter>();
+  auto churn = MakeRefCounted<Counter>();
+  IntList list;
+  IntList::Subscription subscription =
+      list.Add(BindRepeating(&Counter::Add, permanent));
+
+  std::atomic<int> notifiers_left{kNotifiers};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNotifiers; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < kNotifies; ++j)
+        list.Notify(1);
+      --notifiers_left;
+    });
+  }
+  for (int i = 0; i < kWriters; ++i) {
+    threads.emplace_back([&] {
+      std::vector<IntList::Subscription> subscriptions;
+      while (notifiers_left.load()) {
+        subscriptions.push_back(
+            list.Add(BindRepeating(&Counter::Add, churn)));
+        if (subscriptions.size() > 8)
+          subscriptions.erase(subscriptions.begin());
+      }
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(kNotifiers * kNotifies, permanent->total);
+  EXPECT_FALSE(list.empty());
+}
+
+// More concurrent notifications than hazard slots, all blocked inside a
+// callback until every one started
+TEST(ConcurrentCallbackListTest, StressMoreNotifiersThanHazardSlots) {
+  constexpr int kNotifiers = 80;
+
+  IntList list;
+  std::atomic<int> inside{0};
+  IntList::Subscription subscription = list.Add(BindRepeating(
+      [](std::atomic<int>* inside, int) {
+        ++*inside;
+        while (inside->load() < kNotifiers)
+          std::this_thread::yield();
+      },
+      &inside));
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNotifiers; ++i)
+    threads.emplace_back([&list] { list.Notify(1); });
+  for (std::thread& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(kNotifiers, inside.load());
+}
+
+}  // namespace
+
+}  // namespace base
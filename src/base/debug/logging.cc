@@ -5,6 +5,7 @@
 
 #include "base/debug/logging.h"
 
+#include <atomic>
 #include <iostream>
 
 #if defined(OS_WIN)
@@ -163,9 +164,29 @@ LogMessage::LogMessage(const char* file, int line, LogSeverity severity,
   delete result;
 }
 
+namespace {
+
+std::atomic<LogMessageHandlerFunction> g_log_message_handler{nullptr};
+
+}  // namespace
+
+void SetLogMessageHandler(LogMessageHandlerFunction handler) {
+  g_log_message_handler.store(handler);
+}
+
+LogMessageHandlerFunction GetLogMessageHandler() {
+  return g_log_message_handler.load();
+}
+
 LogMessage::~LogMessage() {
   std::string str_newline(stream_.str());
 
+  // Give any log message handler first dibs on the message.
+  LogMessageHandlerFunction handler =
+      g_log_message_handler.load(std::memory_order_acquire);
+  if (handler && handler(severity_, file_, line_, str_newline))
+    return;
+
   if (severity_ >= LOG_ERROR) {
     std::cout << "[ELOG] File: " << file_ << "\nLine: " << line_
               << "\nLevel: " << severity_ << "\nInfo: " << str_newline << '\n';
@@ -203,6 +203,17 @@ int GetVlogLevel(const char (&file)[N]) {
 // Gets the current log level.
 inline int GetMinLogLevel() { return ::base::logging::LOG_INFO; }
 
+// Sets the Log Message Handler that gets passed every log message before
+// it's sent to other log destinations (if any).
+// Returns true to signal that it handled the message and the message
+// should not be sent to other log destinations.
+typedef bool (*LogMessageHandlerFunction)(int severity,
+                                          const char* file,
+                                          int line,
+                                          const std::string& str);
+void SetLogMessageHandler(LogMessageHandlerFunction handler);
+LogMessageHandlerFunction GetLogMessageHandler();
+
 // LOG_DFATAL is LOG_FATAL in debug mode, ERROR in normal mode
 #ifdef NDEBUG
 const LogSeverity LOG_DFATAL = LOG_ERROR;
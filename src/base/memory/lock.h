@@ -35,12 +35,68 @@
 // If the Chromium implementation diverges the below implementation should be
 // updated to match.
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "base/debug/logging.h"
 #include "base/memory/lock_impl.h"
 
 namespace base {
+
+///
+/// Contention counters of one named lock, see GetLockContentionStats().
+///
+struct LockContentionStats {
+  std::string name;
+  // "exclusive" or "shared"
+  std::string mode;
+  uint64_t acquisitions;
+  // Acquisitions which had to wait for another holder
+  uint64_t contended;
+  // Total time spent waiting in contended acquisitions
+  uint64_t wait_ns;
+};
+
+///
+/// Turns counting on or off for every named lock. Off by default, unnamed
+/// locks are never counted.
+///
+void SetLockContentionTracking(bool enable);
+
+///
+/// Returns the counters of all live named locks. Locks sharing a name are
+/// listed separately.
+///
+std::vector<LockContentionStats> GetLockContentionStats();
+
 namespace internal {
 
+class LockCounters {
+ public:
+  LockCounters(const char* name, const char* mode);
+
+  LockCounters(const LockCounters&) = delete;
+  LockCounters& operator=(const LockCounters&) = delete;
+
+  ~LockCounters();
+
+  static bool IsTracking();
+
+  void Record(bool contended, uint64_t wait_ns);
+
+ private:
+  friend std::vector<LockContentionStats> base::GetLockContentionStats();
+
+  const char* name_;
+  const char* mode_;
+  std::atomic<uint64_t> acquisitions_{0};
+  std::atomic<uint64_t> contended_{0};
+  std::atomic<uint64_t> wait_ns_{0};
+};
+
 ///
 /// A convenient wrapper for an OS specific critical section.  The only real
 /// intelligence in this class is in debug mode for the support for the
@@ -50,11 +106,28 @@ class Lock {
  public:
   Lock() : lock_() {}
 
+  ///
+  /// Named locks count their acquisitions while contention tracking is on.
+  /// |name| must outlive the lock.
+  ///
+  explicit Lock(const char* name, LockMode mode = LockMode::kDefault)
+      : lock_(mode),
+        counters_(std::make_unique<LockCounters>(name, "exclusive")) {}
+
   Lock(const Lock&) = delete;
   Lock& operator=(const Lock&) = delete;
 
   ~Lock() {}
-  void Acquire() { lock_.Lock(); }
+
+  ///
+  /// Blocks while the lock is held. Adaptive locks spin for a short while
+  /// first.
+  ///
+  void Acquire() {
+    if (counters_ && LockCounters::IsTracking())
+      return AcquireTracked();
+    lock_.Lock();
+  }
   void Release() { lock_.Unlock(); }
 
   ///
@@ -66,8 +139,60 @@ class Lock {
   bool Try() { return lock_.Try(); }
 
  private:
+  void AcquireTracked();
+
   // Platform specific underlying lock implementation.
   LockImpl lock_;
+
+  std::unique_ptr<LockCounters> counters_;
+};
+
+///
+/// Reader-writer lock, for data read from many threads and rarely written.
+/// Not recursive: a thread holding the lock must not acquire it again in
+/// either mode.
+///
+class RWLock {
+ public:
+  RWLock() : lock_() {}
+
+  ///
+  /// Named locks count shared and exclusive acquisitions separately while
+  /// contention tracking is on. |name| must outlive the lock.
+  ///
+  explicit RWLock(const char* name, LockMode mode = LockMode::kDefault)
+      : lock_(mode),
+        read_counters_(std::make_unique<LockCounters>(name, "shared")),
+        write_counters_(std::make_unique<LockCounters>(name, "exclusive")) {}
+
+  RWLock(const RWLock&) = delete;
+  RWLock& operator=(const RWLock&) = delete;
+
+  ~RWLock() {}
+
+  void ReadAcquire() {
+    if (read_counters_ && LockCounters::IsTracking())
+      return ReadAcquireTracked();
+    lock_.ReadLock();
+  }
+  void ReadRelease() { lock_.ReadUnlock(); }
+
+  void WriteAcquire() {
+    if (write_counters_ && LockCounters::IsTracking())
+      return WriteAcquireTracked();
+    lock_.WriteLock();
+  }
+  void WriteRelease() { lock_.WriteUnlock(); }
+
+ private:
+  void ReadAcquireTracked();
+  void WriteAcquireTracked();
+
+  // Platform specific underlying lock implementation.
+  RWLockImpl lock_;
+
+  std::unique_ptr<LockCounters> read_counters_;
+  std::unique_ptr<LockCounters> write_counters_;
 };
 
 ///
@@ -110,14 +235,50 @@ class AutoUnlock {
   Lock& lock_;
 };
 
+///
+/// Holds a RWLock in shared mode while in scope.
+///
+class AutoReadLock {
+ public:
+  explicit AutoReadLock(RWLock& lock) : lock_(lock) { lock_.ReadAcquire(); }
+
+  AutoReadLock(const AutoReadLock&) = delete;
+  AutoReadLock& operator=(const AutoReadLock&) = delete;
+
+  ~AutoReadLock() { lock_.ReadRelease(); }
+
+ private:
+  RWLock& lock_;
+};
+
+///
+/// Holds a RWLock in exclusive mode while in scope.
+///
+class AutoWriteLock {
+ public:
+  explicit AutoWriteLock(RWLock& lock) : lock_(lock) { lock_.WriteAcquire(); }
+
+  AutoWriteLock(const AutoWriteLock&) = delete;
+  AutoWriteLock& operator=(const AutoWriteLock&) = delete;
+
+  ~AutoWriteLock() { lock_.WriteRelease(); }
+
+ private:
+  RWLock& lock_;
+};
+
 }  // namespace internal
 
 // Implement classes in the internal namespace and then expose them to the
 // base namespace. This avoids conflicts with the base.lib implementation when
 // linking sandbox support on Windows.
 using internal::AutoLock;
+using internal::AutoReadLock;
 using internal::AutoUnlock;
+using internal::AutoWriteLock;
 using internal::Lock;
+using internal::LockMode;
+using internal::RWLock;
 
 }  // namespace base
 
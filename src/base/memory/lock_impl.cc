@@ -4,14 +4,46 @@
 
 #include "base/memory/lock_impl.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "base/memory/lock.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+// Polls of adaptive locks before parking. Where the lock state can be read
+// without writing, spinners only attempt the atomic acquire once it looks
+// free (test and test and set), so waiting threads do not keep stealing the
+// cache line from the holder.
+constexpr int kSpinCount = 100;
+
+inline void SpinPause() {
+#if defined(OS_WIN)
+  YieldProcessor();
+#elif defined(ARCH_CPU_X86_FAMILY)
+  __builtin_ia32_pause();
+#endif
+}
+
+}  // namespace
+
+}  // namespace internal
+}  // namespace base
+
 #if defined(OS_WIN)
 
 namespace base {
 namespace internal {
 
-LockImpl::LockImpl() {
+LockImpl::LockImpl(LockMode) {
   // The second parameter is the spin count, for short-held locks it avoid the
   // contending thread from going to sleep which helps performance greatly.
+  // The critical section spins on its lock word itself.
   ::InitializeCriticalSectionAndSpinCount(&native_handle_, 2000);
 }
 
@@ -28,6 +60,50 @@ void LockImpl::Lock() { ::EnterCriticalSection(&native_handle_); }
 
 void LockImpl::Unlock() { ::LeaveCriticalSection(&native_handle_); }
 
+RWLockImpl::RWLockImpl(LockMode mode) : spin_(mode == LockMode::kAdaptive) {
+  ::InitializeSRWLock(&native_handle_);
+}
+
+// SRW locks need no cleanup.
+RWLockImpl::~RWLockImpl() = default;
+
+bool RWLockImpl::TryReadLock() {
+  return ::TryAcquireSRWLockShared(&native_handle_) != FALSE;
+}
+
+void RWLockImpl::ReadLock() {
+  // The SRW lock state is opaque, spinners can only retry the acquire
+  if (spin_) {
+    for (int i = 0; i < kSpinCount; ++i) {
+      if (::TryAcquireSRWLockShared(&native_handle_))
+        return;
+      SpinPause();
+    }
+  }
+
+  ::AcquireSRWLockShared(&native_handle_);
+}
+
+void RWLockImpl::ReadUnlock() { ::ReleaseSRWLockShared(&native_handle_); }
+
+bool RWLockImpl::TryWriteLock() {
+  return ::TryAcquireSRWLockExclusive(&native_handle_) != FALSE;
+}
+
+void RWLockImpl::WriteLock() {
+  if (spin_) {
+    for (int i = 0; i < kSpinCount; ++i) {
+      if (::TryAcquireSRWLockExclusive(&native_handle_))
+        return;
+      SpinPause();
+    }
+  }
+
+  ::AcquireSRWLockExclusive(&native_handle_);
+}
+
+void RWLockImpl::WriteUnlock() { ::ReleaseSRWLockExclusive(&native_handle_); }
+
 }  // namespace internal
 }  // namespace base
 
@@ -41,7 +117,7 @@ void LockImpl::Unlock() { ::LeaveCriticalSection(&native_handle_); }
 namespace base {
 namespace internal {
 
-LockImpl::LockImpl() {
+LockImpl::LockImpl(LockMode mode) : spin_(mode == LockMode::kAdaptive) {
 #if DCHECK_IS_ON()
   // In debug, setup attributes for lock error checking.
   pthread_mutexattr_t mta;
@@ -67,20 +143,210 @@ LockImpl::~LockImpl() {
 bool LockImpl::Try() {
   int rv = pthread_mutex_trylock(&native_handle_);
   DCHECK(rv == 0 || rv == EBUSY) << ". " << strerror(rv);
-  return rv == 0;
+  if (rv != 0)
+    return false;
+
+  if (spin_)
+    held_.store(true, std::memory_order_relaxed);
+  return true;
 }
 
 void LockImpl::Lock() {
+  // Spin briefly before parking, like the spin count of the critical section
+  // on Windows. Short-held locks are usually released in the meantime.
+  if (spin_) {
+    for (int i = 0; i < kSpinCount; ++i) {
+      if (!held_.load(std::memory_order_relaxed) && Try())
+        return;
+      SpinPause();
+    }
+  }
+
   int rv = pthread_mutex_lock(&native_handle_);
   DCHECK_EQ(rv, 0) << ". " << strerror(rv);
+  if (spin_)
+    held_.store(true, std::memory_order_relaxed);
 }
 
 void LockImpl::Unlock() {
+  if (spin_)
+    held_.store(false, std::memory_order_relaxed);
   int rv = pthread_mutex_unlock(&native_handle_);
   DCHECK_EQ(rv, 0) << ". " << strerror(rv);
 }
 
+RWLockImpl::RWLockImpl(LockMode mode) : spin_(mode == LockMode::kAdaptive) {
+  int rv = pthread_rwlock_init(&native_handle_, NULL);
+  DCHECK_EQ(rv, 0) << ". " << strerror(rv);
+}
+
+RWLockImpl::~RWLockImpl() {
+  int rv = pthread_rwlock_destroy(&native_handle_);
+  DCHECK_EQ(rv, 0) << ". " << strerror(rv);
+}
+
+bool RWLockImpl::TryReadLock() {
+  int rv = pthread_rwlock_tryrdlock(&native_handle_);
+  DCHECK(rv == 0 || rv == EBUSY) << ". " << strerror(rv);
+  return rv == 0;
+}
+
+void RWLockImpl::ReadLock() {
+  // pthread_rwlock_t has no portable state to poll, spinners retry the
+  // acquire
+  if (spin_) {
+    for (int i = 0; i < kSpinCount; ++i) {
+      if (TryReadLock())
+        return;
+      SpinPause();
+    }
+  }
+
+  int rv = pthread_rwlock_rdlock(&native_handle_);
+  DCHECK_EQ(rv, 0) << ". " << strerror(rv);
+}
+
+void RWLockImpl::ReadUnlock() {
+  int rv = pthread_rwlock_unlock(&native_handle_);
+  DCHECK_EQ(rv, 0) << ". " << strerror(rv);
+}
+
+bool RWLockImpl::TryWriteLock() {
+  int rv = pthread_rwlock_trywrlock(&native_handle_);
+  DCHECK(rv == 0 || rv == EBUSY) << ". " << strerror(rv);
+  return rv == 0;
+}
+
+void RWLockImpl::WriteLock() {
+  if (spin_) {
+    for (int i = 0; i < kSpinCount; ++i) {
+      if (TryWriteLock())
+        return;
+      SpinPause();
+    }
+  }
+
+  int rv = pthread_rwlock_wrlock(&native_handle_);
+  DCHECK_EQ(rv, 0) << ". " << strerror(rv);
+}
+
+void RWLockImpl::WriteUnlock() {
+  int rv = pthread_rwlock_unlock(&native_handle_);
+  DCHECK_EQ(rv, 0) << ". " << strerror(rv);
+}
+
 }  // namespace internal
 }  // namespace base
 
 #endif  // defined(OS_POSIX)
+
+namespace base {
+namespace internal {
+
+namespace {
+
+std::atomic<bool> g_contention_tracking{false};
+
+// Raw lock, the registry must not count itself.
+LockImpl& RegistryLock() {
+  static LockImpl* lock = new LockImpl();
+  return *lock;
+}
+
+std::vector<LockCounters*>& Registry() {
+  static std::vector<LockCounters*>* registry =
+      new std::vector<LockCounters*>();
+  return *registry;
+}
+
+uint64_t ElapsedNanoseconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace
+
+LockCounters::LockCounters(const char* name, const char* mode)
+    : name_(name), mode_(mode) {
+  RegistryLock().Lock();
+  Registry().push_back(this);
+  RegistryLock().Unlock();
+}
+
+LockCounters::~LockCounters() {
+  RegistryLock().Lock();
+  auto& registry = Registry();
+  registry.erase(std::remove(registry.begin(), registry.end(), this),
+                 registry.end());
+  RegistryLock().Unlock();
+}
+
+// static
+bool LockCounters::IsTracking() {
+  return g_contention_tracking.load(std::memory_order_relaxed);
+}
+
+void LockCounters::Record(bool contended, uint64_t wait_ns) {
+  acquisitions_.fetch_add(1, std::memory_order_relaxed);
+  if (contended) {
+    contended_.fetch_add(1, std::memory_order_relaxed);
+    wait_ns_.fetch_add(wait_ns, std::memory_order_relaxed);
+  }
+}
+
+void Lock::AcquireTracked() {
+  if (lock_.Try()) {
+    counters_->Record(false, 0);
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  lock_.Lock();
+  counters_->Record(true, ElapsedNanoseconds(start));
+}
+
+void RWLock::ReadAcquireTracked() {
+  if (lock_.TryReadLock()) {
+    read_counters_->Record(false, 0);
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  lock_.ReadLock();
+  read_counters_->Record(true, ElapsedNanoseconds(start));
+}
+
+void RWLock::WriteAcquireTracked() {
+  if (lock_.TryWriteLock()) {
+    write_counters_->Record(false, 0);
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  lock_.WriteLock();
+  write_counters_->Record(true, ElapsedNanoseconds(start));
+}
+
+}  // namespace internal
+
+void SetLockContentionTracking(bool enable) {
+  internal::g_contention_tracking.store(enable);
+}
+
+std::vector<LockContentionStats> GetLockContentionStats() {
+  std::vector<LockContentionStats> stats;
+
+  internal::RegistryLock().Lock();
+  for (const internal::LockCounters* counters : internal::Registry()) {
+    stats.push_back({counters->name_, counters->mode_,
+                     counters->acquisitions_.load(std::memory_order_relaxed),
+                     counters->contended_.load(std::memory_order_relaxed),
+                     counters->wait_ns_.load(std::memory_order_relaxed)});
+  }
+  internal::RegistryLock().Unlock();
+
+  return stats;
+}
+
+}  // namespace base
@@ -36,11 +36,23 @@
 #include <windows.h>
 #elif defined(OS_POSIX)
 #include <pthread.h>
+
+#include <atomic>
 #endif
 
 namespace base {
 namespace internal {
 
+// How a contended acquire waits.
+enum class LockMode {
+  // The platform primitive as is. The critical section behind Lock on
+  // Windows spins on its own.
+  kDefault,
+  // Polls the lock for a short while before parking, for locks which are
+  // only held for a few instructions. Lock and RWLock both spin.
+  kAdaptive,
+};
+
 // This class implements the underlying platform-specific spin-lock mechanism
 // used for the Lock class.  Most users should not use LockImpl directly, but
 // should instead use Lock.
@@ -52,7 +64,7 @@ class LockImpl {
   typedef pthread_mutex_t NativeHandle;
 #endif
 
-  LockImpl();
+  explicit LockImpl(LockMode mode = LockMode::kDefault);
 
   LockImpl(const LockImpl&) = delete;
   LockImpl& operator=(const LockImpl&) = delete;
@@ -77,6 +89,43 @@ class LockImpl {
 
  private:
   NativeHandle native_handle_;
+#if defined(OS_POSIX)
+  const bool spin_;
+  // Whether the mutex looks taken, what spinners poll instead of trylock.
+  // Only maintained by adaptive locks.
+  std::atomic<bool> held_{false};
+#endif
+};
+
+// Reader-writer lock: any number of readers or a single writer.
+class RWLockImpl {
+ public:
+#if defined(OS_WIN)
+  typedef SRWLOCK NativeHandle;
+#elif defined(OS_POSIX)
+  typedef pthread_rwlock_t NativeHandle;
+#endif
+
+  explicit RWLockImpl(LockMode mode = LockMode::kDefault);
+
+  RWLockImpl(const RWLockImpl&) = delete;
+  RWLockImpl& operator=(const RWLockImpl&) = delete;
+
+  ~RWLockImpl();
+
+  // Shared ownership, blocks while a writer holds the lock.
+  bool TryReadLock();
+  void ReadLock();
+  void ReadUnlock();
+
+  // Exclusive ownership, blocks while anybody holds the lock.
+  bool TryWriteLock();
+  void WriteLock();
+  void WriteUnlock();
+
+ private:
+  NativeHandle native_handle_;
+  const bool spin_;
 };
 
 }  // namespace internal
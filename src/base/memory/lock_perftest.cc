@@ -0,0 +1,153 @@
+// base::Lock and base::RWLock, default and adaptive, under 1-32 threads
+// hammering one short critical section, against a plain pthread mutex and a
+// spin which retries pthread_mutex_trylock without reading first.
+
+#include <benchmark/benchmark.h>
+
+#include <pthread.h>
+
+#include <cstdint>
+
+#include "base/memory/lock.h"
+
+namespace base {
+
+namespace {
+
+// Work done while holding the lock, a few cache lines of shared state
+struct SharedState {
+  uint64_t values[32] = {};
+
+  void Update() {
+    for (uint64_t& value : values)
+      ++value;
+  }
+
+  uint64_t Sum() const {
+    uint64_t sum = 0;
+    for (uint64_t value : values)
+      sum += value;
+    return sum;
+  }
+};
+
+// Leaked, shared by every thread of every run
+template <typename T>
+T* Shared() {
+  static T* object = new T();
+  return object;
+}
+
+struct PthreadMutex {
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  SharedState state;
+};
+
+void BM_PthreadMutex(benchmark::State& state) {
+  PthreadMutex* shared = Shared<PthreadMutex>();
+  for (auto _ : state) {
+    pthread_mutex_lock(&shared->mutex);
+    shared->state.Update();
+    pthread_mutex_unlock(&shared->mutex);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PthreadMutex)->ThreadRange(1, 32)->UseRealTime();
+
+struct TrylockSpinMutex {
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  SharedState state;
+};
+
+void BM_TrylockSpinMutex(benchmark::State& state) {
+  TrylockSpinMutex* shared = Shared<TrylockSpinMutex>();
+  for (auto _ : state) {
+    bool locked = false;
+    for (int i = 0; i < 100 && !locked; ++i)
+      locked = pthread_mutex_trylock(&shared->mutex) == 0;
+    if (!locked)
+      pthread_mutex_lock(&shared->mutex);
+    shared->state.Update();
+    pthread_mutex_unlock(&shared->mutex);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TrylockSpinMutex)->ThreadRange(1, 32)->UseRealTime();
+
+// Named like the adaptive ones, both pay the contention tracking check
+struct DefaultLock {
+  Lock lock{"DefaultLock"};
+  SharedState state;
+};
+
+struct AdaptiveLock {
+  Lock lock{"AdaptiveLock", LockMode::kAdaptive};
+  SharedState state;
+};
+
+template <typename T>
+void BM_Lock(benchmark::State& state) {
+  T* shared = Shared<T>();
+  for (auto _ : state) {
+    AutoLock auto_lock(shared->lock);
+    shared->state.Update();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Lock<DefaultLock>)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(BM_Lock<AdaptiveLock>)->ThreadRange(1, 32)->UseRealTime();
+
+struct DefaultRWLock {
+  RWLock lock{"DefaultRWLock"};
+  SharedState state;
+};
+
+struct AdaptiveRWLock {
+  RWLock lock{"AdaptiveRWLock", LockMode::kAdaptive};
+  SharedState state;
+};
+
+// Read mostly, one write per 16 operations like the settings and cookie
+// caches
+template <typename T>
+void BM_RWLockReadMostly(benchmark::State& state) {
+  T* shared = Shared<T>();
+  uint64_t operation = 0;
+  for (auto _ : state) {
+    if (++operation % 16 == 0) {
+      AutoWriteLock auto_lock(shared->lock);
+      shared->state.Update();
+    } else {
+      AutoReadLock auto_lock(shared->lock);
+      benchmark::DoNotOptimize(shared->state.Sum());
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RWLockReadMostly<DefaultRWLock>)
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+BENCHMARK(BM_RWLockReadMostly<AdaptiveRWLock>)
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+
+// The same mix with every operation exclusive
+template <typename T>
+void BM_LockReadMostly(benchmark::State& state) {
+  T* shared = Shared<T>();
+  uint64_t operation = 0;
+  for (auto _ : state) {
+    AutoLock auto_lock(shared->lock);
+    if (++operation % 16 == 0)
+      shared->state.Update();
+    else
+      benchmark::DoNotOptimize(shared->state.Sum());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LockReadMostly<DefaultLock>)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(BM_LockReadMostly<AdaptiveLock>)->ThreadRange(1, 32)->UseRealTime();
+
+}  // namespace
+
+}  // namespace base
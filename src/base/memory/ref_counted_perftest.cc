@@ -0,0 +1,77 @@
+// base::RefCounted against base::RefCountedThreadSafe on the paths every
+// export takes: a scoped_refptr copy bound into a task and dropped again,
+// from one thread and from several threads sharing the object.
+
+#include <benchmark/benchmark.h>
+
+#include "base/bind/bind.h"
+#include "base/bind/callback.h"
+#include "base/memory/ref_counted.h"
+
+namespace base {
+
+namespace {
+
+class Plain : public RefCounted<Plain> {
+ public:
+  int value = 0;
+
+ private:
+  friend class RefCounted<Plain>;
+  ~Plain() = default;
+};
+
+class ThreadSafe : public RefCountedThreadSafe<ThreadSafe> {
+ public:
+  int value = 0;
+
+ private:
+  friend class RefCountedThreadSafe<ThreadSafe>;
+  ~ThreadSafe() = default;
+};
+
+template <typename T>
+void BM_RefptrCopy(benchmark::State& state) {
+  scoped_refptr<T> object = MakeRefCounted<T>();
+  for (auto _ : state) {
+    scoped_refptr<T> copy = object;
+    benchmark::DoNotOptimize(copy.get());
+  }
+}
+BENCHMARK_TEMPLATE(BM_RefptrCopy, Plain);
+BENCHMARK_TEMPLATE(BM_RefptrCopy, ThreadSafe);
+
+template <typename T>
+void BM_RefptrBindRun(benchmark::State& state) {
+  scoped_refptr<T> object = MakeRefCounted<T>();
+  for (auto _ : state) {
+    OnceClosure task =
+        BindOnce([](scoped_refptr<T> object) { ++object->value; }, object);
+    std::move(task).Run();
+  }
+  benchmark::DoNotOptimize(object->value);
+}
+BENCHMARK_TEMPLATE(BM_RefptrBindRun, Plain);
+BENCHMARK_TEMPLATE(BM_RefptrBindRun, ThreadSafe);
+
+// Host threads taking references to the same browser at once. Only the
+// thread safe count is correct here, the cost of the contended cache line
+// is what the audit pays for.
+void BM_SharedRefptrCopy(benchmark::State& state) {
+  // Leaked, shared by every thread of every run
+  static ThreadSafe* object = [] {
+    ThreadSafe* object = new ThreadSafe();
+    object->AddRef();
+    return object;
+  }();
+
+  for (auto _ : state) {
+    scoped_refptr<ThreadSafe> copy(object);
+    benchmark::DoNotOptimize(copy.get());
+  }
+}
+BENCHMARK(BM_SharedRefptrCopy)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
+
+}  // namespace base
@@ -35,10 +35,43 @@
 // If the Chromium implementation diverges the below implementation should be
 // updated to match.
 
+#include <atomic>
+#include <thread>
+
 #include "base/debug/logging.h"
 
 namespace base {
 
+///
+/// Real implementation of ThreadChecker. The checker starts detached and
+/// binds to the first thread calling CalledOnValidThread(), so an object can
+/// be created on one thread and owned by another.
+///
+/// Note: You should almost always use the StrictThreadChecker class to get the
+/// right version for your build configuration.
+///
+class ThreadCheckerImpl {
+ public:
+  ThreadCheckerImpl() = default;
+
+  bool CalledOnValidThread() const {
+    const std::thread::id current = std::this_thread::get_id();
+    std::thread::id bound;
+    if (valid_thread_id_.compare_exchange_strong(bound, current))
+      return true;
+    return bound == current;
+  }
+
+  ///
+  /// Changes the thread that is checked for in CalledOnValidThread. The next
+  /// call binds the checker again.
+  ///
+  void DetachFromThread() { valid_thread_id_.store(std::thread::id()); }
+
+ private:
+  mutable std::atomic<std::thread::id> valid_thread_id_;
+};
+
 namespace internal {
 
 ///
@@ -56,8 +89,23 @@ class ThreadCheckerDoNothing {
 
 }  // namespace internal
 
+// WeakPtr and RefCounted are handed between the ui thread and host threads by
+// design, so the checker they embed never checks anything.
 class ThreadChecker : public internal::ThreadCheckerDoNothing {};
 
+///
+/// Thread affinity checker for members only one thread may touch. Checks in
+/// DCHECK builds and compiles to nothing otherwise.
+///
+#if DCHECK_IS_ON()
+class StrictThreadChecker : public ThreadCheckerImpl {};
+#else
+class StrictThreadChecker : public internal::ThreadCheckerDoNothing {};
+#endif
+
+#define DCHECK_CALLED_ON_VALID_THREAD(checker) \
+  DCHECK((checker).CalledOnValidThread())
+
 }  // namespace base
 
 #endif  // BASE_THREAD_THREAD_CHECKER_H_
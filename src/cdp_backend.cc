@@ -0,0 +1,120 @@
+#include "cdp_backend.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "base/bind/bind.h"
+
+namespace edgeview {
+
+namespace {
+
+// Unique across backends, listeners keep their id when adopted
+std::atomic<int> next_listener_id{1};
+
+std::atomic<CDPTrafficObserver*> traffic_observer{nullptr};
+
+}  // namespace
+
+void SetCDPTrafficObserver(CDPTrafficObserver* observer) {
+  traffic_observer.store(observer, std::memory_order_release);
+}
+
+void CDPBackend::CallMethod(const std::string& method,
+                            const std::string& params,
+                            const std::string& session,
+                            ReplyCallback callback) {
+  CDPTrafficObserver* observer =
+      traffic_observer.load(std::memory_order_acquire);
+  if (observer) {
+    const uint64_t id = observer->OnCommand(browser, method, session, params);
+
+    if (callback) {
+      callback = base::BindOnce(
+          [](CDPTrafficObserver* observer, const void* browser, uint64_t id,
+             ReplyCallback callback, int status, const std::string& reply) {
+            observer->OnReply(browser, id, status, reply);
+            std::move(callback).Run(status, reply);
+          },
+          observer, browser, id, std::move(callback));
+    }
+  }
+
+  SendMethod(method, params, session, std::move(callback));
+}
+
+int CDPBackend::AddEventListener(const std::string& event,
+                                 EventCallback callback) {
+  if (callback.is_null())
+    return 0;
+
+  const int id = next_listener_id++;
+  AddListener({id, event, std::move(callback)});
+  return id;
+}
+
+void CDPBackend::RemoveEventListener(int id) {
+  // The event stays subscribed at the source, it is just not dispatched
+  listeners.erase(std::remove_if(listeners.begin(), listeners.end(),
+                                 [id](const Listener& listener) {
+                                   return listener.id == id;
+                                 }),
+                  listeners.end());
+}
+
+void CDPBackend::AddListener(Listener listener) {
+  const std::string event = listener.event;
+  listeners.push_back(std::move(listener));
+  if (subscribed_events.insert(event).second)
+    SubscribeEvent(event);
+}
+
+void CDPBackend::DispatchEvent(const std::string& event,
+                               const std::string& params,
+                               const std::string& session) {
+  if (CDPTrafficObserver* observer =
+          traffic_observer.load(std::memory_order_acquire))
+    observer->OnEvent(browser, event, session, params);
+
+  // A listener may add or remove listeners, walk a copy
+  std::vector<EventCallback> callbacks;
+  for (const auto& it : listeners) {
+    if (it.event == event)
+      callbacks.push_back(it.callback);
+  }
+
+  for (const auto& callback : callbacks)
+    callback.Run(params, session);
+}
+
+void CDPBackend::EmitEvents(const std::string& event,
+                            const std::string& params,
+                            uint32_t count) {
+  const size_t placeholder = params.find("$i");
+
+  for (uint32_t i = 0; i < count; ++i) {
+    if (placeholder == std::string::npos) {
+      DispatchEvent(event, params);
+      continue;
+    }
+
+    std::string indexed = params;
+    indexed.replace(placeholder, 2, std::to_string(i));
+    DispatchEvent(event, indexed);
+  }
+}
+
+void CDPBackend::AdoptListeners(const CDPBackend& other) {
+  for (const auto& it : other.listeners)
+    AddListener(it);
+}
+
+nlohmann::json ParseCDPReply(int status, const std::string& reply) {
+  if (status < 0)
+    return nlohmann::json();
+
+  nlohmann::json reply_obj = nlohmann::json::parse(reply, nullptr, false);
+  return reply_obj.is_discarded() ? nlohmann::json() : reply_obj;
+}
+
+}  // namespace edgeview
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/bind/callback.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "nlohmann/json.hpp"
+
+namespace edgeview {
+
+// Sees the traffic of every CDPBackend while it is installed, the CDP
+// recorder is one. Called on the thread of the backend.
+class CDPTrafficObserver {
+ public:
+  virtual ~CDPTrafficObserver() = default;
+
+  // Returns the id pairing the command with its reply
+  virtual uint64_t OnCommand(const void* browser,
+                             const std::string& method,
+                             const std::string& session,
+                             const std::string& params) = 0;
+  virtual void OnReply(const void* browser,
+                       uint64_t id,
+                       int status,
+                       const std::string& reply) = 0;
+  virtual void OnEvent(const void* browser,
+                       const std::string& event,
+                       const std::string& session,
+                       const std::string& params) = 0;
+};
+
+// Installs |observer| for every backend, null removes it. Any thread, the
+// observer must never be destroyed.
+void SetCDPTrafficObserver(CDPTrafficObserver* observer);
+
+// DevTools protocol channel of one browser. Covers the subset the wrapper
+// uses: method calls (optionally for a session) and event listeners. The
+// WebView2 implementation forwards to ICoreWebView2, FakeCDPBackend answers
+// from scripted replies, so the dispatch pipeline does not depend on a
+// running Edge and builds on any platform. Thread of the owner only, the ui
+// thread in the DLL.
+class CDPBackend : public base::RefCountedThreadSafe<CDPBackend> {
+ public:
+  // |status| is negative when the call failed, the WebView2 backend passes
+  // its HRESULT. |reply| is utf8 JSON, an object or empty on failure.
+  using ReplyCallback =
+      base::OnceCallback<void(int status, const std::string& reply)>;
+  // Event parameters JSON and the session it came from, utf8
+  using EventCallback =
+      base::RepeatingCallback<void(const std::string& params,
+                                   const std::string& session)>;
+
+  CDPBackend(const CDPBackend&) = delete;
+  CDPBackend& operator=(const CDPBackend&) = delete;
+
+  // |callback| may be null for fire and forget calls. |session| empty for
+  // the page target.
+  void CallMethod(const std::string& method,
+                  const std::string& params,
+                  const std::string& session,
+                  ReplyCallback callback);
+
+  void CallMethod(const std::string& method, const std::string& params) {
+    CallMethod(method, params, std::string(), ReplyCallback());
+  }
+
+  // Every call adds a listener, like add_DevToolsProtocolEventReceived.
+  // Returns its id for RemoveEventListener, 0 for a null callback.
+  int AddEventListener(const std::string& event, EventCallback callback);
+  void RemoveEventListener(int id);
+
+  // Runs the listeners of |event| as if the browser had sent it, used to
+  // inject synthetic traffic
+  void DispatchEvent(const std::string& event,
+                     const std::string& params,
+                     const std::string& session = std::string());
+
+  // Dispatches |count| copies of the event, "$i" in |params| is replaced by
+  // the index so ids stay unique (requestId, messageId ...)
+  void EmitEvents(const std::string& event,
+                  const std::string& params,
+                  uint32_t count);
+
+  // Takes over the listeners of |other|, for swapping backends at runtime
+  void AdoptListeners(const CDPBackend& other);
+
+ protected:
+  friend class base::RefCountedThreadSafe<CDPBackend>;
+
+  // |browser| only identifies the page to the traffic observer
+  explicit CDPBackend(const void* browser) : browser(browser) {}
+  virtual ~CDPBackend() = default;
+
+  // Sends the call to the target, the reply callback may be null
+  virtual void SendMethod(const std::string& method,
+                          const std::string& params,
+                          const std::string& session,
+                          ReplyCallback callback) = 0;
+
+  // Lets the implementation subscribe to |event| at its source, called once
+  // per event name. Received events go to DispatchEvent.
+  virtual void SubscribeEvent(const std::string& event) {}
+
+  base::WeakPtr<CDPBackend> GetWeakPtr() { return weak_ptr_.GetWeakPtr(); }
+
+ private:
+  struct Listener {
+    int id;
+    std::string event;
+    EventCallback callback;
+  };
+
+  void AddListener(Listener listener);
+
+  const void* const browser;
+  std::vector<Listener> listeners;
+  std::set<std::string> subscribed_events;
+
+  base::WeakPtrFactory<CDPBackend> weak_ptr_{this};
+};
+
+// Parsed reply of a CallMethod, null when the call failed or the reply is
+// not JSON
+nlohmann::json ParseCDPReply(int status, const std::string& reply);
+
+}  // namespace edgeview
@@ -0,0 +1,215 @@
+// CDP event storms through the portable backend: listeners parse the event
+// parameters on the ui thread and post the result to the host thread, the
+// way the browser event dispatch does. Throughput runs the listeners inline,
+// latency measures from the dispatch to the run on the host thread and
+// reports p50_us and p99_us.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/bind/bind.h"
+#include "cdp_backend.h"
+#include "fake_cdp_backend.h"
+#include "nlohmann/json.hpp"
+#include "task_poster.h"
+#include "task_queue.h"
+#include "test/test_data.h"
+
+namespace edgeview {
+
+namespace {
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+// Queues the posted tasks until the owner runs them, on any one thread
+class QueueTaskPoster : public TaskPoster {
+ public:
+  void PostTask(InlineOnceClosure task,
+                const char* name = nullptr) override {
+    queue.Push(std::move(task));
+  }
+
+  // Returns the number of tasks run
+  size_t RunPending() {
+    size_t count = 0;
+    InlineOnceClosure task;
+    while (queue.Pop(&task)) {
+      std::move(task).Run();
+      ++count;
+    }
+    return count;
+  }
+
+ private:
+  ~QueueTaskPoster() override = default;
+
+  TaskQueue<InlineOnceClosure> queue;
+};
+
+// Console messages with a "$i" placeholder for EmitEvents to number
+std::vector<std::string> LoadStormPayloads() {
+  std::vector<std::string> payloads;
+  for (auto event : LoadTestData("console_messages.json")) {
+    event["message"]["messageId"] = "$i";
+    payloads.push_back(event.dump());
+  }
+  return payloads;
+}
+
+int64_t ElapsedNs(Clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                              since)
+      .count();
+}
+
+void ReportPercentiles(benchmark::State& state, std::vector<int64_t> ns) {
+  if (ns.empty())
+    return;
+
+  std::sort(ns.begin(), ns.end());
+  state.counters["p50_us"] = ns[ns.size() / 2] / 1000.0;
+  state.counters["p99_us"] = ns[ns.size() * 99 / 100] / 1000.0;
+}
+
+// range(0): listeners of the event, range(1): events per storm
+void BM_CDPEventStorm(benchmark::State& state) {
+  std::vector<std::string> payloads = LoadStormPayloads();
+  if (payloads.empty())
+    return state.SkipWithError("console_messages.json missing");
+
+  auto poster = base::MakeRefCounted<QueueTaskPoster>();
+  auto backend = base::MakeRefCounted<FakeCDPBackend>(nullptr, poster);
+
+  size_t delivered = 0;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    backend->AddEventListener(
+        "Runtime.consoleAPICalled",
+        base::BindRepeating(
+            [](size_t* delivered, const std::string& params,
+               const std::string& session) {
+              json event = json::parse(params, nullptr, false);
+              const json& message = event["message"];
+              std::string text = message.value("text", std::string());
+              benchmark::DoNotOptimize(text.data());
+              ++*delivered;
+            },
+            &delivered));
+  }
+
+  const uint32_t count = static_cast<uint32_t>(state.range(1));
+  for (auto _ : state) {
+    for (const auto& payload : payloads)
+      backend->EmitEvents("Runtime.consoleAPICalled", payload, count);
+  }
+  state.SetItemsProcessed(state.iterations() * payloads.size() * count);
+  benchmark::DoNotOptimize(delivered);
+}
+BENCHMARK(BM_CDPEventStorm)
+    ->ArgNames({"listeners", "events"})
+    ->Args({1, 100})
+    ->Args({8, 100});
+
+// The host thread drains while the ui thread dispatches a storm, every
+// listener run posts one host callback
+void BM_CDPEventStormLatency(benchmark::State& state) {
+  std::vector<std::string> payloads = LoadStormPayloads();
+  if (payloads.empty())
+    return state.SkipWithError("console_messages.json missing");
+
+  auto host = base::MakeRefCounted<QueueTaskPoster>();
+  auto backend = base::MakeRefCounted<FakeCDPBackend>(nullptr, host);
+
+  std::vector<int64_t> latencies;
+  Clock::time_point dispatched;
+  backend->AddEventListener(
+      "Runtime.consoleAPICalled",
+      base::BindRepeating(
+          [](QueueTaskPoster* host, std::vector<int64_t>* latencies,
+             Clock::time_point* dispatched, const std::string& params,
+             const std::string& session) {
+            json event = json::parse(params, nullptr, false);
+            host->PostTask(BindOnceInline(
+                [](std::vector<int64_t>* latencies, Clock::time_point since,
+                   json event) {
+                  benchmark::DoNotOptimize(event.size());
+                  latencies->push_back(ElapsedNs(since));
+                },
+                latencies, *dispatched, std::move(event)));
+          },
+          base::Unretained(host.get()), &latencies, &dispatched));
+
+  const uint32_t count = static_cast<uint32_t>(state.range(0));
+  size_t expected = 0;
+  std::atomic<size_t> ran{0};
+  std::atomic_bool stop{false};
+
+  std::thread host_thread([&] {
+    while (!stop.load(std::memory_order_acquire)) {
+      if (size_t done = host->RunPending())
+        ran.fetch_add(done, std::memory_order_release);
+      else
+        std::this_thread::yield();
+    }
+  });
+
+  for (auto _ : state) {
+    for (const auto& payload : payloads) {
+      for (uint32_t i = 0; i < count; ++i) {
+        dispatched = Clock::now();
+        backend->DispatchEvent("Runtime.consoleAPICalled", payload);
+      }
+    }
+    expected += payloads.size() * count;
+  }
+
+  while (ran.load(std::memory_order_acquire) < expected)
+    std::this_thread::yield();
+  stop.store(true, std::memory_order_release);
+  host_thread.join();
+
+  state.SetItemsProcessed(expected);
+  ReportPercentiles(state, std::move(latencies));
+}
+BENCHMARK(BM_CDPEventStormLatency)
+    ->ArgName("events")
+    ->Arg(10)
+    ->Arg(100)
+    ->UseRealTime();
+
+// Command out, scripted reply back through the poster, reply parsed
+void BM_CDPCallMethodRoundTrip(benchmark::State& state) {
+  std::string cookies = ReadTestData("cookies.json");
+  if (cookies.empty())
+    return state.SkipWithError("cookies.json missing");
+
+  auto poster = base::MakeRefCounted<QueueTaskPoster>();
+  auto backend = base::MakeRefCounted<FakeCDPBackend>(nullptr, poster);
+  backend->SetReply("Network.getCookies", cookies);
+
+  size_t replies = 0;
+  for (auto _ : state) {
+    backend->CallMethod(
+        "Network.getCookies", "{}", std::string(),
+        base::BindOnce(
+            [](size_t* replies, int status, const std::string& reply) {
+              json reply_obj = ParseCDPReply(status, reply);
+              *replies += reply_obj["cookies"].size();
+            },
+            &replies));
+    poster->RunPending();
+  }
+  state.SetBytesProcessed(state.iterations() * cookies.size());
+  benchmark::DoNotOptimize(replies);
+}
+BENCHMARK(BM_CDPCallMethodRoundTrip);
+
+}  // namespace
+
+}  // namespace edgeview
@@ -0,0 +1,515 @@
+#include "cdp_recorder.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "api_stats.h"
+#include "base/memory/lock.h"
+#include "cdp_backend.h"
+#include "edgeview_data.h"
+#include "ev_msgpump.h"
+#include "event_notify.h"
+
+namespace edgeview {
+
+std::atomic_bool g_cdp_recording{false};
+
+namespace {
+
+// File layout: FileHeader, then the ring of records. Every record starts
+// with a RecordHeader followed by name, session and data, padded to 8 bytes.
+// Numbers are little endian, the file is only read back on Windows.
+constexpr char kMagic[8] = {'E', 'V', 'C', 'D', 'P', 'R', 'E', 'C'};
+constexpr uint32_t kVersion = 1;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t capacity;  // Bytes of the ring
+  uint64_t head;      // Ring offset of the oldest record
+  uint64_t tail;      // Ring offset the next record goes to
+  uint64_t used;      // Bytes from head to tail, padding included
+  uint64_t records;   // Records in the ring
+  uint64_t dropped;   // Records overwritten or too large to record
+  int64_t start_time;  // FILETIME of the start, record times are relative
+};
+
+struct RecordHeader {
+  uint32_t size;  // Whole record, header and padding included
+  uint8_t kind;
+  uint8_t reserved;
+  uint16_t name_size;
+  uint16_t session_size;
+  uint16_t reserved2;
+  int32_t result;
+  uint64_t id;
+  uint64_t browser;
+  int64_t time;  // Nanoseconds since the start
+  uint32_t data_size;
+  uint32_t reserved3;
+};
+
+static_assert(sizeof(FileHeader) == 72, "FileHeader layout changed");
+static_assert(sizeof(RecordHeader) == 48, "RecordHeader layout changed");
+
+constexpr uint64_t AlignRecord(uint64_t size) {
+  return (size + 7) & ~uint64_t(7);
+}
+
+// Single writer ring in a mapped file, callers serialize
+class RecordingFile {
+ public:
+  RecordingFile() = default;
+  ~RecordingFile() { Close(); }
+
+  RecordingFile(const RecordingFile&) = delete;
+  RecordingFile& operator=(const RecordingFile&) = delete;
+
+  bool Open(const std::wstring& path, uint64_t capacity) {
+    capacity = AlignRecord(capacity);
+    const uint64_t file_size = sizeof(FileHeader) + capacity;
+
+    file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                       FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return false;
+
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE,
+                                 static_cast<DWORD>(file_size >> 32),
+                                 static_cast<DWORD>(file_size), nullptr);
+    if (mapping)
+      view = static_cast<uint8_t*>(
+          MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+    if (!view) {
+      Close();
+      return false;
+    }
+
+    header = reinterpret_cast<FileHeader*>(view);
+    ring = view + sizeof(FileHeader);
+
+    memcpy(header->magic, kMagic, sizeof(kMagic));
+    header->version = kVersion;
+    header->header_size = sizeof(FileHeader);
+    header->capacity = capacity;
+    header->head = header->tail = header->used = 0;
+    header->records = header->dropped = 0;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    header->start_time =
+        (static_cast<int64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+
+    return true;
+  }
+
+  void Close() {
+    if (view) {
+      FlushViewOfFile(view, 0);
+      UnmapViewOfFile(view);
+    }
+    if (mapping)
+      CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+
+    view = nullptr;
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+    header = nullptr;
+    ring = nullptr;
+  }
+
+  void Append(RecordHeader record,
+              std::string_view name,
+              std::string_view session,
+              std::string_view data) {
+    const uint64_t size = AlignRecord(sizeof(RecordHeader) + name.size() +
+                                      session.size() + data.size());
+    // Keeps a single record from flushing the whole ring
+    if (size > header->capacity / 2) {
+      ++header->dropped;
+      return;
+    }
+    record.size = static_cast<uint32_t>(size);
+
+    const uint64_t capacity = header->capacity;
+    if (capacity - header->tail < size) {
+      // Does not fit before the end, pad it out and wrap
+      const uint64_t padding = capacity - header->tail;
+      EnsureFree(padding);
+      if (padding >= sizeof(RecordHeader)) {
+        RecordHeader pad = {};
+        pad.size = static_cast<uint32_t>(padding);
+        pad.kind = static_cast<uint8_t>(CDPRecordKind::kPadding);
+        memcpy(ring + header->tail, &pad, sizeof(pad));
+      }
+      header->used += padding;
+      header->tail = 0;
+    }
+
+    EnsureFree(size);
+    uint8_t* out = ring + header->tail;
+    memcpy(out, &record, sizeof(record));
+    out += sizeof(record);
+    memcpy(out, name.data(), name.size());
+    out += name.size();
+    memcpy(out, session.data(), session.size());
+    out += session.size();
+    memcpy(out, data.data(), data.size());
+
+    header->tail = (header->tail + size) % capacity;
+    header->used += size;
+    ++header->records;
+  }
+
+  bool is_open() const { return !!view; }
+
+ private:
+  // Evicts the oldest records until |size| bytes are free
+  void EnsureFree(uint64_t size) {
+    const uint64_t capacity = header->capacity;
+    while (capacity - header->used < size) {
+      const uint64_t remaining = capacity - header->head;
+      uint64_t evicted = remaining;
+      if (remaining >= sizeof(RecordHeader)) {
+        const RecordHeader* oldest =
+            reinterpret_cast<const RecordHeader*>(ring + header->head);
+        evicted = oldest->size;
+        if (oldest->kind != static_cast<uint8_t>(CDPRecordKind::kPadding)) {
+          --header->records;
+          ++header->dropped;
+        }
+      }
+
+      header->head = (header->head + evicted) % capacity;
+      header->used -= evicted;
+    }
+  }
+
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+  uint8_t* view = nullptr;
+  FileHeader* header = nullptr;
+  uint8_t* ring = nullptr;
+};
+
+// Forwards the traffic of every CDPBackend to the recording, installed while
+// it runs
+class CDPRecordingObserver : public CDPTrafficObserver {
+ public:
+  static CDPRecordingObserver* GetInstance() {
+    // Leaked on purpose, backends may still call it during shutdown
+    static CDPRecordingObserver* instance = new CDPRecordingObserver();
+    return instance;
+  }
+
+  uint64_t OnCommand(const void* browser,
+                     const std::string& method,
+                     const std::string& session,
+                     const std::string& params) override {
+    const uint64_t id = NextCDPRecordId();
+    RecordCDPTraffic(CDPRecordKind::kCommand, browser, id, method, session,
+                     params);
+    return id;
+  }
+
+  void OnReply(const void* browser,
+               uint64_t id,
+               int status,
+               const std::string& reply) override {
+    RecordCDPTraffic(CDPRecordKind::kReply, browser, id, {}, {}, reply,
+                     status);
+  }
+
+  void OnEvent(const void* browser,
+               const std::string& event,
+               const std::string& session,
+               const std::string& params) override {
+    RecordCDPTraffic(CDPRecordKind::kEvent, browser, 0, event, session,
+                     params);
+  }
+};
+
+class CDPRecorder {
+ public:
+  static CDPRecorder* GetInstance() {
+    // Leaked on purpose, threads may still record during shutdown
+    static CDPRecorder* instance = new CDPRecorder();
+    return instance;
+  }
+
+  CDPRecorder(const CDPRecorder&) = delete;
+  CDPRecorder& operator=(const CDPRecorder&) = delete;
+
+  bool Start(const std::wstring& path, uint64_t capacity) {
+    base::AutoLock auto_lock(lock);
+    g_cdp_recording.store(false);
+    file.Close();
+
+    if (!file.Open(path, capacity))
+      return false;
+
+    start_time = LatencyNow();
+    g_cdp_recording.store(true);
+    SetCDPTrafficObserver(CDPRecordingObserver::GetInstance());
+    return true;
+  }
+
+  bool Stop() {
+    base::AutoLock auto_lock(lock);
+    g_cdp_recording.store(false);
+    SetCDPTrafficObserver(nullptr);
+    if (!file.is_open())
+      return false;
+
+    file.Close();
+    return true;
+  }
+
+  void Record(const RecordHeader& record,
+              std::string_view name,
+              std::string_view session,
+              std::string_view data) {
+    base::AutoLock auto_lock(lock);
+    if (!file.is_open())
+      return;
+
+    RecordHeader stamped = record;
+    stamped.time = LatencyNow() - start_time;
+    file.Append(stamped, name, session, data);
+  }
+
+ private:
+  CDPRecorder() = default;
+  ~CDPRecorder() = default;
+
+  base::Lock lock{"CDPRecorder"};
+  RecordingFile file;
+  int64_t start_time = 0;
+};
+
+struct ReplayEvent {
+  CDPRecordKind kind;  // kEvent or kHostCall
+  int64_t time;
+  std::string name;
+  std::string session;
+  std::string params;  // Event params, or the host call arguments
+};
+
+// CDP events and host calls with arguments of a recording in recorded
+// order, empty if it is not one. Browsers are not told apart.
+std::vector<ReplayEvent> ReadRecordedEvents(const std::wstring& path) {
+  std::vector<ReplayEvent> events;
+
+  FILE* file = _wfsopen(path.c_str(), L"rb", _SH_DENYNO);
+  if (!file)
+    return events;
+
+  FileHeader header;
+  std::vector<uint8_t> ring;
+  if (fread(&header, sizeof(header), 1, file) == 1 &&
+      !memcmp(header.magic, kMagic, sizeof(kMagic)) &&
+      header.version == kVersion && header.used <= header.capacity) {
+    ring.resize(static_cast<size_t>(header.capacity));
+    _fseeki64(file, header.header_size, SEEK_SET);
+    if (fread(ring.data(), 1, ring.size(), file) != ring.size())
+      ring.clear();
+  }
+  fclose(file);
+
+  uint64_t pos = header.head;
+  uint64_t walked = 0;
+  while (!ring.empty() && walked < header.used) {
+    const uint64_t remaining = ring.size() - pos;
+    uint64_t size = remaining;
+    if (remaining >= sizeof(RecordHeader)) {
+      RecordHeader record;
+      memcpy(&record, ring.data() + pos, sizeof(record));
+      size = record.size;
+      if (size < sizeof(RecordHeader) || size > remaining)
+        break;
+
+      const char* payload =
+          reinterpret_cast<const char*>(ring.data() + pos + sizeof(record));
+      const uint64_t payload_size = static_cast<uint64_t>(record.name_size) +
+                                    record.session_size + record.data_size;
+      if (payload_size > size - sizeof(RecordHeader))
+        break;
+
+      const auto kind = static_cast<CDPRecordKind>(record.kind);
+      if (kind == CDPRecordKind::kEvent ||
+          (kind == CDPRecordKind::kHostCall && record.data_size)) {
+        events.push_back(
+            {kind, record.time, std::string(payload, record.name_size),
+             std::string(payload + record.name_size, record.session_size),
+             std::string(payload + record.name_size + record.session_size,
+                         record.data_size)});
+      }
+    }
+
+    pos = (pos + size) % ring.size();
+    walked += size;
+  }
+
+  return events;
+}
+
+class CDPReplayer {
+ public:
+  static CDPReplayer* GetInstance() {
+    // Leaked on purpose, like the recorder
+    static CDPReplayer* instance = new CDPReplayer();
+    return instance;
+  }
+
+  CDPReplayer(const CDPReplayer&) = delete;
+  CDPReplayer& operator=(const CDPReplayer&) = delete;
+
+  bool Start(base::WeakPtr<BrowserData> browser,
+             scoped_refptr<MessagePump> msg_pump,
+             std::vector<ReplayEvent> events,
+             double speed) {
+    base::AutoLock auto_lock(lock);
+    StopLocked();
+
+    if (events.empty())
+      return false;
+
+    if (!stop_event)
+      stop_event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    ResetEvent(stop_event);
+    replayer = std::thread(&CDPReplayer::ReplayThread, this, browser,
+                           std::move(msg_pump), std::move(events), speed);
+    return true;
+  }
+
+  void Stop() {
+    base::AutoLock auto_lock(lock);
+    StopLocked();
+  }
+
+ private:
+  CDPReplayer() = default;
+  ~CDPReplayer() = default;
+
+  void StopLocked() {
+    if (!replayer.joinable())
+      return;
+
+    SetEvent(stop_event);
+    replayer.join();
+  }
+
+  // Holds no reference to |browser|, every event resolves it on the ui
+  // thread and is dropped once it is gone.
+  void ReplayThread(base::WeakPtr<BrowserData> browser,
+                    scoped_refptr<MessagePump> msg_pump,
+                    std::vector<ReplayEvent> events,
+                    double speed) {
+    const int64_t first_time = events.front().time;
+    const int64_t start = LatencyNow();
+
+    for (auto& event : events) {
+      if (speed > 0) {
+        const int64_t due =
+            start + static_cast<int64_t>((event.time - first_time) / speed);
+        const int64_t wait_ms = (due - LatencyNow()) / 1000000;
+        if (wait_ms > 0 &&
+            WaitForSingleObject(stop_event, static_cast<DWORD>(wait_ms)) !=
+                WAIT_TIMEOUT)
+          return;
+      }
+      if (WaitForSingleObject(stop_event, 0) == WAIT_OBJECT_0)
+        return;
+
+      msg_pump->PostTask(
+          BindOnceInline(
+              [](base::WeakPtr<BrowserData> browser, ReplayEvent event) {
+                if (!browser)
+                  return;
+
+                if (event.kind == CDPRecordKind::kHostCall) {
+                  browser->dispatcher->ReplayHostCall(
+                      event.name, json::parse(event.params, nullptr, false));
+                  return;
+                }
+
+                browser->cdp_backend->DispatchEvent(event.name, event.params,
+                                                    event.session);
+              },
+              browser, std::move(event)),
+          "ReplayCDPRecording");
+    }
+  }
+
+  // Serializes Start and Stop
+  base::Lock lock{"CDPReplayer"};
+  std::thread replayer;
+  // Manual reset, created by the first Start and kept
+  HANDLE stop_event = nullptr;
+};
+
+}  // namespace
+
+void RecordCDPTraffic(CDPRecordKind kind,
+                      const void* browser,
+                      uint64_t id,
+                      std::string_view name,
+                      std::string_view session,
+                      std::string_view data,
+                      HRESULT result) {
+  if (!CDPRecording())
+    return;
+
+  RecordHeader record = {};
+  record.kind = static_cast<uint8_t>(kind);
+  record.name_size = static_cast<uint16_t>(
+      std::min<size_t>(name.size(), UINT16_MAX));
+  record.session_size = static_cast<uint16_t>(
+      std::min<size_t>(session.size(), UINT16_MAX));
+  record.result = result;
+  record.id = id;
+  record.browser = reinterpret_cast<uintptr_t>(browser);
+  record.data_size = static_cast<uint32_t>(
+      std::min<size_t>(data.size(), UINT32_MAX));
+
+  CDPRecorder::GetInstance()->Record(record, name.substr(0, record.name_size),
+                                     session.substr(0, record.session_size),
+                                     data.substr(0, record.data_size));
+}
+
+uint64_t NextCDPRecordId() {
+  static std::atomic<uint64_t> next_id{1};
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+EV_EXPORTS(StartCDPRecording, BOOL)(LPCSTR path, uint32_t capacity_mb) {
+  if (!path || !*path)
+    return FALSE;
+
+  const uint64_t capacity =
+      static_cast<uint64_t>(std::max<uint32_t>(capacity_mb, 1)) << 20;
+  return CDPRecorder::GetInstance()->Start(Utf8Conv::Utf8ToUtf16(path),
+                                           capacity);
+}
+
+EV_EXPORTS(StopCDPRecording, BOOL)() {
+  return CDPRecorder::GetInstance()->Stop();
+}
+
+bool StartCDPReplay(BrowserData* browser,
+                    const std::wstring& path,
+                    double speed) {
+  return CDPReplayer::GetInstance()->Start(browser->weak_ptr_.GetWeakPtr(),
+                                           browser->parent->msg_pump,
+                                           ReadRecordedEvents(path), speed);
+}
+
+EV_EXPORTS(StopCDPReplay, void)() {
+  CDPReplayer::GetInstance()->Stop();
+}
+
+}  // namespace edgeview
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <string_view>
+
+#include "util.h"
+
+namespace edgeview {
+
+struct BrowserData;
+
+enum class CDPRecordKind : uint8_t {
+  kPadding = 0,  // Fills the end of the ring before it wraps
+  kCommand,      // name: method, data: params, id pairs it with the reply
+  kReply,        // data: reply JSON, result: HRESULT
+  kEvent,        // name: event, data: params
+  kHostCall,     // name: dispatcher method the event was delivered through,
+                 // data: its WebView2 event arguments as JSON, empty when
+                 // the call is not replayed
+};
+
+// Set while a recording is running
+extern std::atomic_bool g_cdp_recording;
+
+inline bool CDPRecording() {
+  return g_cdp_recording.load(std::memory_order_relaxed);
+}
+
+// Appends one record to the running recording, |browser| tells the pages
+// apart. Any thread.
+void RecordCDPTraffic(CDPRecordKind kind,
+                      const void* browser,
+                      uint64_t id,
+                      std::string_view name,
+                      std::string_view session,
+                      std::string_view data,
+                      HRESULT result = S_OK);
+
+// Id pairing a command with its reply
+uint64_t NextCDPRecordId();
+
+// Records into a memory mapped ring file of |capacity_mb|, the oldest
+// records are overwritten once it is full.
+EV_EXPORTS(StartCDPRecording, BOOL)(LPCSTR path, uint32_t capacity_mb);
+EV_EXPORTS(StopCDPRecording, BOOL)();
+
+// Feeds the recorded CDP events back into |browser| through its CDP backend
+// and the recorded WebView2 events through its dispatcher, keeping the
+// recorded gaps divided by |speed|. |speed| <= 0 replays as fast as the ui
+// thread takes them. Records of every browser in the recording are merged
+// into |browser|, record one page to replay one page. Stops delivering once
+// |browser| is gone. A running replay is stopped first.
+bool StartCDPReplay(BrowserData* browser,
+                    const std::wstring& path,
+                    double speed);
+
+EV_EXPORTS(StopCDPReplay, void)();
+
+}  // namespace edgeview
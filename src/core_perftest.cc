@@ -0,0 +1,327 @@
+// Micro benchmarks of the platform independent core. Build with the root
+// CMakeLists.txt on Linux and run
+//
+//   edgeview_perftests --benchmark_format=json --benchmark_out=perf.json
+//
+// for machine readable results. Time per iteration is ns/op, payload
+// benchmarks also report bytes_per_second.
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "base/bind/bind.h"
+#include "base/bind/callback.h"
+#include "base/bind/callback_list.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/third_party/concurrentqueue/concurrentqueue.h"
+#include "modp_b64.h"
+#include "nlohmann/json.hpp"
+#include "string_util.h"
+#include "test/test_data.h"
+
+namespace edgeview {
+
+namespace {
+
+using json = nlohmann::json;
+
+class Counter : public base::RefCountedThreadSafe<Counter> {
+ public:
+  void Add(int value) { total += value; }
+
+  int total = 0;
+  base::WeakPtrFactory<Counter> weak_ptr_{this};
+
+ private:
+  friend class base::RefCountedThreadSafe<Counter>;
+  ~Counter() = default;
+};
+
+// Mirrors the fields TransferRequestJSON hands to the host, with owned
+// strings in place of the dispatch arena
+struct RequestFields {
+  std::string url;
+  std::string method;
+  std::string headers;
+  std::string post_data;
+  bool has_post_data = false;
+  std::string initial_priority;
+  std::string referrer_policy;
+};
+
+void TransferRequest(const json& from, RequestFields* to) {
+  to->url = from["url"].get_ref<const std::string&>();
+  to->method = from["method"].get_ref<const std::string&>();
+
+  to->headers.clear();
+  for (auto& it : from["headers"].items())
+    to->headers +=
+        it.key() + ": " + it.value().get_ref<const std::string&>() + "\r\n";
+
+  auto post_data = from.find("postData");
+  to->post_data = post_data != from.end()
+                      ? post_data->get_ref<const std::string&>()
+                      : std::string();
+  to->has_post_data = from.value("hasPostData", false);
+
+  to->initial_priority = from["initialPriority"].get_ref<const std::string&>();
+  to->referrer_policy = from["referrerPolicy"].get_ref<const std::string&>();
+}
+
+// Every event of a corpus file as its own serialized payload
+std::vector<std::string> LoadEventPayloads(const char* name) {
+  std::vector<std::string> payloads;
+  for (const auto& event : LoadTestData(name))
+    payloads.push_back(event.dump());
+  return payloads;
+}
+
+size_t TotalSize(const std::vector<std::string>& payloads) {
+  size_t size = 0;
+  for (const auto& payload : payloads)
+    size += payload.size();
+  return size;
+}
+
+void BM_BindOnceRun(benchmark::State& state) {
+  scoped_refptr<Counter> counter = base::MakeRefCounted<Counter>();
+  for (auto _ : state) {
+    base::OnceClosure task = base::BindOnce(&Counter::Add, counter, 1);
+    std::move(task).Run();
+  }
+  benchmark::DoNotOptimize(counter->total);
+}
+BENCHMARK(BM_BindOnceRun);
+
+void BM_BindOnceLambdaRun(benchmark::State& state) {
+  scoped_refptr<Counter> counter = base::MakeRefCounted<Counter>();
+  for (auto _ : state) {
+    base::OnceClosure task = base::BindOnce(
+        [](scoped_refptr<Counter> counter, int value, bool flag) {
+          counter->Add(flag ? value : 0);
+        },
+        counter, 1, true);
+    std::move(task).Run();
+  }
+  benchmark::DoNotOptimize(counter->total);
+}
+BENCHMARK(BM_BindOnceLambdaRun);
+
+void BM_RepeatingCallbackRun(benchmark::State& state) {
+  scoped_refptr<Counter> counter = base::MakeRefCounted<Counter>();
+  base::RepeatingCallback<void(int)> callback =
+      base::BindRepeating(&Counter::Add, counter);
+  for (auto _ : state)
+    callback.Run(1);
+  benchmark::DoNotOptimize(counter->total);
+}
+BENCHMARK(BM_RepeatingCallbackRun);
+
+void BM_WeakPtrDeref(benchmark::State& state) {
+  scoped_refptr<Counter> counter = base::MakeRefCounted<Counter>();
+  base::WeakPtr<Counter> weak_ptr = counter->weak_ptr_.GetWeakPtr();
+  for (auto _ : state) {
+    if (weak_ptr)
+      weak_ptr->Add(1);
+  }
+  benchmark::DoNotOptimize(counter->total);
+}
+BENCHMARK(BM_WeakPtrDeref);
+
+void BM_WeakPtrBoundRun(benchmark::State& state) {
+  scoped_refptr<Counter> counter = base::MakeRefCounted<Counter>();
+  for (auto _ : state) {
+    base::OnceClosure task = base::BindOnce(
+        &Counter::Add, counter->weak_ptr_.GetWeakPtr(), 1);
+    std::move(task).Run();
+  }
+  benchmark::DoNotOptimize(counter->total);
+}
+BENCHMARK(BM_WeakPtrBoundRun);
+
+void BM_ScopedRefptrChurn(benchmark::State& state) {
+  scoped_refptr<Counter> counter = base::MakeRefCounted<Counter>();
+  for (auto _ : state) {
+    scoped_refptr<Counter> copy = counter;
+    benchmark::DoNotOptimize(copy.get());
+  }
+}
+BENCHMARK(BM_ScopedRefptrChurn);
+
+void BM_ScopedRefptrCreate(benchmark::State& state) {
+  for (auto _ : state) {
+    scoped_refptr<Counter> counter = base::MakeRefCounted<Counter>();
+    benchmark::DoNotOptimize(counter.get());
+  }
+}
+BENCHMARK(BM_ScopedRefptrCreate);
+
+void BM_CallbackListNotify(benchmark::State& state) {
+  scoped_refptr<Counter> counter = base::MakeRefCounted<Counter>();
+  base::RepeatingCallbackList<void(int)> list;
+  std::vector<base::CallbackListSubscription> subscriptions;
+  for (int64_t i = 0; i < state.range(0); ++i)
+    subscriptions.push_back(
+        list.Add(base::BindRepeating(&Counter::Add, counter)));
+
+  for (auto _ : state)
+    list.Notify(1);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  benchmark::DoNotOptimize(counter->total);
+}
+BENCHMARK(BM_CallbackListNotify)->Arg(1)->Arg(8)->Arg(64);
+
+void BM_Base64Encode(benchmark::State& state) {
+  std::string input(state.range(0), '\0');
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = static_cast<char>(i * 131 + 7);
+  std::string output(modp_b64_encode_len(input.size()), '\0');
+
+  for (auto _ : state) {
+    size_t size = modp_b64_encode(output.data(), input.data(), input.size());
+    benchmark::DoNotOptimize(size);
+  }
+  state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_Base64Encode)->Arg(1 << 10)->Arg(64 << 10)->Arg(1 << 20);
+
+void BM_Base64Decode(benchmark::State& state) {
+  std::string input(state.range(0), '\0');
+  for (size_t i = 0; i < input.size(); ++i)
+    input[i] = static_cast<char>(i * 131 + 7);
+  std::string encoded(modp_b64_encode_len(input.size()), '\0');
+  encoded.resize(
+      modp_b64_encode(encoded.data(), input.data(), input.size()));
+  std::string output(modp_b64_decode_len(encoded.size()), '\0');
+
+  for (auto _ : state) {
+    size_t size =
+        modp_b64_decode(output.data(), encoded.data(), encoded.size());
+    benchmark::DoNotOptimize(size);
+  }
+  state.SetBytesProcessed(state.iterations() * encoded.size());
+}
+BENCHMARK(BM_Base64Decode)->Arg(1 << 10)->Arg(64 << 10)->Arg(1 << 20);
+
+// Raw header blocks as ContinueRequest receives them from the host
+void BM_SplitTrimHeaders(benchmark::State& state) {
+  std::vector<std::string> blocks;
+  for (const auto& event : LoadTestData("fetch_request_paused.json")) {
+    std::string block;
+    for (auto& it : event["request"]["headers"].items())
+      block += it.key() + ": " + it.value().get<std::string>() + "\r\n";
+    blocks.push_back(std::move(block));
+  }
+  if (blocks.empty())
+    return state.SkipWithError("fetch_request_paused.json missing");
+
+  for (auto _ : state) {
+    for (const auto& block : blocks) {
+      for (const auto& line : SplitString(block, "\n")) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+          continue;
+        std::string key = TrimString(line.substr(0, colon));
+        std::string value = TrimString(line.substr(colon + 1));
+        benchmark::DoNotOptimize(key.data());
+        benchmark::DoNotOptimize(value.data());
+      }
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * TotalSize(blocks));
+}
+BENCHMARK(BM_SplitTrimHeaders);
+
+void BM_FetchRequestPausedMarshal(benchmark::State& state) {
+  std::vector<std::string> payloads =
+      LoadEventPayloads("fetch_request_paused.json");
+  if (payloads.empty())
+    return state.SkipWithError("fetch_request_paused.json missing");
+
+  RequestFields fields;
+  for (auto _ : state) {
+    for (const auto& payload : payloads) {
+      json event = json::parse(payload);
+      TransferRequest(event["request"], &fields);
+      benchmark::DoNotOptimize(fields.headers.data());
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * TotalSize(payloads));
+  state.SetItemsProcessed(state.iterations() * payloads.size());
+}
+BENCHMARK(BM_FetchRequestPausedMarshal);
+
+void BM_ConsoleMessageMarshal(benchmark::State& state) {
+  std::vector<std::string> payloads =
+      LoadEventPayloads("console_messages.json");
+  if (payloads.empty())
+    return state.SkipWithError("console_messages.json missing");
+
+  for (auto _ : state) {
+    for (const auto& payload : payloads) {
+      json event = json::parse(payload);
+      const json& message = event["message"];
+      std::string text = message.value("text", std::string());
+      std::string url = message.value("url", std::string());
+      int line = message.value("line", 0);
+      benchmark::DoNotOptimize(text.data());
+      benchmark::DoNotOptimize(url.data());
+      benchmark::DoNotOptimize(line);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * TotalSize(payloads));
+  state.SetItemsProcessed(state.iterations() * payloads.size());
+}
+BENCHMARK(BM_ConsoleMessageMarshal);
+
+void BM_CookieListParse(benchmark::State& state) {
+  std::string payload = ReadTestData("cookies.json");
+  if (payload.empty())
+    return state.SkipWithError("cookies.json missing");
+
+  for (auto _ : state) {
+    json reply = json::parse(payload);
+    benchmark::DoNotOptimize(reply["cookies"].size());
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_CookieListParse);
+
+void BM_ConcurrentQueueRoundTrip(benchmark::State& state) {
+  moodycamel::ConcurrentQueue<uint64_t> queue;
+  uint64_t value = 0;
+  for (auto _ : state) {
+    queue.enqueue(value);
+    queue.try_dequeue(value);
+  }
+  benchmark::DoNotOptimize(value);
+}
+BENCHMARK(BM_ConcurrentQueueRoundTrip);
+
+// Thread 0 drains while the other threads produce, the shape of host
+// threads posting to the ui thread
+void BM_ConcurrentQueueProducers(benchmark::State& state) {
+  // Leaked, shared by every run
+  static auto* queue = new moodycamel::ConcurrentQueue<uint64_t>();
+
+  if (state.thread_index() == 0) {
+    uint64_t items[64];
+    for (auto _ : state)
+      queue->try_dequeue_bulk(items, std::size(items));
+    return;
+  }
+
+  moodycamel::ProducerToken token(*queue);
+  uint64_t value = 0;
+  for (auto _ : state)
+    queue->enqueue(token, value++);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ConcurrentQueueProducers)->ThreadRange(2, 8)->UseRealTime();
+
+}  // namespace
+
+}  // namespace edgeview
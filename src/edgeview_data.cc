@@ -6,4 +6,10 @@ namespace edgeview {
 
 ResourceRequestCallback::~ResourceRequestCallback() { ContinueRequest(this, nullptr); }
 
+BrowserData::~BrowserData() {
+  // Its timer thread would keep ticking until the sampler itself goes
+  if (memory_sampler)
+    memory_sampler->Stop();
+}
+
 }  // namespace edgeview
@@ -1,12 +1,24 @@
 #pragma once
 
 #include <atomic>
+#include <map>
+#include <source_location>
 #include <thread>
 
+#include "api_stats.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/weak_ptr.h"
+#include "base/thread/thread_checker.h"
+#include "cdp_backend.h"
+#include "ev_capturediff.h"
 #include "ev_msgpump.h"
+#include "ev_screencast.h"
 #include "event_notify.h"
+#include "load_state.h"
+#include "memory_sampler.h"
+#include "object_pool.h"
+#include "page_metrics.h"
+#include "process_metrics.h"
 #include "util.h"
 #include "webview_host.h"
 
@@ -21,7 +33,7 @@ struct StrMapElement {
   LPCSTR value;
 };
 
-class Semaphore : public base::RefCounted<Semaphore> {
+class Semaphore : public base::RefCountedThreadSafe<Semaphore> {
  public:
   Semaphore() : atomic(false) {}
   ~Semaphore() = default;
@@ -37,40 +49,68 @@ class Semaphore : public base::RefCounted<Semaphore> {
   std::atomic_bool atomic;
 };
 
-struct EnvironmentData : public base::RefCounted<EnvironmentData> {
+struct EnvironmentData : public base::RefCountedThreadSafe<EnvironmentData> {
   WRL::ComPtr<ICoreWebView2Environment11> core_env;
   scoped_refptr<MessagePump> msg_pump;
   scoped_refptr<Semaphore> semaphore_flag;
 
   std::thread::id ui_thread;
 
+  // Browsers created in this environment, ui thread only
+  std::vector<base::WeakPtr<BrowserData>> browsers;
+  // Baseline of GetProcessMetrics by pid, ui thread only
+  std::map<int, ProcessSnapshot> process_snapshots;
+  // Renderer lookups of the memory samplers, ui thread only
+  RendererIndex renderer_index;
+
   base::WeakPtrFactory<EnvironmentData> weak_ptr_{this};
 
   EnvironmentData() = default;
 
-  void PostEvent(base::OnceClosure event_notify) {
+  // Tasks are named after the calling function in the api stats and the
+  // trace, the default argument picks it up at the call site.
+  void PostEvent(InlineOnceClosure event_notify,
+                 const std::source_location& location =
+                     std::source_location::current()) {
     // Always async running on ui thread
-    msg_pump->PostTask(std::move(event_notify));
+    msg_pump->PostTask(std::move(event_notify), location.function_name());
   }
 
-  void PostUITask(base::OnceClosure task) {
+  void PostUITask(InlineOnceClosure task,
+                  const std::source_location& location =
+                      std::source_location::current()) {
     if (RunningOnUIThread()) {
-      return std::move(task).Run();
+      const int64_t start_time = LatencyNow();
+      AddTraceEvent('B', kTraceTasks, location.function_name());
+      std::move(task).Run();
+      AddTraceEvent('E', kTraceTasks, location.function_name());
+      return RecordLatency(LatencyCategory::kExport, location.function_name(),
+                           LatencyKind::kExecution, LatencyNow() - start_time);
     }
 
     // Only non UI thread should be post
-    msg_pump->PostTask(std::move(task));
+    msg_pump->PostTask(std::move(task), location.function_name());
   }
 
   bool RunningOnUIThread() { return std::this_thread::get_id() == ui_thread; }
 
-  scoped_refptr<Semaphore> semaphore() const {
+  // Only sync exports take the semaphore, their total latency runs from
+  // here to the end of SyncWaitIfNeed. Helpers which post for an export pass
+  // the export's location through.
+  scoped_refptr<Semaphore> semaphore(
+      const std::source_location& location =
+          std::source_location::current()) const {
+    BeginCall(location.function_name());
     semaphore_flag->Reset();
     return semaphore_flag;
   }
 
   bool SyncWaitIfNeed() {
-    if (semaphore_flag->IsTriggered()) return false;
+    if (semaphore_flag->IsTriggered()) {
+      // Ran inline on the ui thread
+      EndCall();
+      return false;
+    }
 
     if (!RunningOnUIThread()) {
       // Only non UI thread should be sync
@@ -93,11 +133,48 @@ struct EnvironmentData : public base::RefCounted<EnvironmentData> {
     // Reset
     semaphore_flag->Reset();
 
+    EndCall();
     return true;
   }
+
+ private:
+  // Sync exports waiting on this thread, innermost last. Exports called
+  // from a host callback while an outer one runs inline or pumps messages
+  // nest on top.
+  struct PendingCall {
+    const char* name;
+    int64_t start_time;
+  };
+
+  static std::vector<PendingCall>& PendingCalls() {
+    static thread_local std::vector<PendingCall> calls;
+    return calls;
+  }
+
+  static void BeginCall(const char* name) {
+    PendingCalls().push_back({name, LatencyNow()});
+  }
+
+  static void EndCall() {
+    std::vector<PendingCall>& calls = PendingCalls();
+    if (calls.empty())
+      return;
+
+    const PendingCall& call = calls.back();
+    RecordLatency(LatencyCategory::kExport, call.name, LatencyKind::kTotal,
+                  LatencyNow() - call.start_time);
+    calls.pop_back();
+  }
 };
 
-struct BrowserData : public base::RefCounted<BrowserData> {
+struct RegisteredScript {
+  // Document-created hook id, removes the installer on unregister
+  std::string hook_id;
+  // Remote function handle in the current document, empty until resolved
+  std::string object_id;
+};
+
+struct BrowserData : public base::RefCountedThreadSafe<BrowserData> {
   base::WeakPtr<EnvironmentData> parent;
 
   WRL::ComPtr<ICoreWebView2Controller4> core_controller;
@@ -109,14 +186,42 @@ struct BrowserData : public base::RefCounted<BrowserData> {
   scoped_refptr<BrowserEventDispatcher> dispatcher;
   LPVOID pCallback = nullptr;
 
+  // DevTools protocol channel, the WebView2 one unless swapped for a fake
+  scoped_refptr<CDPBackend> cdp_backend;
+
+  // Checks the ui thread only members below in debug builds
+  base::StrictThreadChecker ui_thread_checker;
+
+  // Tracked by the frame events, ui thread only
   std::vector<scoped_refptr<FrameData>> frames;
 
+  // Named functions installed by RegisterScript, ui thread only
+  std::map<std::string, RegisteredScript> scripts;
+
+  // Reused by the captures, grows to the largest one and stays
+  std::vector<uint8_t> capture_buffer;
+  // Tile hashes of the last CaptureScreenshotDiff frame
+  CaptureDiffer capture_differ;
+
+  // Active Page.startScreencast stream, ui thread only
+  scoped_refptr<ScreencastSession> screencast;
+
+  // Per navigation timings, null unless SetPageMetricsCollector enabled it
+  scoped_refptr<PageMetricsCollector> page_metrics;
+
+  // Periodic renderer memory samples, null unless StartMemorySampler ran
+  scoped_refptr<MemorySampler> memory_sampler;
+
+  // In-flight requests and lifecycle, created by the first load state call
+  scoped_refptr<LoadStateTracker> load_state;
+
   base::WeakPtrFactory<BrowserData> weak_ptr_{this};
 
   BrowserData() = default;
+  ~BrowserData();
 };
 
-struct FrameData : public base::RefCounted<FrameData> {
+struct FrameData : public base::RefCountedThreadSafe<FrameData> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2Frame3> core_frame;
@@ -127,7 +232,8 @@ struct FrameData : public base::RefCounted<FrameData> {
   FrameData(WRL::ComPtr<ICoreWebView2Frame3> frame) : core_frame(frame) {}
 };
 
-struct NewWindowDelegate : public base::RefCounted<NewWindowDelegate> {
+struct NewWindowDelegate : public base::RefCountedThreadSafe<NewWindowDelegate>,
+                           public PooledObject<NewWindowDelegate> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2NewWindowRequestedEventArgs> core_newwindow;
@@ -136,7 +242,9 @@ struct NewWindowDelegate : public base::RefCounted<NewWindowDelegate> {
   NewWindowDelegate() = default;
 };
 
-struct ScriptDialogDelegate : public base::RefCounted<ScriptDialogDelegate> {
+struct ScriptDialogDelegate
+    : public base::RefCountedThreadSafe<ScriptDialogDelegate>,
+      public PooledObject<ScriptDialogDelegate> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2ScriptDialogOpeningEventArgs> core_dialog;
@@ -145,7 +253,8 @@ struct ScriptDialogDelegate : public base::RefCounted<ScriptDialogDelegate> {
   ScriptDialogDelegate() = default;
 };
 
-struct ContextMenuParams : public base::RefCounted<ContextMenuParams> {
+struct ContextMenuParams : public base::RefCountedThreadSafe<ContextMenuParams>,
+                           public PooledObject<ContextMenuParams> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2ContextMenuRequestedEventArgs> core_menu;
@@ -154,7 +263,9 @@ struct ContextMenuParams : public base::RefCounted<ContextMenuParams> {
   ContextMenuParams() = default;
 };
 
-struct ContextMenuCollection : public base::RefCounted<ContextMenuCollection> {
+struct ContextMenuCollection
+    : public base::RefCountedThreadSafe<ContextMenuCollection>,
+      public PooledObject<ContextMenuCollection> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2ContextMenuItemCollection> core_list;
@@ -162,7 +273,8 @@ struct ContextMenuCollection : public base::RefCounted<ContextMenuCollection> {
   ContextMenuCollection() = default;
 };
 
-struct ContextMenuItem : public base::RefCounted<ContextMenuItem> {
+struct ContextMenuItem : public base::RefCountedThreadSafe<ContextMenuItem>,
+                         public PooledObject<ContextMenuItem> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2ContextMenuItem> core_item;
@@ -170,7 +282,9 @@ struct ContextMenuItem : public base::RefCounted<ContextMenuItem> {
   ContextMenuItem() = default;
 };
 
-struct PermissionDelegate : public base::RefCounted<PermissionDelegate> {
+struct PermissionDelegate
+    : public base::RefCountedThreadSafe<PermissionDelegate>,
+      public PooledObject<PermissionDelegate> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2PermissionRequestedEventArgs2> core_delegate;
@@ -179,7 +293,8 @@ struct PermissionDelegate : public base::RefCounted<PermissionDelegate> {
   PermissionDelegate() = default;
 };
 
-struct CookieManagerData : public base::RefCounted<CookieManagerData> {
+struct CookieManagerData
+    : public base::RefCountedThreadSafe<CookieManagerData> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2CookieManager> core_manager;
@@ -188,7 +303,8 @@ struct CookieManagerData : public base::RefCounted<CookieManagerData> {
 };
 
 struct ResourceRequestCallback
-    : public base::RefCounted<ResourceRequestCallback> {
+    : public base::RefCountedThreadSafe<ResourceRequestCallback>,
+      public PooledObject<ResourceRequestCallback> {
   base::WeakPtr<BrowserData> browser;
 
   json event_parameter;
@@ -197,7 +313,8 @@ struct ResourceRequestCallback
 };
 
 struct ResourceResponseCallback
-    : public base::RefCounted<ResourceResponseCallback> {
+    : public base::RefCountedThreadSafe<ResourceResponseCallback>,
+      public PooledObject<ResourceResponseCallback> {
   base::WeakPtr<BrowserData> browser;
 
   json event_parameter;
@@ -206,7 +323,8 @@ struct ResourceResponseCallback
 };
 
 struct BasicAuthenticationCallback
-    : public base::RefCounted<BasicAuthenticationCallback> {
+    : public base::RefCountedThreadSafe<BasicAuthenticationCallback>,
+      public PooledObject<BasicAuthenticationCallback> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2BasicAuthenticationRequestedEventArgs> core_callback;
@@ -215,7 +333,8 @@ struct BasicAuthenticationCallback
   BasicAuthenticationCallback() = default;
 };
 
-struct DownloadOperation : public base::RefCounted<DownloadOperation> {
+struct DownloadOperation : public base::RefCountedThreadSafe<DownloadOperation>,
+                           public PooledObject<DownloadOperation> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2DownloadOperation> core_operation;
@@ -223,7 +342,8 @@ struct DownloadOperation : public base::RefCounted<DownloadOperation> {
   DownloadOperation() = default;
 };
 
-struct DownloadConfirm : public base::RefCounted<DownloadConfirm> {
+struct DownloadConfirm : public base::RefCountedThreadSafe<DownloadConfirm>,
+                         public PooledObject<DownloadConfirm> {
   base::WeakPtr<BrowserData> browser;
 
   WRL::ComPtr<ICoreWebView2DownloadStartingEventArgs> core_args;
@@ -232,13 +352,13 @@ struct DownloadConfirm : public base::RefCounted<DownloadConfirm> {
   DownloadConfirm() = default;
 };
 
-struct DOMOperation : public base::RefCounted<DOMOperation> {
+struct DOMOperation : public base::RefCountedThreadSafe<DOMOperation> {
   base::WeakPtr<BrowserData> browser;
 
   DOMOperation() = default;
 };
 
-struct ExtensionData : public base::RefCounted<ExtensionData> {
+struct ExtensionData : public base::RefCountedThreadSafe<ExtensionData> {
   base::WeakPtr<EnvironmentData> parent;
 
   WRL::ComPtr<ICoreWebView2BrowserExtension> core_extension;
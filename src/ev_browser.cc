@@ -1,5 +1,6 @@
 #include "ev_browser.h"
 
+#include "cdp_recorder.h"
 #include "edgeview_data.h"
 #include "ev_browser.h"
 #include "ev_dom.h"
@@ -7,6 +8,11 @@
 #include "ev_extension.h"
 #include "ev_frame.h"
 #include "ev_network.h"
+#include "fake_cdp_backend.h"
+#include "mem_accounting.h"
+#include "modp_b64.h"
+#include "packed_array.h"
+#include "string_arena.h"
 #include "webview_host.h"
 
 namespace edgeview {
@@ -76,7 +82,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             wrapper->core_newwindow = args;
             args->GetDeferral(&wrapper->internal_deferral);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr,
                    scoped_refptr<NewWindowDelegate> wrapper) {
                   weak_ptr->dispatcher->OnNewWindowRequested(wrapper);
@@ -91,7 +97,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
   browser_wrapper->core_webview->add_WindowCloseRequested(
       WRL::Callback<ICoreWebView2WindowCloseRequestedEventHandler>(
           [weak_ptr](ICoreWebView2* sender, IUnknown* args) {
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr) {
                   weak_ptr->dispatcher->OnCloseRequested();
                 },
@@ -105,13 +111,14 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
   browser_wrapper->core_webview->add_DocumentTitleChanged(
       WRL::Callback<ICoreWebView2DocumentTitleChangedEventHandler>(
           [weak_ptr](ICoreWebView2* sender, IUnknown* args) {
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr) {
                   wil::unique_cotaskmem_string raw_title;
                   weak_ptr->core_webview->get_DocumentTitle(&raw_title);
 
+                  ScopedStringArena arena;
                   weak_ptr->dispatcher->OnDocumentTitleChanged(
-                      WrapComString(raw_title));
+                      arena.Wrap(raw_title));
                 },
                 weak_ptr));
 
@@ -123,7 +130,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
   browser_wrapper->core_webview->add_ContainsFullScreenElementChanged(
       WRL::Callback<ICoreWebView2ContainsFullScreenElementChangedEventHandler>(
           [weak_ptr](ICoreWebView2* sender, IUnknown* args) {
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr) {
                   BOOL fullscreen = FALSE;
                   weak_ptr->core_webview->get_ContainsFullScreenElement(
@@ -151,9 +158,11 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
                 [](base::WeakPtr<BrowserData> weak_ptr,
                    WRL::ComPtr<ICoreWebView2NavigationStartingEventArgs2>
                        args) {
+                  ScopedStringArena arena;
+
                   wil::unique_cotaskmem_string raw_url = nullptr;
                   args->get_Uri(&raw_url);
-                  LPCSTR url = WrapComString(raw_url);
+                  LPCSTR url = arena.Wrap(raw_url);
 
                   BOOL user_gesture = FALSE, is_redirect = FALSE;
                   args->get_IsUserInitiated(&user_gesture);
@@ -186,9 +195,14 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
 
                   BOOL cancel_nav = weak_ptr->dispatcher->OnBeforeNavigation(
                       url, user_gesture, is_redirect,
-                      WrapComString(headers.c_str()), nav_id);
+                      arena.Wrap(headers.c_str()), nav_id);
 
                   args->put_Cancel(cancel_nav);
+                  if (!cancel_nav && weak_ptr->page_metrics)
+                    weak_ptr->page_metrics->OnNavigationStarting(
+                        nav_id, url ? url : std::string(), is_redirect);
+                  if (!cancel_nav && weak_ptr->load_state)
+                    weak_ptr->load_state->OnNavigationStarting(nav_id);
                 },
                 weak_ptr, std::move(nav_args)));
 
@@ -207,7 +221,14 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             uint64_t nav_id = 0;
             args->get_NavigationId(&nav_id);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            // Remote handles die with the old document
+            DCHECK_CALLED_ON_VALID_THREAD(weak_ptr->ui_thread_checker);
+            for (auto& it : weak_ptr->scripts)
+              it.second.object_id.clear();
+            if (weak_ptr->page_metrics)
+              weak_ptr->page_metrics->OnContentLoading(nav_id, is_error_page);
+
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr, BOOL is_error_page,
                    uint64_t nav_id) {
                   weak_ptr->dispatcher->OnContentLoading(is_error_page, nav_id);
@@ -226,7 +247,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             BOOL is_newdoc = FALSE;
             args->get_IsNewDocument(&is_newdoc);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr, BOOL is_newdoc) {
                   weak_ptr->dispatcher->OnSourceChanged(is_newdoc);
                 },
@@ -240,7 +261,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
   browser_wrapper->core_webview->add_HistoryChanged(
       WRL::Callback<ICoreWebView2HistoryChangedEventHandler>(
           [weak_ptr](ICoreWebView2* sender, IUnknown* args) {
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr) {
                   weak_ptr->dispatcher->OnHistoryChanged();
                 },
@@ -265,7 +286,11 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             uint64_t nav_id = 0;
             args->get_NavigationId(&nav_id);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            if (weak_ptr->page_metrics)
+              weak_ptr->page_metrics->OnNavigationCompleted(nav_id, success,
+                                                            status);
+
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr, BOOL success,
                    COREWEBVIEW2_WEB_ERROR_STATUS status, uint64_t nav_id) {
                   weak_ptr->dispatcher->OnNavigationComplete(success, status,
@@ -291,7 +316,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             delegate->core_dialog = args;
             args->GetDeferral(&delegate->internal_deferral);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr,
                    WRL::ComPtr<ICoreWebView2ScriptDialogOpeningEventArgs> args,
                    scoped_refptr<ScriptDialogDelegate> delegate) {
@@ -308,9 +333,10 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
                   wil::unique_cotaskmem_string raw_deftext = nullptr;
                   args->get_DefaultText(&raw_deftext);
 
+                  ScopedStringArena arena;
                   weak_ptr->dispatcher->OnScriptDialogRequested(
-                      WrapComString(raw_url), kind, WrapComString(raw_message),
-                      WrapComString(raw_deftext), delegate);
+                      arena.Wrap(raw_url), kind, arena.Wrap(raw_message),
+                      arena.Wrap(raw_deftext), delegate);
                 },
                 weak_ptr, std::move(args_obj), std::move(delegate)));
 
@@ -328,7 +354,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             params->core_menu = args;
             args->GetDeferral(&params->internal_deferral);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr,
                    scoped_refptr<ContextMenuParams> params) {
                   weak_ptr->dispatcher->OnContextMenuRequested(params);
@@ -351,7 +377,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             args->GetDeferral(&delegate->internal_deferral);
             delegate->browser = weak_ptr;
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr,
                    scoped_refptr<PermissionDelegate> delegate) {
                   wil::unique_cotaskmem_string url = nullptr;
@@ -363,8 +389,9 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
                   BOOL user_gesture = FALSE;
                   delegate->core_delegate->get_IsUserInitiated(&user_gesture);
 
+                  ScopedStringArena arena;
                   weak_ptr->dispatcher->OnPermissionRequested(
-                      WrapComString(url), kind, user_gesture, delegate);
+                      arena.Wrap(url), kind, user_gesture, delegate);
                 },
                 weak_ptr, delegate));
 
@@ -406,7 +433,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             args->GetDeferral(&callback->internal_deferral);
             callback->browser = weak_ptr;
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr,
                    scoped_refptr<BasicAuthenticationCallback> callback) {
                   wil::unique_cotaskmem_string url = nullptr,
@@ -414,8 +441,9 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
                   callback->core_callback->get_Uri(&url);
                   callback->core_callback->get_Challenge(&challenge);
 
+                  ScopedStringArena arena;
                   weak_ptr->dispatcher->BasicAuthRequested(
-                      WrapComString(url), WrapComString(challenge), callback);
+                      arena.Wrap(url), arena.Wrap(challenge), callback);
                 },
                 weak_ptr, callback));
 
@@ -433,13 +461,15 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             wil::unique_cotaskmem_string json_args = nullptr;
             args->get_WebMessageAsJson(&json_args);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
-                [](base::WeakPtr<BrowserData> weak_ptr, LPCSTR source_url,
-                   LPCSTR json_args) {
+            weak_ptr->parent->PostEvent(BindOnceInline(
+                [](base::WeakPtr<BrowserData> weak_ptr, std::string source_url,
+                   std::string json_args) {
+                  ScopedStringArena arena;
                   weak_ptr->dispatcher->OnReceivedWebMessage(
-                      nullptr, source_url, json_args);
+                      nullptr, arena.Wrap(source_url), arena.Wrap(json_args));
                 },
-                weak_ptr, WrapComString(src_url), WrapComString(json_args)));
+                weak_ptr, Utf8Conv::Utf16ToUtf8(src_url.get()),
+                Utf8Conv::Utf16ToUtf8(json_args.get())));
 
             return S_OK;
           })
@@ -455,7 +485,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             confirm->core_args = args;
             args->GetDeferral(&confirm->internal_deferral);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr,
                    scoped_refptr<DownloadConfirm> confirm) {
                   weak_ptr->dispatcher->OnBeforeDownload(confirm);
@@ -478,6 +508,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
 
             scoped_refptr<FrameData> frame = new FrameData(frame_obj);
             frame->browser = weak_ptr;
+            DCHECK_CALLED_ON_VALID_THREAD(weak_ptr->ui_thread_checker);
             weak_ptr->frames.push_back(frame);
 
             frame_obj->add_NavigationStarting(
@@ -496,6 +527,8 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             frame_obj->add_Destroyed(
                 WRL::Callback<ICoreWebView2FrameDestroyedEventHandler>(
                     [weak_ptr](ICoreWebView2Frame* sender, IUnknown* args) {
+                      DCHECK_CALLED_ON_VALID_THREAD(
+                          weak_ptr->ui_thread_checker);
                       auto it = std::remove_if(
                           weak_ptr->frames.begin(), weak_ptr->frames.end(),
                           [sender](scoped_refptr<FrameData> element) {
@@ -520,15 +553,18 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
                       wil::unique_cotaskmem_string json_args = nullptr;
                       args->get_WebMessageAsJson(&json_args);
 
-                      weak_ptr->parent->PostEvent(base::BindOnce(
+                      weak_ptr->parent->PostEvent(BindOnceInline(
                           [](base::WeakPtr<BrowserData> weak_ptr,
                              base::WeakPtr<FrameData> frame_weak_ptr,
-                             LPCSTR source_url, LPCSTR json_args) {
+                             std::string source_url, std::string json_args) {
+                            ScopedStringArena arena;
                             weak_ptr->dispatcher->OnReceivedWebMessage(
-                                frame_weak_ptr.get(), source_url, json_args);
+                                frame_weak_ptr.get(), arena.Wrap(source_url),
+                                arena.Wrap(json_args));
                           },
-                          weak_ptr, frame_weak_ptr, WrapComString(src_url),
-                          WrapComString(json_args)));
+                          weak_ptr, frame_weak_ptr,
+                          Utf8Conv::Utf16ToUtf8(src_url.get()),
+                          Utf8Conv::Utf16ToUtf8(json_args.get())));
 
                       return S_OK;
                     })
@@ -543,12 +579,13 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
   browser_wrapper->core_webview->add_FaviconChanged(
       WRL::Callback<ICoreWebView2FaviconChangedEventHandler>(
           [weak_ptr](ICoreWebView2* sender, IUnknown* args) {
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr) {
                   wil::unique_cotaskmem_string raw_favicon = nullptr;
                   weak_ptr->core_webview->get_FaviconUri(&raw_favicon);
+                  ScopedStringArena arena;
                   weak_ptr->dispatcher->OnFaviconChanged(
-                      WrapComString(raw_favicon));
+                      arena.Wrap(raw_favicon));
                 },
                 weak_ptr));
 
@@ -560,7 +597,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
   browser_wrapper->core_webview->add_IsDocumentPlayingAudioChanged(
       WRL::Callback<ICoreWebView2IsDocumentPlayingAudioChangedEventHandler>(
           [weak_ptr](ICoreWebView2* sender, IUnknown* args) {
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr) {
                   BOOL is_playing = FALSE;
                   weak_ptr->core_webview->get_IsDocumentPlayingAudio(
@@ -578,13 +615,14 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
   browser_wrapper->core_webview->add_StatusBarTextChanged(
       WRL::Callback<ICoreWebView2StatusBarTextChangedEventHandler>(
           [weak_ptr](ICoreWebView2* sender, IUnknown* args) {
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr) {
                   wil::unique_cotaskmem_string status_text = nullptr;
                   weak_ptr->core_webview->get_StatusBarText(&status_text);
 
+                  ScopedStringArena arena;
                   weak_ptr->dispatcher->OnStatusTextChanged(
-                      WrapComString(status_text));
+                      arena.Wrap(status_text));
                 },
                 weak_ptr));
 
@@ -600,7 +638,7 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
             COREWEBVIEW2_PROCESS_FAILED_KIND kind;
             args->get_ProcessFailedKind(&kind);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](base::WeakPtr<BrowserData> weak_ptr,
                    COREWEBVIEW2_PROCESS_FAILED_KIND kind) {
                   wil::unique_cotaskmem_string status_text = nullptr;
@@ -618,77 +656,57 @@ void BindEventForWebView(scoped_refptr<BrowserData> browser_wrapper) {
 
 void BindEventForUpdate(scoped_refptr<BrowserData> browser_wrapper) {
   base::WeakPtr<BrowserData> weak_ptr = browser_wrapper->weak_ptr_.GetWeakPtr();
-  browser_wrapper->core_webview->CallDevToolsProtocolMethod(L"DOM.enable",
-                                                            L"{}", nullptr);
+  CDPBackend* cdp = browser_wrapper->cdp_backend.get();
+  cdp->CallMethod("DOM.enable", "{}");
 
   // ------------------------ CDP event extensions ------------------------
   // Resource intercept event
-  WRL::ComPtr<ICoreWebView2DevToolsProtocolEventReceiver> fetch_receiver;
-  browser_wrapper->core_webview->GetDevToolsProtocolEventReceiver(
-      L"Fetch.requestPaused", &fetch_receiver);
-  fetch_receiver->add_DevToolsProtocolEventReceived(
-      WRL::Callback<ICoreWebView2DevToolsProtocolEventReceivedEventHandler>(
-          [weak_ptr](
-              ICoreWebView2* sender,
-              ICoreWebView2DevToolsProtocolEventReceivedEventArgs* args) {
-            WRL::ComPtr<ICoreWebView2DevToolsProtocolEventReceivedEventArgs2>
-                event_args = nullptr;
-            args->QueryInterface<
-                ICoreWebView2DevToolsProtocolEventReceivedEventArgs2>(
-                &event_args);
+  cdp->AddEventListener(
+      "Fetch.requestPaused",
+      base::BindRepeating(
+          [](base::WeakPtr<BrowserData> weak_ptr, const std::string& params,
+             const std::string& session) {
+            if (!weak_ptr)
+              return;
 
             // Serialize json
-            wil::unique_cotaskmem_string raw_json = nullptr;
-            event_args->get_ParameterObjectAsJson(&raw_json);
-            json json_obj = json::parse(Utf8Conv::Utf16ToUtf8(raw_json.get()));
+            json json_obj = json::parse(params);
 
             // Common arguments
             if (json_obj.find("responseStatusCode") != json_obj.end() ||
                 json_obj.find("responseHeaders") != json_obj.end()) {
-              weak_ptr->parent->PostEvent(base::BindOnce(
+              weak_ptr->parent->PostEvent(BindOnceInline(
                   [](scoped_refptr<BrowserEventDispatcher> dispatcher,
                      json json_obj) {
                     dispatcher->OnResourceReceiveResponse(json_obj);
                   },
                   weak_ptr->dispatcher, std::move(json_obj)));
             } else {
-              weak_ptr->parent->PostEvent(base::BindOnce(
+              weak_ptr->parent->PostEvent(BindOnceInline(
                   [](scoped_refptr<BrowserEventDispatcher> dispatcher,
                      json json_obj) {
                     dispatcher->OnResourceRequested(json_obj);
                   },
                   weak_ptr->dispatcher, std::move(json_obj)));
             }
-
-            return S_OK;
-          })
-          .Get(),
-      nullptr);
+          },
+          weak_ptr));
 
   // ------------------------ CDP event extensions ------------------------
   // File chooser event
-  browser_wrapper->core_webview->CallDevToolsProtocolMethod(L"Page.enable",
-                                                            L"{}", nullptr);
-  WRL::ComPtr<ICoreWebView2DevToolsProtocolEventReceiver> filechooser_receiver;
-  browser_wrapper->core_webview->GetDevToolsProtocolEventReceiver(
-      L"Page.fileChooserOpened", &filechooser_receiver);
-  filechooser_receiver->add_DevToolsProtocolEventReceived(
-      WRL::Callback<ICoreWebView2DevToolsProtocolEventReceivedEventHandler>(
-          [weak_ptr](
-              ICoreWebView2* sender,
-              ICoreWebView2DevToolsProtocolEventReceivedEventArgs* args) {
-            WRL::ComPtr<ICoreWebView2DevToolsProtocolEventReceivedEventArgs2>
-                event_args = nullptr;
-            args->QueryInterface<
-                ICoreWebView2DevToolsProtocolEventReceivedEventArgs2>(
-                &event_args);
+  cdp->CallMethod("Page.enable", "{}");
+  cdp->AddEventListener(
+      "Page.fileChooserOpened",
+      base::BindRepeating(
+          [](base::WeakPtr<BrowserData> weak_ptr, const std::string& params,
+             const std::string& session) {
+            if (!weak_ptr)
+              return;
 
             // Serialize json
-            wil::unique_cotaskmem_string raw_json = nullptr;
-            event_args->get_ParameterObjectAsJson(&raw_json);
-            json json_obj = json::parse(Utf8Conv::Utf16ToUtf8(raw_json.get()));
+            json json_obj = json::parse(params);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](scoped_refptr<BrowserEventDispatcher> dispatcher,
                    json json_obj) {
                   auto frame_id =
@@ -698,50 +716,36 @@ void BindEventForUpdate(scoped_refptr<BrowserData> browser_wrapper) {
                       "selectMultiple";
                   int node_id = json_obj["backendNodeId"].template get<int>();
 
-                  dispatcher->OnFileChooserRequested(
-                      WrapComString(frame_id.c_str()), multiselect, node_id);
+                  ScopedStringArena arena;
+                  dispatcher->OnFileChooserRequested(arena.Wrap(frame_id),
+                                                     multiselect, node_id);
                 },
                 weak_ptr->dispatcher, std::move(json_obj)));
-
-            return S_OK;
-          })
-          .Get(),
-      nullptr);
+          },
+          weak_ptr));
 
   // ------------------------ CDP event extensions ------------------------
   // Console event
-  browser_wrapper->core_webview->CallDevToolsProtocolMethod(L"Console.enable",
-                                                            L"{}", nullptr);
-  WRL::ComPtr<ICoreWebView2DevToolsProtocolEventReceiver> console_receiver;
-  browser_wrapper->core_webview->GetDevToolsProtocolEventReceiver(
-      L"Console.messageAdded", &console_receiver);
-  console_receiver->add_DevToolsProtocolEventReceived(
-      WRL::Callback<ICoreWebView2DevToolsProtocolEventReceivedEventHandler>(
-          [weak_ptr](
-              ICoreWebView2* sender,
-              ICoreWebView2DevToolsProtocolEventReceivedEventArgs* args) {
-            WRL::ComPtr<ICoreWebView2DevToolsProtocolEventReceivedEventArgs2>
-                event_args = nullptr;
-            args->QueryInterface<
-                ICoreWebView2DevToolsProtocolEventReceivedEventArgs2>(
-                &event_args);
+  cdp->CallMethod("Console.enable", "{}");
+  cdp->AddEventListener(
+      "Console.messageAdded",
+      base::BindRepeating(
+          [](base::WeakPtr<BrowserData> weak_ptr, const std::string& params,
+             const std::string& session) {
+            if (!weak_ptr)
+              return;
 
             // Serialize json
-            wil::unique_cotaskmem_string raw_json = nullptr;
-            event_args->get_ParameterObjectAsJson(&raw_json);
-            json json_obj = json::parse(Utf8Conv::Utf16ToUtf8(raw_json.get()));
+            json json_obj = json::parse(params);
 
-            weak_ptr->parent->PostEvent(base::BindOnce(
+            weak_ptr->parent->PostEvent(BindOnceInline(
                 [](scoped_refptr<BrowserEventDispatcher> dispatcher,
                    json json_obj) {
                   dispatcher->OnConsoleMessage(std::move(json_obj));
                 },
                 weak_ptr->dispatcher, std::move(json_obj)));
-
-            return S_OK;
-          })
-          .Get(),
-      nullptr);
+          },
+          weak_ptr));
 }
 
 namespace {
@@ -973,7 +977,7 @@ void WINAPI ExecuteJavascriptAsync(BrowserData* obj,
                     HRESULT errorCode, LPCWSTR resultObjectAsJson) {
                   auto json_ret = Utf8Conv::Utf16ToUtf8(resultObjectAsJson);
 
-                  weak_ptr->parent->PostEvent(base::BindOnce(
+                  weak_ptr->parent->PostEvent(BindOnceInline(
                       [](const std::string& json_ret,
                          ExecuteJavascriptCB callback,
                          LPVOID param) { callback(json_ret.c_str(), param); },
@@ -1112,6 +1116,37 @@ using PDFPrintSettingsData = struct {
   LPCSTR footer_url;
 };
 
+WRL::ComPtr<ICoreWebView2PrintSettings> CreatePDFPrintSettings(
+    BrowserData* self,
+    PDFPrintSettingsData* settings) {
+  if (!settings)
+    return nullptr;
+
+  WRL::ComPtr<ICoreWebView2PrintSettings> pdf_settings = nullptr;
+  self->parent->core_env->CreatePrintSettings(&pdf_settings);
+
+  pdf_settings->put_Orientation(settings->orientation);
+  pdf_settings->put_ScaleFactor(settings->scale_factor);
+  pdf_settings->put_PageWidth(settings->page_width);
+  pdf_settings->put_PageHeight(settings->page_height);
+  pdf_settings->put_MarginTop(settings->margin_top);
+  pdf_settings->put_MarginBottom(settings->margin_bottom);
+  pdf_settings->put_MarginLeft(settings->margin_left);
+  pdf_settings->put_MarginRight(settings->margin_right);
+  pdf_settings->put_ShouldPrintBackgrounds(settings->print_background);
+  pdf_settings->put_ShouldPrintSelectionOnly(settings->only_selection);
+  pdf_settings->put_ShouldPrintHeaderAndFooter(settings->page_header_footer);
+
+  if (settings->header_title && *settings->header_title)
+    pdf_settings->put_HeaderTitle(
+        Utf8Conv::Utf8ToUtf16(settings->header_title).c_str());
+  if (settings->footer_url && *settings->footer_url)
+    pdf_settings->put_FooterUri(
+        Utf8Conv::Utf8ToUtf16(settings->footer_url).c_str());
+
+  return pdf_settings;
+}
+
 void WINAPI PrintToPDFStream(BrowserData* obj,
                              PDFPrintSettingsData* settings,
                              LPBYTE* img_data,
@@ -1119,39 +1154,26 @@ void WINAPI PrintToPDFStream(BrowserData* obj,
   obj->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
          LPBYTE* img_data, int32_t* img_size, PDFPrintSettingsData* settings) {
-        WRL::ComPtr<ICoreWebView2PrintSettings> pdf_settings = nullptr;
-        self->parent->core_env->CreatePrintSettings(&pdf_settings);
-
-        if (settings) {
-          pdf_settings->put_Orientation(settings->orientation);
-          pdf_settings->put_ScaleFactor(settings->scale_factor);
-          pdf_settings->put_PageWidth(settings->page_width);
-          pdf_settings->put_PageHeight(settings->page_height);
-          pdf_settings->put_MarginTop(settings->margin_top);
-          pdf_settings->put_MarginBottom(settings->margin_bottom);
-          pdf_settings->put_MarginLeft(settings->margin_left);
-          pdf_settings->put_MarginRight(settings->margin_right);
-          pdf_settings->put_ShouldPrintBackgrounds(settings->print_background);
-          pdf_settings->put_ShouldPrintSelectionOnly(settings->only_selection);
-          pdf_settings->put_ShouldPrintHeaderAndFooter(
-              settings->page_header_footer);
-
-          if (settings->header_title && *settings->header_title)
-            pdf_settings->put_HeaderTitle(
-                Utf8Conv::Utf8ToUtf16(settings->header_title).c_str());
-          if (settings->footer_url && *settings->footer_url)
-            pdf_settings->put_FooterUri(
-                Utf8Conv::Utf8ToUtf16(settings->footer_url).c_str());
-        }
+        auto pdf_settings = CreatePDFPrintSettings(self.get(), settings);
 
         self->core_webview->PrintToPdfStream(
-            settings ? pdf_settings.Get() : nullptr,
+            pdf_settings.Get(),
             WRL::Callback<ICoreWebView2PrintToPdfStreamCompletedHandler>(
                 [img_data, img_size, sync](HRESULT errorCode,
                                            IStream* pdfStream) {
+                  *img_data = nullptr;
+                  *img_size = 0;
+
                   STATSTG stat;
                   pdfStream->Stat(&stat, STATFLAG_NONAME);
 
+                  // Large documents do not fit the size output, use
+                  // PrintToPDFFile instead of handing back a truncated file.
+                  if (stat.cbSize.QuadPart > INT32_MAX) {
+                    sync->Notify();
+                    return S_OK;
+                  }
+
                   LARGE_INTEGER linfo;
                   linfo.QuadPart = 0;
                   pdfStream->Seek(linfo, STREAM_SEEK_SET, NULL);
@@ -1199,6 +1221,154 @@ void WINAPI CloseController(BrowserData* obj) {
       scoped_refptr(obj)));
 }
 
+using PDFChunkCB = BOOL(CALLBACK*)(LPBYTE chunk,
+                                   uint32_t size,
+                                   uint64_t written,
+                                   uint64_t total,
+                                   LPVOID param);
+using PDFCompletedCB = void(CALLBACK*)(BOOL success,
+                                       uint64_t written,
+                                       LPVOID param);
+
+constexpr uint32_t kDefaultPDFChunkSize = 1024 * 1024;
+
+// Copies the printed stream into |file| or out through |chunk_callback| with
+// one fixed size buffer. Runs on its own thread, both callbacks are invoked
+// there. Returning FALSE from the chunk callback cancels the transfer.
+void WritePDFStream(IStream* marshaled_stream,
+                    std::wstring file,
+                    uint32_t chunk_size,
+                    PDFChunkCB chunk_callback,
+                    PDFCompletedCB completed,
+                    LPVOID param) {
+  HRESULT com_init = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+  uint64_t written = 0;
+  bool success = false;
+
+  do {
+    WRL::ComPtr<IStream> stream = nullptr;
+    if (FAILED(CoGetInterfaceAndReleaseStream(
+            marshaled_stream, IID_PPV_ARGS(&stream))))
+      break;
+
+    STATSTG stat;
+    stream->Stat(&stat, STATFLAG_NONAME);
+    const uint64_t total = stat.cbSize.QuadPart;
+
+    LARGE_INTEGER linfo;
+    linfo.QuadPart = 0;
+    stream->Seek(linfo, STREAM_SEEK_SET, NULL);
+
+    wil::unique_hfile file_handle;
+    if (!file.empty()) {
+      file_handle.reset(CreateFileW(file.c_str(), GENERIC_WRITE, 0, nullptr,
+                                    CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                                    nullptr));
+      if (!file_handle)
+        break;
+    }
+
+    std::vector<uint8_t> chunk(chunk_size);
+    success = true;
+    for (;;) {
+      ULONG read = 0;
+      HRESULT hr = stream->Read(chunk.data(), chunk_size, &read);
+      if (FAILED(hr)) {
+        success = false;
+        break;
+      }
+      if (!read)
+        break;
+
+      if (file_handle) {
+        DWORD file_written = 0;
+        if (!WriteFile(file_handle.get(), chunk.data(), read, &file_written,
+                       nullptr) ||
+            file_written != read) {
+          success = false;
+          break;
+        }
+      }
+
+      written += read;
+
+      // File mode reports progress only
+      if (chunk_callback &&
+          !chunk_callback(file_handle ? nullptr : chunk.data(), read, written,
+                          total, param)) {
+        success = false;
+        break;
+      }
+    }
+  } while (false);
+
+  if (completed)
+    completed(success, written, param);
+
+  if (SUCCEEDED(com_init))
+    CoUninitialize();
+}
+
+void WINAPI PrintToPDFFile(BrowserData* obj,
+                           PDFPrintSettingsData* settings,
+                           LPCSTR file_path,
+                           uint32_t chunk_size,
+                           PDFChunkCB chunk_callback,
+                           PDFCompletedCB completed,
+                           LPVOID param) {
+  // Settings are applied before returning, the host struct may be temporary
+  PDFPrintSettingsData settings_copy{};
+  std::string header_title, footer_url;
+  if (settings) {
+    settings_copy = *settings;
+    header_title = settings->header_title ? settings->header_title : "";
+    footer_url = settings->footer_url ? settings->footer_url : "";
+    settings_copy.header_title = nullptr;
+    settings_copy.footer_url = nullptr;
+  }
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, bool has_settings,
+         PDFPrintSettingsData settings, std::string header_title,
+         std::string footer_url, std::string file_path, uint32_t chunk_size,
+         PDFChunkCB chunk_callback, PDFCompletedCB completed, LPVOID param) {
+        settings.header_title = header_title.c_str();
+        settings.footer_url = footer_url.c_str();
+        auto pdf_settings = CreatePDFPrintSettings(
+            self.get(), has_settings ? &settings : nullptr);
+
+        std::wstring file = Utf8Conv::Utf8ToUtf16(file_path);
+        self->core_webview->PrintToPdfStream(
+            pdf_settings.Get(),
+            WRL::Callback<ICoreWebView2PrintToPdfStreamCompletedHandler>(
+                [file, chunk_size, chunk_callback, completed, param](
+                    HRESULT errorCode, IStream* pdfStream) {
+                  // The stream belongs to the ui apartment, marshal it over
+                  // to the writer thread.
+                  IStream* marshaled_stream = nullptr;
+                  if (FAILED(errorCode) || !pdfStream ||
+                      FAILED(CoMarshalInterThreadInterfaceInStream(
+                          IID_IStream, pdfStream, &marshaled_stream))) {
+                    if (completed)
+                      completed(FALSE, 0, param);
+                    return S_OK;
+                  }
+
+                  std::thread(&WritePDFStream, marshaled_stream, file,
+                              chunk_size ? chunk_size : kDefaultPDFChunkSize,
+                              chunk_callback, completed, param)
+                      .detach();
+
+                  return S_OK;
+                })
+                .Get());
+      },
+      scoped_refptr(obj), !!settings, settings_copy, std::move(header_title),
+      std::move(footer_url), std::string(file_path ? file_path : ""),
+      chunk_size, chunk_callback, completed, param));
+}
+
 LPCSTR WINAPI AddHookScript(BrowserData* obj, LPCSTR script) {
   LPCSTR cpp_str = nullptr;
 
@@ -1250,8 +1420,8 @@ void WINAPI OpenDevtools(BrowserData* obj) {
 void WINAPI SetRequestInterception(BrowserData* obj, BOOL enable) {
   obj->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<BrowserData> self, BOOL enable) {
-        self->core_webview->CallDevToolsProtocolMethod(
-            enable ? L"Fetch.enable" : L"Fetch.disable", L"{}", nullptr);
+        self->cdp_backend->CallMethod(enable ? "Fetch.enable" : "Fetch.disable",
+                                      "{}");
       },
       scoped_refptr(obj), enable));
 }
@@ -1290,9 +1460,7 @@ void WINAPI SetFilechooserInfo(BrowserData* obj, LPCSTR files, int backend_id) {
 
   obj->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<BrowserData> self, json args) {
-        self->core_webview->CallDevToolsProtocolMethod(
-            L"DOM.setFileInputFiles",
-            Utf8Conv::Utf8ToUtf16(args.dump()).c_str(), nullptr);
+        self->cdp_backend->CallMethod("DOM.setFileInputFiles", args.dump());
       },
       scoped_refptr(obj), std::move(args)));
 }
@@ -1321,14 +1489,39 @@ void WINAPI ClearVirtualHostMapping(BrowserData* obj, LPCSTR host) {
 }
 
 uint32_t WINAPI GetFrameCount(BrowserData* obj) {
-  return obj->frames.size();
+  uint32_t count = 0;
+
+  // |frames| is changed by frame events on the ui thread
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         uint32_t* count) {
+        DCHECK_CALLED_ON_VALID_THREAD(self->ui_thread_checker);
+        *count = static_cast<uint32_t>(self->frames.size());
+        sync->Notify();
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), &count));
+  obj->parent->SyncWaitIfNeed();
+
+  return count;
 }
 
 void WINAPI GetFrameAt(BrowserData* obj, int idx, DWORD* retObj) {
-  if (idx < 0 || idx >= obj->frames.size())
+  scoped_refptr<FrameData> frame = nullptr;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         int idx, scoped_refptr<FrameData>* frame) {
+        DCHECK_CALLED_ON_VALID_THREAD(self->ui_thread_checker);
+        if (idx >= 0 && idx < static_cast<int>(self->frames.size()))
+          *frame = self->frames[idx];
+        sync->Notify();
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), idx, &frame));
+  obj->parent->SyncWaitIfNeed();
+
+  if (!frame)
     return;
 
-  scoped_refptr<FrameData> frame = obj->frames[idx];
   if (retObj) {
     frame->AddRef();
     retObj[1] = (DWORD)frame.get();
@@ -1336,6 +1529,35 @@ void WINAPI GetFrameAt(BrowserData* obj, int idx, DWORD* retObj) {
   }
 }
 
+using FrameInfoData = struct {
+  LPCSTR name;
+  LPCSTR url;
+};
+
+// Name and url of every frame as one packed block, see packed_array.h
+LPVOID WINAPI GetFramesPacked(BrowserData* obj) {
+  LPVOID block = nullptr;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         const void* site, LPVOID* block) {
+        PackedArrayBuilder<FrameInfoData> frames(self->frames.size());
+        for (size_t i = 0; i < self->frames.size(); ++i) {
+          wil::unique_cotaskmem_string name = nullptr;
+          self->frames[i]->core_frame->get_Name(&name);
+          frames.SetString(i, &FrameInfoData::name, name);
+          frames.SetString(i, &FrameInfoData::url, self->frames[i]->url);
+        }
+
+        *block = frames.Finish(site);
+        sync->Notify();
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), _ReturnAddress(), &block));
+  obj->parent->SyncWaitIfNeed();
+
+  return block;
+}
+
 void WINAPI SetDefaultDownloadDialogPos(BrowserData* obj, POINT* pt) {
   obj->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<BrowserData> self, POINT pt) {
@@ -1471,9 +1693,8 @@ void WINAPI SetEmitTouchEvents(BrowserData* obj, BOOL enable, LPCSTR conf) {
 
   obj->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<BrowserData> self, json args) {
-        self->core_webview->CallDevToolsProtocolMethod(
-            L"Emulation.setEmitTouchEventsForMouse",
-            Utf8Conv::Utf8ToUtf16(args.dump()).c_str(), nullptr);
+        self->cdp_backend->CallMethod("Emulation.setEmitTouchEventsForMouse",
+                                      args.dump());
       },
       scoped_refptr(obj), std::move(args)));
 }
@@ -1519,9 +1740,8 @@ void WINAPI SetDeviceMetricsOverride(BrowserData* obj,
 
   obj->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<BrowserData> self, json args) {
-        self->core_webview->CallDevToolsProtocolMethod(
-            L"Emulation.setDeviceMetricsOverride",
-            Utf8Conv::Utf8ToUtf16(args.dump()).c_str(), nullptr);
+        self->cdp_backend->CallMethod("Emulation.setDeviceMetricsOverride",
+                                      args.dump());
       },
       scoped_refptr(obj), std::move(args)));
 }
@@ -1529,8 +1749,8 @@ void WINAPI SetDeviceMetricsOverride(BrowserData* obj,
 void WINAPI ClearDeviceMetricsOverride(BrowserData* obj) {
   obj->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<BrowserData> self) {
-        self->core_webview->CallDevToolsProtocolMethod(
-            L"Emulation.clearDeviceMetricsOverride", L"{}", nullptr);
+        self->cdp_backend->CallMethod("Emulation.clearDeviceMetricsOverride",
+                                      "{}");
       },
       scoped_refptr(obj)));
 }
@@ -1549,22 +1769,18 @@ void WINAPI ExecuteScriptCDP(BrowserData* obj,
   obj->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
          json args, RemoteObject* ro) {
-        self->core_webview->CallDevToolsProtocolMethod(
-            L"Runtime.evaluate", Utf8Conv::Utf8ToUtf16(args.dump()).c_str(),
-            WRL::Callback<
-                ICoreWebView2CallDevToolsProtocolMethodCompletedHandler>(
-                [ro, sync = std::move(sync),
-                 weak_ptr = self->weak_ptr_.GetWeakPtr()](
-                    HRESULT errorCode, LPCWSTR returnObjectAsJson) {
-                  json retval =
-                      json::parse(Utf8Conv::Utf16ToUtf8(returnObjectAsJson));
-
-                  JSONToRemoteObject(ro, retval["result"]);
+        self->cdp_backend->CallMethod(
+            "Runtime.evaluate", args.dump(), std::string(),
+            base::BindOnce(
+                [](scoped_refptr<Semaphore> sync, RemoteObject* ro,
+                   int errorCode, const std::string& reply) {
+                  json retval = ParseCDPReply(errorCode, reply);
+                  if (retval.is_object() && retval.contains("result"))
+                    JSONToRemoteObject(ro, retval["result"]);
 
                   sync->Notify();
-                  return S_OK;
-                })
-                .Get());
+                },
+                std::move(sync), ro));
       },
       scoped_refptr(obj), obj->parent->semaphore(), std::move(args), ro));
   obj->parent->SyncWaitIfNeed();
@@ -1589,41 +1805,47 @@ void WINAPI ExecuteScriptCDPAsync(BrowserData* obj,
   obj->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<BrowserData> self, json args,
          ExecuteScriptCDPCallback callback, LPVOID param) {
-        auto handler = WRL::Callback<
-            ICoreWebView2CallDevToolsProtocolMethodCompletedHandler>(
-            [callback, param, weak_ptr = self->weak_ptr_.GetWeakPtr()](
-                HRESULT errorCode, LPCWSTR returnObjectAsJson) {
-              json retval =
-                  json::parse(Utf8Conv::Utf16ToUtf8(returnObjectAsJson));
-
-              weak_ptr->parent->PostEvent(base::BindOnce(
-                  [](const json& retval, ExecuteScriptCDPCallback callback,
-                     LPVOID param) {
-                    RemoteObject* ro =
-                        (RemoteObject*)edgeview_MemAlloc(sizeof(RemoteObject));
-                    JSONToRemoteObject(ro, retval["result"]);
-
-                    callback(ro, sizeof(RemoteObject), param);
-
-                    FreeComString(ro->type);
-                    FreeComString(ro->subtype);
-                    FreeComString(ro->class_name);
-                    FreeComString(ro->raw_value);
-                    FreeComString(ro->unserializable_value);
-                    FreeComString(ro->description);
-                    FreeComString(ro->raw_deepSerializedValue);
-                    FreeComString(ro->objectID);
-
-                    edgeview_MemFree(ro);
-                  },
-                  std::move(retval), callback, param));
-
-              return S_OK;
-            });
+        CDPBackend::ReplyCallback reply;
+        if (callback) {
+          reply = base::BindOnce(
+              [](base::WeakPtr<BrowserData> weak_ptr,
+                 ExecuteScriptCDPCallback callback, LPVOID param,
+                 int errorCode, const std::string& reply_json) {
+                if (!weak_ptr)
+                  return;
+
+                // Failed calls report an undefined result
+                json retval = ParseCDPReply(errorCode, reply_json);
+                if (!retval.is_object() || !retval.contains("result"))
+                  retval = {{"result", {{"type", "undefined"}}}};
+
+                weak_ptr->parent->PostEvent(BindOnceInline(
+                    [](const json& retval, ExecuteScriptCDPCallback callback,
+                       LPVOID param) {
+                      RemoteObject* ro = (RemoteObject*)edgeview_MemAlloc(
+                          sizeof(RemoteObject));
+                      JSONToRemoteObject(ro, retval["result"]);
+
+                      callback(ro, sizeof(RemoteObject), param);
+
+                      FreeComString(ro->type);
+                      FreeComString(ro->subtype);
+                      FreeComString(ro->class_name);
+                      FreeComString(ro->raw_value);
+                      FreeComString(ro->unserializable_value);
+                      FreeComString(ro->description);
+                      FreeComString(ro->raw_deepSerializedValue);
+                      FreeComString(ro->objectID);
+
+                      edgeview_MemFree(ro);
+                    },
+                    std::move(retval), callback, param));
+              },
+              self->weak_ptr_.GetWeakPtr(), callback, param);
+        }
 
-        self->core_webview->CallDevToolsProtocolMethod(
-            L"Runtime.evaluate", Utf8Conv::Utf8ToUtf16(args.dump()).c_str(),
-            callback ? handler.Get() : nullptr);
+        self->cdp_backend->CallMethod("Runtime.evaluate", args.dump(),
+                                      std::string(), std::move(reply));
       },
       scoped_refptr(obj), std::move(args), callback, param));
 }
@@ -1638,27 +1860,16 @@ LPCSTR WINAPI CallCDPMethod(BrowserData* obj,
       [](scoped_refptr<BrowserData> obj, scoped_refptr<Semaphore> sync,
          std::string method, std::string parameter, std::string session,
          LPCSTR* ret_val) {
-        auto callback = WRL::Callback<
-            ICoreWebView2CallDevToolsProtocolMethodCompletedHandler>(
-            [sync, ret_val](HRESULT errorCode, LPCWSTR returnObjectAsJson) {
-              *ret_val = WrapComString(returnObjectAsJson);
-
-              sync->Notify();
-              return S_OK;
-            });
-
-        if (session.empty()) {
-          obj->core_webview->CallDevToolsProtocolMethod(
-              Utf8Conv::Utf8ToUtf16(method).c_str(),
-              Utf8Conv::Utf8ToUtf16(parameter).c_str(),
+        obj->cdp_backend->CallMethod(
+            method, parameter, session,
+            base::BindOnce(
+                [](scoped_refptr<Semaphore> sync, LPCSTR* ret_val,
+                   int errorCode, const std::string& reply) {
+                  *ret_val = WrapComString(reply.c_str());
 
-              callback.Get());
-        } else {
-          obj->core_webview->CallDevToolsProtocolMethodForSession(
-              Utf8Conv::Utf8ToUtf16(session).c_str(),
-              Utf8Conv::Utf8ToUtf16(method).c_str(),
-              Utf8Conv::Utf8ToUtf16(parameter).c_str(), callback.Get());
-        }
+                  sync->Notify();
+                },
+                sync, ret_val));
       },
       scoped_refptr(obj), obj->parent->semaphore(), std::string(method),
       std::string(parameter), session ? std::string(session) : std::string(),
@@ -1679,27 +1890,16 @@ void WINAPI CallCDPMethodAsync(BrowserData* obj,
       [](scoped_refptr<BrowserData> obj, std::string method,
          std::string parameter, std::string session, CallCDPMethodCB callback,
          LPVOID param) {
-        auto handler = WRL::Callback<
-            ICoreWebView2CallDevToolsProtocolMethodCompletedHandler>(
-            [callback, param](HRESULT errorCode, LPCWSTR returnObjectAsJson) {
-              auto json_str = Utf8Conv::Utf16ToUtf8(returnObjectAsJson);
-              callback(json_str.c_str(), param);
-
-              return S_OK;
-            });
-
-        if (session.empty()) {
-          obj->core_webview->CallDevToolsProtocolMethod(
-              Utf8Conv::Utf8ToUtf16(method).c_str(),
-              Utf8Conv::Utf8ToUtf16(parameter).c_str(),
-              callback ? handler.Get() : nullptr);
-        } else {
-          obj->core_webview->CallDevToolsProtocolMethodForSession(
-              Utf8Conv::Utf8ToUtf16(session).c_str(),
-              Utf8Conv::Utf8ToUtf16(method).c_str(),
-              Utf8Conv::Utf8ToUtf16(parameter).c_str(),
-              callback ? handler.Get() : nullptr);
+        CDPBackend::ReplyCallback reply;
+        if (callback) {
+          reply = base::BindOnce(
+              [](CallCDPMethodCB callback, LPVOID param, int errorCode,
+                 const std::string& reply) { callback(reply.c_str(), param); },
+              callback, param);
         }
+
+        obj->cdp_backend->CallMethod(method, parameter, session,
+                                     std::move(reply));
       },
       scoped_refptr(obj), std::string(method), std::string(parameter),
       session ? std::string(session) : std::string(), callback, param));
@@ -1715,38 +1915,14 @@ void WINAPI SetCDPEventReceiver(BrowserData* obj,
   obj->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<BrowserData> obj, std::string event_name,
          CDPEventReceivedCB callback, LPVOID param) {
-        WRL::ComPtr<ICoreWebView2DevToolsProtocolEventReceiver> receiver =
-            nullptr;
-        obj->core_webview->GetDevToolsProtocolEventReceiver(
-            Utf8Conv::Utf8ToUtf16(event_name).c_str(), &receiver);
-
-        receiver->add_DevToolsProtocolEventReceived(
-            WRL::Callback<
-                ICoreWebView2DevToolsProtocolEventReceivedEventHandler>(
-                [callback, param](
-                    ICoreWebView2* sender,
-                    ICoreWebView2DevToolsProtocolEventReceivedEventArgs* args) {
-                  WRL::ComPtr<
-                      ICoreWebView2DevToolsProtocolEventReceivedEventArgs2>
-                      args2 = nullptr;
-                  args->QueryInterface<
-                      ICoreWebView2DevToolsProtocolEventReceivedEventArgs2>(
-                      &args2);
-
-                  wil::unique_cotaskmem_string json_raw = nullptr;
-                  args2->get_ParameterObjectAsJson(&json_raw);
-
-                  wil::unique_cotaskmem_string session = nullptr;
-                  args2->get_SessionId(&session);
-
-                  auto json_str = Utf8Conv::Utf16ToUtf8(json_raw.get());
-                  auto session_str = Utf8Conv::Utf16ToUtf8(session.get());
-                  callback(json_str.c_str(), session_str.c_str(), param);
-
-                  return S_OK;
-                })
-                .Get(),
-            nullptr);
+        obj->cdp_backend->AddEventListener(
+            event_name, base::BindRepeating(
+                            [](CDPEventReceivedCB callback, LPVOID param,
+                               const std::string& params,
+                               const std::string& session) {
+                              callback(params.c_str(), session.c_str(), param);
+                            },
+                            callback, param));
       },
       scoped_refptr(obj), std::string(event_name), callback, param));
 }
@@ -1757,9 +1933,8 @@ void WINAPI SetFilechooserInterception(BrowserData* obj, BOOL enable) {
         json args = json::object();
         args["enabled"] = json::boolean_t(enable);
 
-        self->core_webview->CallDevToolsProtocolMethod(
-            L"Page.setInterceptFileChooserDialog",
-            Utf8Conv::Utf8ToUtf16(args.dump()).c_str(), nullptr);
+        self->cdp_backend->CallMethod("Page.setInterceptFileChooserDialog",
+                                      args.dump());
       },
       scoped_refptr(obj), enable));
 }
@@ -1841,6 +2016,924 @@ void WINAPI NavigateToString(BrowserData* obj, LPCSTR string) {
       scoped_refptr(obj), std::string(string)));
 }
 
+// Installs |source| as globalThis.__edgeview_scripts[name] in a document.
+std::string BuildScriptInstaller(const std::string& name,
+                                 const std::string& source) {
+  return std::format(
+      "(() => {{"
+      "  if (!globalThis.__edgeview_scripts)"
+      "    Object.defineProperty(globalThis, '__edgeview_scripts', {{"
+      "      value: Object.create(null) }});"
+      "  globalThis.__edgeview_scripts[{}] = ({});"
+      "}})();",
+      json(name).dump(), source);
+}
+
+using ScriptReplyCallback = base::OnceCallback<void(json)>;
+
+void CallRegisteredScript(scoped_refptr<BrowserData> self,
+                          const std::string& name,
+                          json arguments,
+                          bool allow_retry,
+                          ScriptReplyCallback reply);
+
+// Resolve the function object once per document and keep its remote handle,
+// later calls only send the handle and the argument values.
+void ResolveRegisteredScript(scoped_refptr<BrowserData> self,
+                             const std::string& name,
+                             json arguments,
+                             ScriptReplyCallback reply) {
+  json args;
+  args["expression"] =
+      std::format("globalThis.__edgeview_scripts && "
+                  "globalThis.__edgeview_scripts[{}]",
+                  json(name).dump());
+  args["returnByValue"] = false;
+  args["silent"] = true;
+
+  self->cdp_backend->CallMethod(
+      "Runtime.evaluate", args.dump(), std::string(),
+      base::BindOnce(
+          [](scoped_refptr<BrowserData> self, std::string name,
+             json arguments, ScriptReplyCallback reply, int errorCode,
+             const std::string& reply_json) {
+            auto it = self->scripts.find(name);
+            json retval = ParseCDPReply(errorCode, reply_json);
+            if (it == self->scripts.end() || !retval.is_object() ||
+                !retval.contains("result"))
+              return std::move(reply).Run(json());
+
+            const json& result = retval["result"];
+            if (result.find("objectId") == result.end() ||
+                result["type"] != "function")
+              return std::move(reply).Run(json());
+
+            it->second.object_id =
+                result["objectId"].template get<std::string>();
+            CallRegisteredScript(self, name, std::move(arguments), false,
+                                 std::move(reply));
+          },
+          self, name, std::move(arguments), std::move(reply)));
+}
+
+void CallRegisteredScript(scoped_refptr<BrowserData> self,
+                          const std::string& name,
+                          json arguments,
+                          bool allow_retry,
+                          ScriptReplyCallback reply) {
+  DCHECK_CALLED_ON_VALID_THREAD(self->ui_thread_checker);
+  auto it = self->scripts.find(name);
+  if (it == self->scripts.end())
+    return std::move(reply).Run(json());
+
+  if (it->second.object_id.empty())
+    return ResolveRegisteredScript(self, name, std::move(arguments),
+                                   std::move(reply));
+
+  json call_args = json::array();
+  for (auto& value : arguments) {
+    json item = json::object();
+    item["value"] = std::move(value);
+    call_args.push_back(std::move(item));
+  }
+
+  json args;
+  args["functionDeclaration"] =
+      "function() { return this.apply(globalThis, arguments); }";
+  args["objectId"] = it->second.object_id;
+  args["arguments"] = std::move(call_args);
+  args["returnByValue"] = true;
+  args["awaitPromise"] = true;
+  args["silent"] = true;
+
+  self->cdp_backend->CallMethod(
+      "Runtime.callFunctionOn", args.dump(), std::string(),
+      base::BindOnce(
+          [](scoped_refptr<BrowserData> self, std::string name,
+             bool allow_retry, json arguments, ScriptReplyCallback reply,
+             int errorCode, const std::string& reply_json) {
+            if (FAILED(errorCode)) {
+              // Stale handle, the document was replaced under us
+              auto it = self->scripts.find(name);
+              if (allow_retry && it != self->scripts.end()) {
+                it->second.object_id.clear();
+                ResolveRegisteredScript(self, name, std::move(arguments),
+                                        std::move(reply));
+              } else {
+                std::move(reply).Run(json());
+              }
+
+              return;
+            }
+
+            json retval = ParseCDPReply(errorCode, reply_json);
+            if (!retval.is_object() ||
+                retval.find("exceptionDetails") != retval.end() ||
+                !retval.contains("result") ||
+                retval["result"].find("value") == retval["result"].end())
+              return std::move(reply).Run(json());
+
+            std::move(reply).Run(std::move(retval["result"]["value"]));
+          },
+          self, name, allow_retry, std::move(arguments), std::move(reply)));
+}
+
+json ParseScriptArguments(LPCSTR json_args) {
+  if (!json_args || !*json_args)
+    return json::array();
+
+  json arguments = json::parse(json_args, nullptr, false);
+  if (arguments.is_discarded())
+    return json::array();
+  if (!arguments.is_array())
+    return json::array({std::move(arguments)});
+
+  return arguments;
+}
+
+BOOL WINAPI RegisterScript(BrowserData* obj, LPCSTR name, LPCSTR source) {
+  BOOL value = FALSE;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         std::string name, std::string source, BOOL* value) {
+        std::wstring installer =
+            Utf8Conv::Utf8ToUtf16(BuildScriptInstaller(name, source));
+
+        // Replace the previous definition of the same name
+        auto it = self->scripts.find(name);
+        if (it != self->scripts.end()) {
+          self->core_webview->RemoveScriptToExecuteOnDocumentCreated(
+              Utf8Conv::Utf8ToUtf16(it->second.hook_id).c_str());
+          self->scripts.erase(it);
+        }
+
+        // Current document first, the hook covers every following one
+        self->core_webview->ExecuteScript(installer.c_str(), nullptr);
+        self->core_webview->AddScriptToExecuteOnDocumentCreated(
+            installer.c_str(),
+            WRL::Callback<
+                ICoreWebView2AddScriptToExecuteOnDocumentCreatedCompletedHandler>(
+                [self, sync, name, value](HRESULT errorCode, LPCWSTR id) {
+                  if (SUCCEEDED(errorCode)) {
+                    self->scripts[name].hook_id = Utf8Conv::Utf16ToUtf8(id);
+                    *value = TRUE;
+                  }
+
+                  sync->Notify();
+                  return S_OK;
+                })
+                .Get());
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), std::string(name),
+      std::string(source), &value));
+  obj->parent->SyncWaitIfNeed();
+
+  return value;
+}
+
+void WINAPI UnregisterScript(BrowserData* obj, LPCSTR name) {
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, std::string name) {
+        auto it = self->scripts.find(name);
+        if (it == self->scripts.end())
+          return;
+
+        self->core_webview->RemoveScriptToExecuteOnDocumentCreated(
+            Utf8Conv::Utf8ToUtf16(it->second.hook_id).c_str());
+        self->scripts.erase(it);
+
+        self->core_webview->ExecuteScript(
+            Utf8Conv::Utf8ToUtf16(
+                std::format("globalThis.__edgeview_scripts && delete "
+                            "globalThis.__edgeview_scripts[{}];",
+                            json(name).dump()))
+                .c_str(),
+            nullptr);
+      },
+      scoped_refptr(obj), std::string(name)));
+}
+
+LPCSTR WINAPI CallScript(BrowserData* obj, LPCSTR name, LPCSTR json_args) {
+  LPCSTR ret_val = nullptr;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         std::string name, json arguments, LPCSTR* ret_val) {
+        CallRegisteredScript(
+            self, name, std::move(arguments), true,
+            base::BindOnce(
+                [](scoped_refptr<Semaphore> sync, LPCSTR* ret_val,
+                   json value) {
+                  if (!value.is_null())
+                    *ret_val = WrapComString(value.dump().c_str());
+
+                  sync->Notify();
+                },
+                sync, ret_val));
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), std::string(name),
+      ParseScriptArguments(json_args), &ret_val));
+  obj->parent->SyncWaitIfNeed();
+
+  return ret_val;
+}
+
+using CallScriptCB = void(CALLBACK*)(LPCSTR json_ret, LPVOID param);
+void WINAPI CallScriptAsync(BrowserData* obj,
+                            LPCSTR name,
+                            LPCSTR json_args,
+                            CallScriptCB callback,
+                            LPVOID param) {
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, std::string name, json arguments,
+         CallScriptCB callback, LPVOID param) {
+        CallRegisteredScript(
+            self, name, std::move(arguments), true,
+            base::BindOnce(
+                [](base::WeakPtr<BrowserData> weak_ptr, CallScriptCB callback,
+                   LPVOID param, json value) {
+                  if (!callback || !weak_ptr)
+                    return;
+
+                  weak_ptr->parent->PostEvent(BindOnceInline(
+                      [](const std::string& json_ret, CallScriptCB callback,
+                         LPVOID param) {
+                        callback(json_ret.empty() ? nullptr : json_ret.c_str(),
+                                 param);
+                      },
+                      value.is_null() ? std::string() : value.dump(), callback,
+                      param));
+                },
+                self->weak_ptr_.GetWeakPtr(), callback, param));
+      },
+      scoped_refptr(obj), std::string(name), ParseScriptArguments(json_args),
+      callback, param));
+}
+
+using CaptureSettingsData = struct {
+  // 0: png, 1: jpeg, 2: webp
+  int format;
+  // Compression quality [0..100], jpeg and webp only
+  int quality;
+  BOOL has_clip;
+  float clip_x;
+  float clip_y;
+  float clip_width;
+  float clip_height;
+  // Clip to the bounds of the first matched element when set
+  LPCSTR selector;
+  // Output scale, 0 keeps the device scale
+  float scale;
+  BOOL optimize_for_speed;
+  BOOL beyond_viewport;
+};
+
+json BuildCaptureArgs(const CaptureSettingsData* settings) {
+  static const char* kFormats[] = {"png", "jpeg", "webp"};
+
+  json args = json::object();
+  if (!settings)
+    return args;
+
+  int format = settings->format;
+  if (format < 0 || format >= static_cast<int>(std::size(kFormats)))
+    format = 0;
+  args["format"] = kFormats[format];
+  if (format)
+    args["quality"] = std::clamp(settings->quality, 0, 100);
+
+  if (settings->has_clip) {
+    json clip = json::object();
+    clip["x"] = settings->clip_x;
+    clip["y"] = settings->clip_y;
+    clip["width"] = settings->clip_width;
+    clip["height"] = settings->clip_height;
+    clip["scale"] = settings->scale > 0 ? settings->scale : 1.0f;
+    args["clip"] = std::move(clip);
+  }
+
+  args["optimizeForSpeed"] = json::boolean_t(settings->optimize_for_speed);
+  args["captureBeyondViewport"] = json::boolean_t(settings->beyond_viewport);
+
+  return args;
+}
+
+// Decode the base64 payload of a Page.captureScreenshot reply without
+// building a json tree for it. The output goes to |buffer| when it fits.
+// Without a buffer it goes to a new block the host frees with
+// edgeview_MemFree when |alloc_site| is set, otherwise to the browser pool
+// which keeps its capacity and is overwritten by the next capture.
+bool DecodeCaptureReply(BrowserData* self,
+                        const std::string& reply,
+                        LPBYTE buffer,
+                        uint32_t buffer_size,
+                        const void* alloc_site,
+                        LPBYTE* img_data,
+                        uint32_t* img_size) {
+  static const char kDataKey[] = "\"data\":\"";
+  DCHECK_CALLED_ON_VALID_THREAD(self->ui_thread_checker);
+
+  *img_data = nullptr;
+  *img_size = 0;
+
+  size_t begin = reply.find(kDataKey);
+  if (begin == std::string::npos)
+    return false;
+  begin += std::size(kDataKey) - 1;
+  size_t end = reply.find('"', begin);
+  if (end == std::string::npos)
+    return false;
+
+  // Anything shorter is not a single base64 quantum
+  size_t src_size = end - begin;
+  if (src_size < 4)
+    return false;
+
+  // Decodes in place from the reply, no narrowing copy
+  const char* src = reply.data() + begin;
+  size_t padding = 0;
+  if (src[src_size - 1] == '=')
+    ++padding;
+  if (src[src_size - 2] == '=')
+    ++padding;
+  size_t decoded_size = src_size / 4 * 3 - padding;
+
+  LPBYTE target = nullptr;
+  if (buffer) {
+    *img_size = decoded_size;
+    if (decoded_size > buffer_size)
+      return false;
+    target = buffer;
+  } else if (alloc_site) {
+    target = static_cast<LPBYTE>(
+        AccountedAlloc(modp_b64_decode_len(src_size), AllocCategory::kBuffer,
+                       alloc_site));
+    if (!target)
+      return false;
+  } else {
+    size_t capacity = modp_b64_decode_len(src_size);
+    if (self->capture_buffer.size() < capacity)
+      self->capture_buffer.resize(capacity);
+    target = self->capture_buffer.data();
+  }
+
+  size_t size =
+      modp_b64_decode(reinterpret_cast<char*>(target), src, src_size);
+  if (size == MODP_B64_ERROR) {
+    if (!buffer && alloc_site)
+      AccountedFree(target);
+    return false;
+  }
+
+  *img_data = target;
+  *img_size = size;
+
+  return true;
+}
+
+// The utf8 Page.captureScreenshot reply, empty when the capture failed
+using CaptureReplyCallback = base::OnceCallback<void(const std::string&)>;
+
+// Measure the clip rectangle in page coordinates when the capture targets an
+// element, or the viewport when only a scale was requested.
+void CaptureWithSettings(scoped_refptr<BrowserData> self,
+                         json args,
+                         std::string selector,
+                         float scale,
+                         CaptureReplyCallback reply) {
+  auto capture = [](scoped_refptr<BrowserData> self, json args,
+                    CaptureReplyCallback reply) {
+    self->cdp_backend->CallMethod(
+        "Page.captureScreenshot", args.dump(), std::string(),
+        base::BindOnce(
+            [](CaptureReplyCallback reply, int errorCode,
+               const std::string& reply_json) {
+              std::move(reply).Run(SUCCEEDED(errorCode) ? reply_json
+                                                        : std::string());
+            },
+            std::move(reply)));
+  };
+
+  bool need_measure = !selector.empty() ||
+                      (args.find("clip") == args.end() && scale > 0 &&
+                       scale != 1.0f);
+  if (!need_measure)
+    return capture(self, std::move(args), std::move(reply));
+
+  json measure;
+  measure["expression"] = std::format(
+      "(() => {{"
+      "  const selector = {};"
+      "  if (!selector)"
+      "    return {{ x: scrollX, y: scrollY, width: innerWidth,"
+      "             height: innerHeight }};"
+      "  const el = document.querySelector(selector);"
+      "  if (!el) return null;"
+      "  const rect = el.getBoundingClientRect();"
+      "  return {{ x: rect.left + scrollX, y: rect.top + scrollY,"
+      "           width: rect.width, height: rect.height }};"
+      "}})()",
+      json(selector).dump());
+  measure["returnByValue"] = true;
+  measure["silent"] = true;
+
+  self->cdp_backend->CallMethod(
+      "Runtime.evaluate", measure.dump(), std::string(),
+      base::BindOnce(
+          [](scoped_refptr<BrowserData> self, decltype(capture) capture,
+             float scale, json args, CaptureReplyCallback reply,
+             int errorCode, const std::string& reply_json) {
+            json rect;
+            json retval = ParseCDPReply(errorCode, reply_json);
+            if (retval.is_object() && retval.contains("result"))
+              rect = retval["result"].value("value", json());
+
+            if (!rect.is_object() || rect.value("width", 0.0) <= 0 ||
+                rect.value("height", 0.0) <= 0)
+              return std::move(reply).Run(std::string());
+
+            rect["scale"] = scale > 0 ? scale : 1.0f;
+            args["clip"] = std::move(rect);
+            capture(self, std::move(args), std::move(reply));
+          },
+          self, capture, scale, std::move(args), std::move(reply)));
+}
+
+// Without |buffer| the image is returned in a new block, the caller owns it
+// and frees it with edgeview_MemFree.
+BOOL WINAPI CaptureScreenshot(BrowserData* obj,
+                              CaptureSettingsData* settings,
+                              LPBYTE buffer,
+                              uint32_t buffer_size,
+                              LPBYTE* img_data,
+                              uint32_t* img_size) {
+  BOOL value = FALSE;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         json args, std::string selector, float scale, LPBYTE buffer,
+         uint32_t buffer_size, const void* alloc_site, LPBYTE* img_data,
+         uint32_t* img_size, BOOL* value) {
+        CaptureWithSettings(
+            self, std::move(args), std::move(selector), scale,
+            base::BindOnce(
+                [](scoped_refptr<BrowserData> self,
+                   scoped_refptr<Semaphore> sync, LPBYTE buffer,
+                   uint32_t buffer_size, const void* alloc_site,
+                   LPBYTE* img_data, uint32_t* img_size, BOOL* value,
+                   const std::string& reply) {
+                  *value =
+                      DecodeCaptureReply(self.get(), reply, buffer,
+                                         buffer_size, alloc_site, img_data,
+                                         img_size);
+                  sync->Notify();
+                },
+                self, sync, buffer, buffer_size, alloc_site, img_data,
+                img_size, value));
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), BuildCaptureArgs(settings),
+      settings && settings->selector ? std::string(settings->selector)
+                                     : std::string(),
+      settings ? settings->scale : 0.0f, buffer, buffer_size,
+      _ReturnAddress(), img_data, img_size, &value));
+  obj->parent->SyncWaitIfNeed();
+
+  return value;
+}
+
+using CaptureScreenshotCB = void(CALLBACK*)(LPBYTE data,
+                                            uint32_t size,
+                                            LPVOID param);
+void WINAPI CaptureScreenshotAsync(BrowserData* obj,
+                                   CaptureSettingsData* settings,
+                                   CaptureScreenshotCB callback,
+                                   LPVOID param) {
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, json args, std::string selector,
+         float scale, CaptureScreenshotCB callback, LPVOID param) {
+        CaptureWithSettings(
+            self, std::move(args), std::move(selector), scale,
+            base::BindOnce(
+                [](scoped_refptr<BrowserData> self,
+                   CaptureScreenshotCB callback, LPVOID param,
+                   const std::string& reply) {
+                  LPBYTE data = nullptr;
+                  uint32_t size = 0;
+                  DecodeCaptureReply(self.get(), reply, nullptr, 0, nullptr,
+                                     &data, &size);
+
+                  // Pool memory stays valid until the next capture, which
+                  // can only start after this ui task returns.
+                  if (callback)
+                    callback(data, size, param);
+                },
+                self, callback, param));
+      },
+      scoped_refptr(obj), BuildCaptureArgs(settings),
+      settings && settings->selector ? std::string(settings->selector)
+                                     : std::string(),
+      settings ? settings->scale : 0.0f, callback, param));
+}
+
+// On success |rects| and |tiles| receive new blocks, the caller owns both and
+// frees them with edgeview_MemFree. Their incoming values are ignored.
+BOOL WINAPI CaptureScreenshotDiff(BrowserData* obj,
+                                  CaptureSettingsData* settings,
+                                  int tile_size,
+                                  BOOL* changed,
+                                  LPVOID* rects,
+                                  LPBYTE* tiles) {
+  BOOL value = FALSE;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         json args, std::string selector, float scale, int tile_size,
+         BOOL* changed, LPVOID* rects, LPBYTE* tiles, BOOL* value) {
+        CaptureWithSettings(
+            self, std::move(args), std::move(selector), scale,
+            base::BindOnce(
+                [](scoped_refptr<BrowserData> self,
+                   scoped_refptr<Semaphore> sync, int tile_size,
+                   BOOL* changed, LPVOID* rects, LPBYTE* tiles, BOOL* value,
+                   const std::string& reply) {
+                  *rects = nullptr;
+                  *tiles = nullptr;
+                  *changed = FALSE;
+
+                  LPBYTE data = nullptr;
+                  uint32_t size = 0;
+                  CaptureDiffer& differ = self->capture_differ;
+                  if (DecodeCaptureReply(self.get(), reply, nullptr, 0,
+                                         nullptr, &data, &size) &&
+                      differ.Update(data, size, tile_size)) {
+                    // Rects as a flat int array: x, y, width, height
+                    const auto& dirty = differ.dirty_rects();
+                    size_t rect_ints = dirty.size() * 4;
+                    LPINT pAry = static_cast<LPINT>(edgeview_MemAlloc(
+                        sizeof(INT) * (2 + rect_ints)));
+                    pAry[0] = 1;
+                    pAry[1] = static_cast<INT>(rect_ints);
+                    if (rect_ints)
+                      memcpy(pAry + 2, dirty.data(), rect_ints * sizeof(INT));
+                    *rects = pAry;
+
+                    size_t pixels_size = differ.DirtyPixelsSize();
+                    LPBYTE pixels = static_cast<LPBYTE>(
+                        edgeview_MemAlloc(pixels_size + sizeof(INT)));
+                    *reinterpret_cast<LPINT>(pixels) =
+                        static_cast<INT>(pixels_size);
+                    differ.CopyDirtyPixels(pixels + sizeof(INT));
+                    *tiles = pixels;
+
+                    *changed = !dirty.empty();
+                    *value = TRUE;
+                  }
+
+                  sync->Notify();
+                },
+                self, sync, tile_size, changed, rects, tiles, value));
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), BuildCaptureArgs(settings),
+      settings && settings->selector ? std::string(settings->selector)
+                                     : std::string(),
+      settings ? settings->scale : 0.0f, tile_size, changed, rects, tiles,
+      &value));
+  obj->parent->SyncWaitIfNeed();
+
+  return value;
+}
+
+void WINAPI ResetCaptureDiff(BrowserData* obj) {
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self) { self->capture_differ.Reset(); },
+      scoped_refptr(obj)));
+}
+
+void StopScreencastInternal(scoped_refptr<BrowserData> self) {
+  DCHECK_CALLED_ON_VALID_THREAD(self->ui_thread_checker);
+  if (!self->screencast)
+    return;
+
+  self->cdp_backend->CallMethod("Page.stopScreencast", "{}");
+  self->cdp_backend->RemoveEventListener(self->screencast->listener_id());
+
+  self->screencast->Stop();
+  self->screencast = nullptr;
+}
+
+void WINAPI StartScreencast(BrowserData* obj,
+                            int format,
+                            int quality,
+                            int max_width,
+                            int max_height,
+                            int every_nth_frame,
+                            int buffered_frames,
+                            ScreencastFrameCB callback,
+                            LPVOID param) {
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, int format, int quality,
+         int max_width, int max_height, int every_nth_frame,
+         int buffered_frames, ScreencastFrameCB callback, LPVOID param) {
+        StopScreencastInternal(self);
+
+        scoped_refptr<ScreencastSession> session = new ScreencastSession(
+            self->weak_ptr_.GetWeakPtr(), self->parent->msg_pump, callback,
+            param, buffered_frames > 0 ? buffered_frames : 2);
+        session->Start();
+
+        session->set_listener_id(self->cdp_backend->AddEventListener(
+            "Page.screencastFrame",
+            base::BindRepeating(
+                [](scoped_refptr<ScreencastSession> session,
+                   const std::string& params, const std::string& session_id) {
+                  session->OnFrameReceived(params);
+                },
+                session)));
+        self->screencast = session;
+
+        json args = json::object();
+        args["format"] = format ? "png" : "jpeg";
+        if (!format && quality > 0)
+          args["quality"] = quality;
+        if (max_width > 0)
+          args["maxWidth"] = max_width;
+        if (max_height > 0)
+          args["maxHeight"] = max_height;
+        if (every_nth_frame > 0)
+          args["everyNthFrame"] = every_nth_frame;
+
+        self->cdp_backend->CallMethod("Page.startScreencast", args.dump());
+      },
+      scoped_refptr(obj), format, quality, max_width, max_height,
+      every_nth_frame, buffered_frames, callback, param));
+}
+
+void WINAPI StopScreencast(BrowserData* obj) {
+  obj->parent->PostUITask(
+      base::BindOnce(&StopScreencastInternal, scoped_refptr(obj)));
+}
+
+// Dispatches |count| synthetic |event|s to the listeners of the browser,
+// "$i" in |params| is replaced by the index. Works with either backend.
+void WINAPI EmitCDPEvents(BrowserData* obj,
+                          LPCSTR event,
+                          LPCSTR params,
+                          uint32_t count) {
+  if (!event || !*event)
+    return;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, std::string event,
+         std::string params, uint32_t count) {
+        self->cdp_backend->EmitEvents(event, params, count);
+      },
+      scoped_refptr(obj), std::string(event),
+      params ? std::string(params) : std::string("{}"), count));
+}
+
+// Swaps the browser to a FakeCDPBackend for load tests, |replies| is a JSON
+// object of method -> reply. From then on commands no longer reach the page
+// and its CDP events no longer arrive, there is no way back.
+BOOL WINAPI UseFakeCDPBackend(BrowserData* obj, LPCSTR replies) {
+  json replies_obj = json::object();
+  if (replies && *replies) {
+    replies_obj = json::parse(replies, nullptr, false);
+    if (!replies_obj.is_object())
+      return FALSE;
+  }
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, json replies_obj) {
+        auto fake = base::MakeRefCounted<FakeCDPBackend>(
+            self.get(), self->parent->msg_pump);
+        fake->SetReplies(replies_obj);
+        fake->AdoptListeners(*self->cdp_backend);
+        self->cdp_backend = fake;
+      },
+      scoped_refptr(obj), std::move(replies_obj)));
+
+  return TRUE;
+}
+
+// Replays a recording made by StartCDPRecording into this browser, see
+// StartCDPReplay. StopCDPReplay ends it.
+BOOL WINAPI ReplayCDPRecording(BrowserData* obj, LPCSTR path, double speed) {
+  if (!path || !*path)
+    return FALSE;
+
+  return StartCDPReplay(obj, Utf8Conv::Utf8ToUtf16(path), speed);
+}
+
+// Collects the metrics of the last |capacity| navigations, 0 stops the
+// collector and drops its records
+BOOL WINAPI SetPageMetricsCollector(BrowserData* obj, uint32_t capacity) {
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, uint32_t capacity) {
+        if (self->page_metrics) {
+          self->page_metrics->Stop();
+          self->page_metrics = nullptr;
+        }
+        if (!capacity)
+          return;
+
+        self->page_metrics = base::MakeRefCounted<PageMetricsCollector>(
+            self->weak_ptr_.GetWeakPtr(), capacity);
+        self->page_metrics->Start();
+      },
+      scoped_refptr(obj), capacity));
+
+  return TRUE;
+}
+
+// JSON array of the collected navigations, oldest first
+LPCSTR WINAPI GetNavigationRecords(BrowserData* obj) {
+  LPCSTR ret_val = nullptr;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         LPCSTR* ret_val) {
+        if (self->page_metrics)
+          *ret_val =
+              WrapComString(self->page_metrics->GetRecords().dump().c_str());
+
+        sync->Notify();
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), &ret_val));
+  obj->parent->SyncWaitIfNeed();
+
+  return ret_val;
+}
+
+// JSON object of origin -> {count, failed, <timing>: {p50, p90, p99}}
+LPCSTR WINAPI GetPageMetricsSummary(BrowserData* obj) {
+  LPCSTR ret_val = nullptr;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         LPCSTR* ret_val) {
+        if (self->page_metrics)
+          *ret_val =
+              WrapComString(self->page_metrics->GetSummary().dump().c_str());
+
+        sync->Notify();
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), &ret_val));
+  obj->parent->SyncWaitIfNeed();
+
+  return ret_val;
+}
+
+// Samples the memory of the page every |params->interval_ms|, |callback|
+// fires when a sample exceeds one of the thresholds. Replaces a running
+// sampler.
+BOOL WINAPI StartMemorySampler(BrowserData* obj,
+                               MemorySamplerParams* params,
+                               MemoryThresholdCB callback,
+                               LPVOID param) {
+  if (!params || !params->interval_ms)
+    return FALSE;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, MemorySamplerParams params,
+         MemoryThresholdCB callback, LPVOID param) {
+        if (self->memory_sampler)
+          self->memory_sampler->Stop();
+
+        self->memory_sampler = base::MakeRefCounted<MemorySampler>(
+            self->weak_ptr_.GetWeakPtr(), self->parent->msg_pump, params,
+            callback, param);
+        self->memory_sampler->Start();
+      },
+      scoped_refptr(obj), *params, callback, param));
+
+  return TRUE;
+}
+
+void WINAPI StopMemorySampler(BrowserData* obj) {
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self) {
+        if (!self->memory_sampler)
+          return;
+
+        self->memory_sampler->Stop();
+        self->memory_sampler = nullptr;
+      },
+      scoped_refptr(obj)));
+}
+
+// Collected samples, oldest first, as a packed array (packed_array.h)
+LPVOID WINAPI GetMemorySamples(BrowserData* obj) {
+  LPVOID block = nullptr;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         const void* site, LPVOID* block) {
+        std::vector<MemorySampleData> samples;
+        if (self->memory_sampler)
+          samples = self->memory_sampler->GetSamples();
+
+        PackedArrayBuilder<MemorySampleData> items(samples.size());
+        for (size_t i = 0; i < samples.size(); ++i)
+          items[i] = samples[i];
+
+        *block = items.Finish(site);
+        sync->Notify();
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), _ReturnAddress(),
+      &block));
+  obj->parent->SyncWaitIfNeed();
+
+  return block;
+}
+
+// Reports idle windows and lifecycle events of the page, |windows| may be
+// null for the defaults. Tracking starts with the first call, states reached
+// before it are unknown.
+BOOL WINAPI SetLoadStateObserver(BrowserData* obj,
+                                 NetworkIdleWindow* windows,
+                                 uint32_t window_count,
+                                 NetworkIdleCB idle_callback,
+                                 LifecycleCB lifecycle_callback,
+                                 LPVOID param) {
+  std::vector<NetworkIdleWindow> window_list;
+  if (windows)
+    window_list.assign(windows, windows + window_count);
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self,
+         std::vector<NetworkIdleWindow> windows, NetworkIdleCB idle_callback,
+         LifecycleCB lifecycle_callback, LPVOID param) {
+        EnsureLoadStateTracker(self.get())
+            ->Configure(std::move(windows), idle_callback, lifecycle_callback,
+                        param);
+      },
+      scoped_refptr(obj), std::move(window_list), idle_callback,
+      lifecycle_callback, param));
+
+  return TRUE;
+}
+
+// WaitForLoadState blocks the calling thread, like the sync DOM waits a
+// missing or larger timeout is capped so a state never reached returns.
+constexpr uint32_t kMaxLoadStateWait = 60 * 1000;
+
+// Blocks until |state| ("load", "DOMContentLoaded", "networkidle0" ...) is
+// reached or |timeout_ms| passes. 0 or anything above a minute waits a
+// minute. Pass |next_document| right after starting a navigation, the
+// current document may have reached the state already.
+BOOL WINAPI WaitForLoadState(BrowserData* obj,
+                             LPCSTR state,
+                             BOOL next_document,
+                             uint32_t timeout_ms) {
+  BOOL value = FALSE;
+  if (!state || !*state)
+    return value;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         std::string state, bool next_document, uint32_t timeout_ms,
+         BOOL* value) {
+        EnsureLoadStateTracker(self.get())
+            ->WaitForState(state, next_document, timeout_ms,
+                           base::BindOnce(
+                               [](scoped_refptr<Semaphore> sync, BOOL* value,
+                                  bool reached) {
+                                 *value = reached;
+                                 sync->Notify();
+                               },
+                               sync, value));
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), std::string(state),
+      !!next_document,
+      timeout_ms ? std::min<uint32_t>(timeout_ms, kMaxLoadStateWait)
+                 : kMaxLoadStateWait,
+      &value));
+  obj->parent->SyncWaitIfNeed();
+
+  return value;
+}
+
+// JSON of the pending request counts, per frame and in total
+LPCSTR WINAPI GetInflightRequests(BrowserData* obj) {
+  LPCSTR ret_val = nullptr;
+
+  obj->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<BrowserData> self, scoped_refptr<Semaphore> sync,
+         LPCSTR* ret_val) {
+        json inflight = self->load_state
+                            ? self->load_state->GetInflightRequests()
+                            : json{{"total", 0}, {"frames", json::object()}};
+        *ret_val = WrapComString(inflight.dump().c_str());
+
+        sync->Notify();
+      },
+      scoped_refptr(obj), obj->parent->semaphore(), &ret_val));
+  obj->parent->SyncWaitIfNeed();
+
+  return ret_val;
+}
+
 }  // namespace
 
 DWORD fnBrowserTable[] = {
@@ -1902,6 +2995,30 @@ DWORD fnBrowserTable[] = {
     (DWORD)GetProfileName,
     (DWORD)RemoveHOOKScript,
     (DWORD)NavigateToString,
+    (DWORD)RegisterScript,
+    (DWORD)UnregisterScript,
+    (DWORD)CallScript,
+    (DWORD)CallScriptAsync,
+    (DWORD)CaptureScreenshot,
+    (DWORD)CaptureScreenshotAsync,
+    (DWORD)StartScreencast,
+    (DWORD)StopScreencast,
+    (DWORD)CaptureScreenshotDiff,
+    (DWORD)ResetCaptureDiff,
+    (DWORD)PrintToPDFFile,
+    (DWORD)GetFramesPacked,
+    (DWORD)EmitCDPEvents,
+    (DWORD)UseFakeCDPBackend,
+    (DWORD)ReplayCDPRecording,
+    (DWORD)SetPageMetricsCollector,
+    (DWORD)GetNavigationRecords,
+    (DWORD)GetPageMetricsSummary,
+    (DWORD)StartMemorySampler,
+    (DWORD)StopMemorySampler,
+    (DWORD)GetMemorySamples,
+    (DWORD)SetLoadStateObserver,
+    (DWORD)WaitForLoadState,
+    (DWORD)GetInflightRequests,
 };  // namespace edgeview
 
 namespace {
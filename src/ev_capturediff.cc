@@ -0,0 +1,58 @@
+#include "ev_capturediff.h"
+
+namespace edgeview {
+
+bool CaptureDiffer::Update(const uint8_t* image,
+                           uint32_t image_size,
+                           int tile_size) {
+  if (!Decode(image, image_size)) {
+    Reset();
+    return false;
+  }
+
+  tiles.Update(&decoded, width, height, tile_size);
+  return true;
+}
+
+bool CaptureDiffer::Decode(const uint8_t* image, uint32_t image_size) {
+  if (!wic_factory &&
+      FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr,
+                              CLSCTX_INPROC_SERVER,
+                              IID_PPV_ARGS(&wic_factory))))
+    return false;
+
+  WRL::ComPtr<IWICStream> stream = nullptr;
+  wic_factory->CreateStream(&stream);
+  if (!stream || FAILED(stream->InitializeFromMemory(
+                     const_cast<BYTE*>(image), image_size)))
+    return false;
+
+  WRL::ComPtr<IWICBitmapDecoder> decoder = nullptr;
+  if (FAILED(wic_factory->CreateDecoderFromStream(
+          stream.Get(), nullptr, WICDecodeMetadataCacheOnDemand, &decoder)))
+    return false;
+
+  WRL::ComPtr<IWICBitmapFrameDecode> frame = nullptr;
+  if (FAILED(decoder->GetFrame(0, &frame)))
+    return false;
+
+  WRL::ComPtr<IWICFormatConverter> converter = nullptr;
+  wic_factory->CreateFormatConverter(&converter);
+  if (!converter ||
+      FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppBGRA,
+                                   WICBitmapDitherTypeNone, nullptr, 0,
+                                   WICBitmapPaletteTypeCustom)))
+    return false;
+
+  converter->GetSize(&width, &height);
+
+  // Reused across captures of the same size
+  const UINT stride = width * 4;
+  decoded.resize(static_cast<size_t>(stride) * height);
+
+  return SUCCEEDED(converter->CopyPixels(nullptr, stride,
+                                         static_cast<UINT>(decoded.size()),
+                                         decoded.data()));
+}
+
+}  // namespace edgeview
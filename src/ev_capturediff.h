@@ -0,0 +1,53 @@
+#pragma once
+
+#pragma comment(lib, "windowscodecs.lib")
+
+#include <wincodec.h>
+
+#include <vector>
+
+#include "ev_capturediff_kernel.h"
+#include "util.h"
+
+namespace edgeview {
+
+// Compares successive captures of one browser. Decodes each capture with WIC
+// and diffs the pixels with a TileDiffer. Ui thread only.
+class CaptureDiffer {
+ public:
+  CaptureDiffer() = default;
+
+  CaptureDiffer(const CaptureDiffer&) = delete;
+  CaptureDiffer& operator=(const CaptureDiffer&) = delete;
+
+  // Decodes |image| and diffs it against the previous frame. The first frame,
+  // or one with a different size or tile size, is reported dirty as a whole.
+  bool Update(const uint8_t* image, uint32_t image_size, int tile_size);
+
+  // Forget the previous frame, the next update reports a full frame
+  void Reset() { tiles.Reset(); }
+
+  const std::vector<DirtyRect>& dirty_rects() const {
+    return tiles.dirty_rects();
+  }
+
+  // Pixels of every dirty rect in order, 32bpp BGRA rows of rect width
+  size_t DirtyPixelsSize() const { return tiles.DirtyPixelsSize(); }
+  void CopyDirtyPixels(uint8_t* target) const {
+    tiles.CopyDirtyPixels(target);
+  }
+
+ private:
+  bool Decode(const uint8_t* image, uint32_t image_size);
+
+  WRL::ComPtr<IWICImagingFactory> wic_factory;
+
+  // Buffer of the frame before the previous one, reused for the next decode
+  std::vector<uint8_t> decoded;
+  UINT width = 0;
+  UINT height = 0;
+
+  TileDiffer tiles;
+};
+
+}  // namespace edgeview
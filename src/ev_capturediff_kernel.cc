@@ -0,0 +1,168 @@
+#include "ev_capturediff_kernel.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace edgeview {
+
+namespace {
+
+constexpr uint64_t kHashPrime = 0x9E3779B97F4A7C15ull;
+constexpr int kDefaultTileSize = 32;
+
+inline uint64_t MixWord(uint64_t lane, uint64_t word) {
+  lane = (lane ^ word) * kHashPrime;
+  return lane ^ (lane >> 29);
+}
+
+inline uint64_t LoadWord(const uint8_t* src) {
+  uint64_t word;
+  memcpy(&word, src, sizeof(word));
+  return word;
+}
+
+}  // namespace
+
+// Four independent lanes keep the multiply chains apart, the compiler is free
+// to vectorize the inner loop without any intrinsics.
+uint64_t HashTile(const uint8_t* origin,
+                  size_t stride,
+                  size_t row_bytes,
+                  size_t rows) {
+  uint64_t lanes[4] = {kHashPrime, kHashPrime << 1, kHashPrime << 2,
+                       kHashPrime << 3};
+
+  for (size_t r = 0; r < rows; ++r) {
+    const uint8_t* row = origin + r * stride;
+
+    size_t i = 0;
+    for (; i + 32 <= row_bytes; i += 32) {
+      lanes[0] = MixWord(lanes[0], LoadWord(row + i));
+      lanes[1] = MixWord(lanes[1], LoadWord(row + i + 8));
+      lanes[2] = MixWord(lanes[2], LoadWord(row + i + 16));
+      lanes[3] = MixWord(lanes[3], LoadWord(row + i + 24));
+    }
+    for (; i + 8 <= row_bytes; i += 8)
+      lanes[0] = MixWord(lanes[0], LoadWord(row + i));
+    for (; i < row_bytes; ++i)
+      lanes[1] = MixWord(lanes[1], row[i]);
+  }
+
+  uint64_t hash = lanes[0];
+  hash = MixWord(hash, lanes[1]);
+  hash = MixWord(hash, lanes[2]);
+  hash = MixWord(hash, lanes[3]);
+
+  return hash;
+}
+
+void TileDiffer::Update(std::vector<uint8_t>* frame,
+                        uint32_t width,
+                        uint32_t height,
+                        int tile_size) {
+  rects.clear();
+
+  if (tile_size <= 0)
+    tile_size = kDefaultTileSize;
+
+  bool full_frame = hashes.empty() || tile != tile_size ||
+                    this->width != width || this->height != height;
+
+  pixels.swap(*frame);
+  this->width = width;
+  this->height = height;
+
+  tile = tile_size;
+  tiles_x = (width + tile - 1) / tile;
+  tiles_y = (height + tile - 1) / tile;
+
+  const size_t stride = static_cast<size_t>(width) * 4;
+  next_hashes.resize(static_cast<size_t>(tiles_x) * tiles_y);
+  std::vector<bool> dirty(next_hashes.size(), full_frame);
+
+  for (int ty = 0; ty < tiles_y; ++ty) {
+    size_t rows = (std::min)(tile, static_cast<int>(height) - ty * tile);
+    for (int tx = 0; tx < tiles_x; ++tx) {
+      size_t cols = (std::min)(tile, static_cast<int>(width) - tx * tile);
+      size_t index = static_cast<size_t>(ty) * tiles_x + tx;
+
+      next_hashes[index] = HashTile(
+          pixels.data() + ty * tile * stride + tx * tile * 4, stride, cols * 4,
+          rows);
+      if (!full_frame && next_hashes[index] != hashes[index])
+        dirty[index] = true;
+    }
+  }
+
+  hashes.swap(next_hashes);
+  MergeDirtyTiles(dirty);
+}
+
+void TileDiffer::Reset() {
+  hashes.clear();
+  rects.clear();
+  width = height = 0;
+}
+
+size_t TileDiffer::DirtyPixelsSize() const {
+  size_t size = 0;
+  for (const auto& rect : rects)
+    size += static_cast<size_t>(rect.width) * rect.height * 4;
+  return size;
+}
+
+void TileDiffer::CopyDirtyPixels(uint8_t* target) const {
+  const size_t stride = static_cast<size_t>(width) * 4;
+  for (const auto& rect : rects) {
+    const size_t row_bytes = static_cast<size_t>(rect.width) * 4;
+    const uint8_t* src = pixels.data() + rect.y * stride + rect.x * 4;
+    for (int r = 0; r < rect.height; ++r) {
+      memcpy(target, src, row_bytes);
+      target += row_bytes;
+      src += stride;
+    }
+  }
+}
+
+void TileDiffer::MergeDirtyTiles(const std::vector<bool>& dirty) {
+  // Runs of dirty tiles in a tile row, extended downwards while the row below
+  // has a run with the same span.
+  std::vector<size_t> open, next_open;
+  for (int ty = 0; ty < tiles_y; ++ty) {
+    int y = ty * tile;
+    int h = (std::min)(tile, static_cast<int>(height) - y);
+
+    next_open.clear();
+    for (int tx = 0; tx < tiles_x;) {
+      if (!dirty[static_cast<size_t>(ty) * tiles_x + tx]) {
+        ++tx;
+        continue;
+      }
+
+      int run_end = tx;
+      while (run_end < tiles_x &&
+             dirty[static_cast<size_t>(ty) * tiles_x + run_end])
+        ++run_end;
+
+      int x = tx * tile;
+      int w = (std::min)(run_end * tile, static_cast<int>(width)) - x;
+
+      auto above = std::find_if(open.begin(), open.end(), [&](size_t i) {
+        return rects[i].x == x && rects[i].width == w;
+      });
+      if (above != open.end()) {
+        rects[*above].height += h;
+        next_open.push_back(*above);
+      } else {
+        next_open.push_back(rects.size());
+        rects.push_back({x, y, w, h});
+      }
+
+      tx = run_end;
+    }
+
+    open.swap(next_open);
+  }
+}
+
+}  // namespace edgeview
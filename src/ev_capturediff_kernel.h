@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace edgeview {
+
+// Handed to the host as is, four ints
+struct DirtyRect {
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+// Hash of |rows| rows of |row_bytes| bytes, |stride| bytes apart
+uint64_t HashTile(const uint8_t* origin,
+                  size_t stride,
+                  size_t row_bytes,
+                  size_t rows);
+
+// Compares successive 32bpp BGRA frames by hashing fixed size tiles. Only the
+// hashes of the previous frame are kept, a diff costs one pass over the
+// pixels. Platform independent, the image decoding lives with the caller.
+class TileDiffer {
+ public:
+  TileDiffer() = default;
+
+  TileDiffer(const TileDiffer&) = delete;
+  TileDiffer& operator=(const TileDiffer&) = delete;
+
+  // Diffs |frame|, |height| rows of |width| pixels, against the previous
+  // frame. The first frame, or one with a different size or tile size, is
+  // reported dirty as a whole. Takes the pixels over and hands the buffer of
+  // the previous frame back in |frame|, to decode the next one into.
+  void Update(std::vector<uint8_t>* frame,
+              uint32_t width,
+              uint32_t height,
+              int tile_size);
+
+  // Forget the previous frame, the next update reports a full frame
+  void Reset();
+
+  const std::vector<DirtyRect>& dirty_rects() const { return rects; }
+
+  // Pixels of every dirty rect in order, 32bpp BGRA rows of rect width
+  size_t DirtyPixelsSize() const;
+  void CopyDirtyPixels(uint8_t* target) const;
+
+ private:
+  void MergeDirtyTiles(const std::vector<bool>& dirty);
+
+  std::vector<uint8_t> pixels;
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+  int tile = 0;
+  int tiles_x = 0;
+  int tiles_y = 0;
+  std::vector<uint64_t> hashes;
+  std::vector<uint64_t> next_hashes;
+
+  std::vector<DirtyRect> rects;
+};
+
+}  // namespace edgeview
@@ -0,0 +1,113 @@
+// TileDiffer over synthetic 1280x720 BGRA frames: an unchanged page, a small
+// change like a blinking caret or a ticking clock, and a frame where every
+// tile changed. Each iteration diffs one frame against the previous one, the
+// frames alternate so the change is seen every time. bytes_per_second counts
+// the pixels hashed, dirty_rects the rects merged per frame.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "ev_capturediff_kernel.h"
+
+namespace edgeview {
+
+namespace {
+
+constexpr uint32_t kWidth = 1280;
+constexpr uint32_t kHeight = 720;
+
+enum class FrameChange {
+  kIdentical,
+  kSmall,
+  kFull,
+};
+
+// Deterministic noise, flat frames would hash the same words over and over
+std::vector<uint8_t> MakeFrame(uint32_t seed) {
+  std::vector<uint8_t> frame(static_cast<size_t>(kWidth) * kHeight * 4);
+  uint32_t state = seed * 2654435761u + 1;
+  for (uint8_t& byte : frame) {
+    state = state * 1664525u + 1013904223u;
+    byte = static_cast<uint8_t>(state >> 24);
+  }
+  return frame;
+}
+
+// |frame| with a 48x24 block near the top left painted over
+std::vector<uint8_t> WithSmallChange(std::vector<uint8_t> frame) {
+  const size_t stride = static_cast<size_t>(kWidth) * 4;
+  for (size_t y = 40; y < 64; ++y) {
+    for (size_t x = 100 * 4; x < 148 * 4; ++x)
+      frame[y * stride + x] ^= 0xFF;
+  }
+  return frame;
+}
+
+void BM_TileDiff(benchmark::State& state, FrameChange change) {
+  const int tile_size = static_cast<int>(state.range(0));
+  std::vector<uint8_t> first = MakeFrame(1);
+  std::vector<uint8_t> next;
+  switch (change) {
+    case FrameChange::kIdentical:
+      next = first;
+      break;
+    case FrameChange::kSmall:
+      next = WithSmallChange(first);
+      break;
+    case FrameChange::kFull:
+      next = MakeFrame(2);
+      break;
+  }
+
+  TileDiffer differ;
+  differ.Update(&first, kWidth, kHeight, tile_size);
+
+  size_t rects = 0;
+  for (auto _ : state) {
+    // Hands back the previous frame, which is what the next update diffs
+    differ.Update(&next, kWidth, kHeight, tile_size);
+    rects += differ.dirty_rects().size();
+    benchmark::DoNotOptimize(differ.dirty_rects().data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * kWidth * kHeight * 4);
+  state.counters["dirty_rects"] = benchmark::Counter(
+      static_cast<double>(rects), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK_CAPTURE(BM_TileDiff, Identical, FrameChange::kIdentical)
+    ->Arg(16)
+    ->Arg(32)
+    ->Arg(64);
+BENCHMARK_CAPTURE(BM_TileDiff, SmallChange, FrameChange::kSmall)
+    ->Arg(16)
+    ->Arg(32)
+    ->Arg(64);
+BENCHMARK_CAPTURE(BM_TileDiff, FullChange, FrameChange::kFull)
+    ->Arg(16)
+    ->Arg(32)
+    ->Arg(64);
+
+// The dirty pixels the export copies out for the host after a small change
+void BM_TileDiffCopyDirtyPixels(benchmark::State& state) {
+  std::vector<uint8_t> first = MakeFrame(1);
+  std::vector<uint8_t> next = WithSmallChange(first);
+
+  TileDiffer differ;
+  differ.Update(&first, kWidth, kHeight, 32);
+  differ.Update(&next, kWidth, kHeight, 32);
+
+  std::vector<uint8_t> target(differ.DirtyPixelsSize());
+  for (auto _ : state) {
+    differ.CopyDirtyPixels(target.data());
+    benchmark::DoNotOptimize(target.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * target.size());
+}
+BENCHMARK(BM_TileDiffCopyDirtyPixels);
+
+}  // namespace
+
+}  // namespace edgeview
@@ -1,6 +1,7 @@
 #include "ev_contextmenu.h"
 
 #include "edgeview_data.h"
+#include "packed_array.h"
 
 namespace edgeview {
 
@@ -162,7 +163,7 @@ void WINAPI CreateMenuItem(ContextMenuParams* obj, LPCSTR label,
                   item->browser = weak_ptr;
                   item->core_item = sender;
 
-                  weak_ptr->parent->PostEvent(base::BindOnce(
+                  weak_ptr->parent->PostEvent(BindOnceInline(
                       [](base::WeakPtr<BrowserData> weak_ptr,
                          scoped_refptr<ContextMenuItem> item) {
                         weak_ptr->dispatcher->OnContextMenuExecute(item);
@@ -248,11 +249,63 @@ void WINAPI InsertValueAt(ContextMenuCollection* obj, uint32_t index,
       scoped_refptr(obj), index, scoped_refptr(item)));
 }
 
+using ContextMenuItemData = struct {
+  LPCSTR name;
+  LPCSTR label;
+  LPCSTR shortcut_desc;
+  int command_id;
+  COREWEBVIEW2_CONTEXT_MENU_ITEM_KIND kind;
+  BOOL enabled;
+  BOOL checked;
+};
+
+// Describes every item of the collection in one packed block, see
+// packed_array.h. Children are not expanded.
+LPVOID WINAPI GetItemsPacked(ContextMenuCollection* obj) {
+  LPVOID block = nullptr;
+
+  obj->browser->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<ContextMenuCollection> obj,
+         scoped_refptr<Semaphore> sync, const void* site, LPVOID* block) {
+        uint32_t size = 0;
+        obj->core_list->get_Count(&size);
+
+        PackedArrayBuilder<ContextMenuItemData> items(size);
+        for (uint32_t i = 0; i < size; ++i) {
+          WRL::ComPtr<ICoreWebView2ContextMenuItem> item = nullptr;
+          obj->core_list->GetValueAtIndex(i, &item);
+
+          wil::unique_cotaskmem_string value = nullptr;
+          item->get_Name(&value);
+          items.SetString(i, &ContextMenuItemData::name, value);
+          item->get_Label(&value);
+          items.SetString(i, &ContextMenuItemData::label, value);
+          item->get_ShortcutKeyDescription(&value);
+          items.SetString(i, &ContextMenuItemData::shortcut_desc, value);
+
+          ContextMenuItemData& data = items[i];
+          item->get_CommandId(&data.command_id);
+          item->get_Kind(&data.kind);
+          item->get_IsEnabled(&data.enabled);
+          item->get_IsChecked(&data.checked);
+        }
+
+        *block = items.Finish(site);
+        sync->Notify();
+      },
+      scoped_refptr(obj), obj->browser->parent->semaphore(), _ReturnAddress(),
+      &block));
+  obj->browser->parent->SyncWaitIfNeed();
+
+  return block;
+}
+
 DWORD fnContextMenuModelTable[] = {
     (DWORD)GetCollectionSize,
     (DWORD)GetValueAt,
     (DWORD)RemoveValueAt,
     (DWORD)InsertValueAt,
+    (DWORD)GetItemsPacked,
 };
 
 LPCSTR WINAPI GetName(ContextMenuItem* obj) {
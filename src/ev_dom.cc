@@ -1,90 +1,104 @@
 #include "ev_dom.h"
 
+#include <algorithm>
+
 #include "edgeview_data.h"
 #include "modp_b64.h"
 
 namespace edgeview {
 
-static void ExecuteScriptAsync(scoped_refptr<BrowserData> browser,
-                               const std::string& script) {
+// The helpers below post for an export, |location| names the export in the
+// api stats rather than the helper.
+static void ExecuteScriptAsync(
+    scoped_refptr<BrowserData> browser,
+    const std::string& script,
+    const std::source_location& location = std::source_location::current()) {
   // Force async task post
-  browser->parent->PostEvent(base::BindOnce(
-      [](scoped_refptr<BrowserData> obj, const std::string& script) {
-        obj->core_webview->ExecuteScript(Utf8Conv::Utf8ToUtf16(script).c_str(),
-                                         nullptr);
-      },
-      browser, script));
+  browser->parent->PostEvent(
+      BindOnceInline(
+          [](scoped_refptr<BrowserData> obj, const std::string& script) {
+            obj->core_webview->ExecuteScript(
+                Utf8Conv::Utf8ToUtf16(script).c_str(), nullptr);
+          },
+          browser, script),
+      location);
 }
 
-static json ExecuteScriptSync(scoped_refptr<BrowserData> browser,
-                              const std::string& script) {
+static json ExecuteScriptSync(
+    scoped_refptr<BrowserData> browser,
+    const std::string& script,
+    const std::source_location& location = std::source_location::current()) {
   json ret_obj = json::object();
 
   // Force async task post
-  browser->parent->PostEvent(base::BindOnce(
-      [](scoped_refptr<BrowserData> obj, scoped_refptr<Semaphore> sync,
-         const std::string& script, json* ret_obj) {
-        obj->core_webview->ExecuteScript(
-            Utf8Conv::Utf8ToUtf16(script).c_str(),
-            WRL::Callback<ICoreWebView2ExecuteScriptCompletedHandler>(
-                [ret_obj, sync](HRESULT errorCode, LPCWSTR resultObjectAsJson) {
-                  if (SUCCEEDED(errorCode)) {
-                    *ret_obj =
-                        json::parse(Utf8Conv::Utf16ToUtf8(resultObjectAsJson));
-                  }
-
-                  sync->Notify();
-                  return S_OK;
-                })
-                .Get());
-      },
-      browser, browser->parent->semaphore(), script, &ret_obj));
+  browser->parent->PostEvent(
+      BindOnceInline(
+          [](scoped_refptr<BrowserData> obj, scoped_refptr<Semaphore> sync,
+             const std::string& script, json* ret_obj) {
+            obj->core_webview->ExecuteScript(
+                Utf8Conv::Utf8ToUtf16(script).c_str(),
+                WRL::Callback<ICoreWebView2ExecuteScriptCompletedHandler>(
+                    [ret_obj, sync](HRESULT errorCode,
+                                    LPCWSTR resultObjectAsJson) {
+                      if (SUCCEEDED(errorCode)) {
+                        *ret_obj = json::parse(
+                            Utf8Conv::Utf16ToUtf8(resultObjectAsJson));
+                      }
+
+                      sync->Notify();
+                      return S_OK;
+                    })
+                    .Get());
+          },
+          browser, browser->parent->semaphore(location), script, &ret_obj),
+      location);
   browser->parent->SyncWaitIfNeed();
 
   return ret_obj;
 }
 
-static void CallCDPMethodAsync(scoped_refptr<BrowserData> browser,
-                               const std::string& method,
-                               const json& args) {
+static void CallCDPMethodAsync(
+    scoped_refptr<BrowserData> browser,
+    const std::string& method,
+    const json& args,
+    const std::source_location& location = std::source_location::current()) {
   // Force async task post
-  browser->parent->PostEvent(base::BindOnce(
-      [](scoped_refptr<BrowserData> obj, const std::string& method,
-         const json& args) {
-        obj->core_webview->CallDevToolsProtocolMethod(
-            Utf8Conv::Utf8ToUtf16(method).c_str(),
-            Utf8Conv::Utf8ToUtf16(args.dump()).c_str(), nullptr);
-      },
-      browser, method, std::move(args)));
-}
-
-static json CallCDPMethodSync(scoped_refptr<BrowserData> browser,
-                              const std::string& method,
-                              const json& args) {
+  browser->parent->PostEvent(
+      BindOnceInline(
+          [](scoped_refptr<BrowserData> obj, const std::string& method,
+             const json& args) {
+            obj->cdp_backend->CallMethod(method, args.dump());
+          },
+          browser, method, std::move(args)),
+      location);
+}
+
+static json CallCDPMethodSync(
+    scoped_refptr<BrowserData> browser,
+    const std::string& method,
+    const json& args,
+    const std::source_location& location = std::source_location::current()) {
   json ret_obj;
 
   // Force async task post
-  browser->parent->PostEvent(base::BindOnce(
-      [](scoped_refptr<BrowserData> obj, scoped_refptr<Semaphore> sync,
-         const std::string& method, const json& args, json* ret_obj) {
-        obj->core_webview->CallDevToolsProtocolMethod(
-            Utf8Conv::Utf8ToUtf16(method).c_str(),
-            Utf8Conv::Utf8ToUtf16(args.dump()).c_str(),
-            WRL::Callback<
-                ICoreWebView2CallDevToolsProtocolMethodCompletedHandler>(
-                [ret_obj, sync](HRESULT errorCode, LPCWSTR resultObjectAsJson) {
-                  if (SUCCEEDED(errorCode)) {
-                    *ret_obj =
-                        json::parse(Utf8Conv::Utf16ToUtf8(resultObjectAsJson));
-                  }
-
-                  sync->Notify();
-                  return S_OK;
-                })
-                .Get());
-      },
-      browser, browser->parent->semaphore(), method, std::move(args),
-      &ret_obj));
+  browser->parent->PostEvent(
+      BindOnceInline(
+          [](scoped_refptr<BrowserData> obj, scoped_refptr<Semaphore> sync,
+             const std::string& method, const json& args, json* ret_obj) {
+            obj->cdp_backend->CallMethod(
+                method, args.dump(), std::string(),
+                base::BindOnce(
+                    [](scoped_refptr<Semaphore> sync, json* ret_obj,
+                       int errorCode, const std::string& reply) {
+                      *ret_obj = ParseCDPReply(errorCode, reply);
+
+                      sync->Notify();
+                    },
+                    sync, ret_obj));
+          },
+          browser, browser->parent->semaphore(location), method,
+          std::move(args), &ret_obj),
+      location);
   browser->parent->SyncWaitIfNeed();
 
   return ret_obj;
@@ -361,6 +375,236 @@ void WINAPI Element_SetFocusState(DOMOperation* obj,
                   focus ? std::string("focus") : std::string("blur")));
 }
 
+using WaitForCompletedCB = void(CALLBACK*)(BOOL satisfied,
+                                            LPCSTR json_value,
+                                            LPVOID param);
+
+enum WaitSelectorState {
+  WAIT_SELECTOR_ATTACHED = 0,
+  WAIT_SELECTOR_DETACHED,
+  WAIT_SELECTOR_VISIBLE,
+  WAIT_SELECTOR_HIDDEN,
+};
+
+// The waiting script resolves inside the renderer and settles exactly once,
+// so the host only pays a single CDP round trip per wait. Structural states
+// are driven by a MutationObserver, visibility is polled on animation frames
+// (falling back to timers while the document is hidden, where rAF is paused).
+static std::string BuildWaitForSelectorScript(const std::string& selector,
+                                              int state,
+                                              int timeout) {
+  return std::format(
+      "new Promise((resolve) => {{"
+      "  const selector = {}, state = {}, timeout = {};"
+      "  const visible = (el) => {{"
+      "    if (!el || !el.isConnected) return false;"
+      "    const style = getComputedStyle(el);"
+      "    if (style.visibility === 'hidden' || style.display === 'none')"
+      "      return false;"
+      "    const rect = el.getBoundingClientRect();"
+      "    return rect.width > 0 && rect.height > 0;"
+      "  }};"
+      "  const check = () => {{"
+      "    const el = document.querySelector(selector);"
+      "    switch (state) {{"
+      "      case 1: return !el;"
+      "      case 2: return visible(el);"
+      "      case 3: return !visible(el);"
+      "      default: return !!el;"
+      "    }}"
+      "  }};"
+      "  if (check()) return resolve(true);"
+      "  let done = false, timer = 0, observer = null;"
+      "  const finish = (value) => {{"
+      "    if (done) return;"
+      "    done = true;"
+      "    if (observer) observer.disconnect();"
+      "    if (timer) clearTimeout(timer);"
+      "    resolve(value);"
+      "  }};"
+      "  if (state < 2) {{"
+      "    observer = new MutationObserver(() => {{ if (check()) finish(true); }});"
+      "    observer.observe(document, {{ childList: true, subtree: true,"
+      "                                 attributes: true }});"
+      "  }} else {{"
+      "    const poll = () => {{"
+      "      if (done) return;"
+      "      if (check()) return finish(true);"
+      "      document.hidden ? setTimeout(poll, 16) : requestAnimationFrame(poll);"
+      "    }};"
+      "    poll();"
+      "  }}"
+      "  if (timeout > 0) timer = setTimeout(() => finish(false), timeout);"
+      "}})",
+      json(selector).dump(), state, timeout);
+}
+
+// |predicate| may be either an expression or a function source; functions are
+// invoked on every poll and the first truthy result is returned by value.
+static std::string BuildWaitForFunctionScript(const std::string& predicate,
+                                              int timeout) {
+  return std::format(
+      "new Promise((resolve) => {{"
+      "  const timeout = {};"
+      "  const evaluate = () => {{"
+      "    const value = ({});"
+      "    return typeof value === 'function' ? value() : value;"
+      "  }};"
+      "  let done = false, timer = 0;"
+      "  const poll = () => {{"
+      "    if (done) return;"
+      "    let value;"
+      "    try {{ value = evaluate(); }} catch (e) {{ value = undefined; }}"
+      "    if (value) {{"
+      "      done = true;"
+      "      if (timer) clearTimeout(timer);"
+      "      return resolve({{ satisfied: true, value: value }});"
+      "    }}"
+      "    document.hidden ? setTimeout(poll, 16) : requestAnimationFrame(poll);"
+      "  }};"
+      "  if (timeout > 0)"
+      "    timer = setTimeout(() => {{"
+      "      done = true;"
+      "      resolve({{ satisfied: false }});"
+      "    }}, timeout);"
+      "  poll();"
+      "}})",
+      timeout, predicate);
+}
+
+// The sync variants block the calling thread until the script settles, a
+// missing or larger timeout is capped so a never satisfied wait returns.
+constexpr int kMaxSyncWaitTimeout = 60 * 1000;
+
+static int ClampSyncWaitTimeout(int timeout) {
+  return timeout > 0 ? std::min<int>(timeout, kMaxSyncWaitTimeout)
+                     : kMaxSyncWaitTimeout;
+}
+
+static json MakeAwaitEvaluateArgs(const std::string& script) {
+  json args;
+  args["expression"] = script;
+  args["returnByValue"] = true;
+  args["awaitPromise"] = true;
+  args["silent"] = true;
+
+  return args;
+}
+
+// Runtime.evaluate reply -> value of the settled promise, null on failure
+// (timeout is reported by the script itself, navigation destroys the context).
+static json ExtractAwaitResult(const json& reply) {
+  if (reply.is_object() && reply.find("exceptionDetails") == reply.end() &&
+      reply.find("result") != reply.end()) {
+    const json& result = reply["result"];
+    if (result.find("value") != result.end())
+      return result["value"];
+  }
+
+  return json();
+}
+
+static void CallCDPMethodWithReply(
+    scoped_refptr<BrowserData> browser,
+    const std::string& method,
+    const json& args,
+    base::OnceCallback<void(json)> reply,
+    const std::source_location& location = std::source_location::current()) {
+  // Force async task post
+  browser->parent->PostEvent(
+      BindOnceInline(
+          [](scoped_refptr<BrowserData> obj, const std::string& method,
+             const json& args, base::OnceCallback<void(json)> reply) {
+            obj->cdp_backend->CallMethod(
+                method, args.dump(), std::string(),
+                base::BindOnce(
+                    [](base::WeakPtr<BrowserData> weak_ptr,
+                       base::OnceCallback<void(json)> reply, int errorCode,
+                       const std::string& reply_json) {
+                      if (weak_ptr) {
+                        weak_ptr->parent->PostEvent(base::BindOnce(
+                            std::move(reply),
+                            ParseCDPReply(errorCode, reply_json)));
+                      }
+                    },
+                    obj->weak_ptr_.GetWeakPtr(), std::move(reply)));
+          },
+          browser, method, args, std::move(reply)),
+      location);
+}
+
+BOOL WINAPI Element_WaitForSelector(DOMOperation* obj,
+                                    LPCSTR selector,
+                                    int state,
+                                    int timeout) {
+  auto ret = CallCDPMethodSync(
+      obj->browser.get(), "Runtime.evaluate",
+      MakeAwaitEvaluateArgs(BuildWaitForSelectorScript(
+          selector, state, ClampSyncWaitTimeout(timeout))));
+
+  json value = ExtractAwaitResult(ret);
+  return value.is_boolean() && value.template get<bool>();
+}
+
+void WINAPI Element_WaitForSelectorAsync(DOMOperation* obj,
+                                         LPCSTR selector,
+                                         int state,
+                                         int timeout,
+                                         WaitForCompletedCB callback,
+                                         LPVOID param) {
+  CallCDPMethodWithReply(
+      obj->browser.get(), "Runtime.evaluate",
+      MakeAwaitEvaluateArgs(
+          BuildWaitForSelectorScript(selector, state, timeout)),
+      base::BindOnce(
+          [](WaitForCompletedCB callback, LPVOID param, json reply) {
+            json value = ExtractAwaitResult(reply);
+            BOOL satisfied = value.is_boolean() && value.template get<bool>();
+
+            if (callback)
+              callback(satisfied, nullptr, param);
+          },
+          callback, param));
+}
+
+LPCSTR WINAPI Element_WaitForFunction(DOMOperation* obj,
+                                      LPCSTR predicate,
+                                      int timeout) {
+  auto ret = CallCDPMethodSync(
+      obj->browser.get(), "Runtime.evaluate",
+      MakeAwaitEvaluateArgs(BuildWaitForFunctionScript(
+          predicate, ClampSyncWaitTimeout(timeout))));
+
+  json value = ExtractAwaitResult(ret);
+  if (!value.is_object() || !value["satisfied"].template get<bool>())
+    return nullptr;
+
+  return WrapComString(value["value"].dump().c_str());
+}
+
+void WINAPI Element_WaitForFunctionAsync(DOMOperation* obj,
+                                         LPCSTR predicate,
+                                         int timeout,
+                                         WaitForCompletedCB callback,
+                                         LPVOID param) {
+  CallCDPMethodWithReply(
+      obj->browser.get(), "Runtime.evaluate",
+      MakeAwaitEvaluateArgs(BuildWaitForFunctionScript(predicate, timeout)),
+      base::BindOnce(
+          [](WaitForCompletedCB callback, LPVOID param, json reply) {
+            json value = ExtractAwaitResult(reply);
+            BOOL satisfied = value.is_object() &&
+                             value["satisfied"].template get<bool>();
+            std::string json_value =
+                satisfied ? value["value"].dump() : std::string();
+
+            if (callback)
+              callback(satisfied, satisfied ? json_value.c_str() : nullptr,
+                       param);
+          },
+          callback, param));
+}
+
 }  // namespace
 
 DWORD fnDOMTable[] = {
@@ -374,7 +618,9 @@ DWORD fnDOMTable[] = {
     (DWORD)Element_Put_Attribute, (DWORD)Element_Get_Checked,
     (DWORD)Element_Put_Checked,   (DWORD)Element_Remove_Attribute,
     (DWORD)Element_SetScrollPos,  (DWORD)Element_GetCanvasData,
-    (DWORD)Element_SetFocusState,
+    (DWORD)Element_SetFocusState, (DWORD)Element_WaitForSelector,
+    (DWORD)Element_WaitForSelectorAsync, (DWORD)Element_WaitForFunction,
+    (DWORD)Element_WaitForFunctionAsync,
 };
 
 }  // namespace edgeview
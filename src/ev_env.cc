@@ -1,6 +1,9 @@
 #include "ev_env.h"
 
 #include "ev_browser.h"
+#include "packed_array.h"
+#include "process_metrics.h"
+#include "webview_cdp_backend.h"
 #include "webview_host.h"
 
 namespace edgeview {
@@ -33,6 +36,7 @@ void WINAPI CreateBrowser(EnvironmentData* obj,
         browser_wrapper->dispatcher = new BrowserEventDispatcher(
             browser_wrapper->weak_ptr_.GetWeakPtr(), lpCallback);
         browser_wrapper->parent = self->weak_ptr_.GetWeakPtr();
+        self->browsers.push_back(browser_wrapper->weak_ptr_.GetWeakPtr());
 
         WRL::ComPtr<ICoreWebView2Environment10> env = nullptr;
         self->core_env->QueryInterface<ICoreWebView2Environment10>(&env);
@@ -58,6 +62,8 @@ void WINAPI CreateBrowser(EnvironmentData* obj,
                   createdController->get_CoreWebView2(&webview2);
                   webview2->QueryInterface<ICoreWebView2_16>(
                       &browser_wrapper->core_webview);
+                  browser_wrapper->cdp_backend = CreateWebViewCDPBackend(
+                      browser_wrapper.get(), browser_wrapper->core_webview);
 
                   browser_wrapper->browser_window->OnSize();
                   BindEventForWebView(browser_wrapper);
@@ -108,6 +114,7 @@ void WINAPI CreateCompositionBrowser(EnvironmentData* obj,
         browser_wrapper->dispatcher = new BrowserEventDispatcher(
             browser_wrapper->weak_ptr_.GetWeakPtr(), lpCallback);
         browser_wrapper->parent = self->weak_ptr_.GetWeakPtr();
+        self->browsers.push_back(browser_wrapper->weak_ptr_.GetWeakPtr());
 
         WRL::ComPtr<ICoreWebView2Environment10> env = nullptr;
         self->core_env->QueryInterface<ICoreWebView2Environment10>(&env);
@@ -141,6 +148,8 @@ void WINAPI CreateCompositionBrowser(EnvironmentData* obj,
                   createdController->get_CoreWebView2(&webview2);
                   webview2->QueryInterface<ICoreWebView2_16>(
                       &browser_wrapper->core_webview);
+                  browser_wrapper->cdp_backend = CreateWebViewCDPBackend(
+                      browser_wrapper.get(), browser_wrapper->core_webview);
 
                   browser_wrapper->browser_window->OnSize();
                   BindEventForWebView(browser_wrapper);
@@ -207,12 +216,79 @@ LPCSTR WINAPI GetChildProcessInfos(EnvironmentData* obj) {
   return WrapComString(processes_info.c_str());
 }
 
+using ProcessInfoData = struct {
+  int pid;
+  COREWEBVIEW2_PROCESS_KIND kind;
+};
+
+// Child processes as one packed block, see packed_array.h
+LPVOID WINAPI GetChildProcessesPacked(EnvironmentData* obj) {
+  LPVOID block = nullptr;
+
+  obj->PostUITask(base::BindOnce(
+      [](scoped_refptr<EnvironmentData> obj, scoped_refptr<Semaphore> sync,
+         const void* site, LPVOID* block) {
+        WRL::ComPtr<ICoreWebView2ProcessInfoCollection> infos = nullptr;
+        obj->core_env->GetProcessInfos(&infos);
+
+        uint32_t size = 0;
+        infos->get_Count(&size);
+
+        PackedArrayBuilder<ProcessInfoData> processes(size);
+        for (uint32_t i = 0; i < size; ++i) {
+          WRL::ComPtr<ICoreWebView2ProcessInfo> process_info = nullptr;
+          infos->GetValueAtIndex(i, &process_info);
+
+          process_info->get_Kind(&processes[i].kind);
+          process_info->get_ProcessId(&processes[i].pid);
+        }
+
+        *block = processes.Finish(site);
+        sync->Notify();
+      },
+      scoped_refptr(obj), obj->semaphore(), _ReturnAddress(), &block));
+  obj->SyncWaitIfNeed();
+
+  return block;
+}
+
+// Child processes as a packed array of ProcessMetricsData, see
+// process_metrics.h. With |incremental| only the processes added, changed or
+// exited since the previous call.
+LPVOID WINAPI GetProcessMetrics(EnvironmentData* obj, BOOL incremental) {
+  LPVOID block = nullptr;
+
+  obj->PostUITask(base::BindOnce(
+      [](scoped_refptr<EnvironmentData> self, scoped_refptr<Semaphore> sync,
+         bool incremental, const void* site, LPVOID* block) {
+        EnumerateProcesses(
+            self.get(),
+            base::BindOnce(
+                [](scoped_refptr<EnvironmentData> self,
+                   scoped_refptr<Semaphore> sync, bool incremental,
+                   const void* site, LPVOID* block,
+                   std::vector<ProcessEntry> processes) {
+                  *block = BuildProcessMetrics(self.get(), processes,
+                                               incremental, site);
+                  sync->Notify();
+                },
+                self, sync, incremental, site, block));
+      },
+      scoped_refptr(obj), obj->semaphore(), !!incremental, _ReturnAddress(),
+      &block));
+  obj->SyncWaitIfNeed();
+
+  return block;
+}
+
 }  // namespace
 
 DWORD fnEnvironmentTable[] = {
     (DWORD)CreateBrowser,
     (DWORD)CreateCompositionBrowser,
     (DWORD)GetChildProcessInfos,
+    (DWORD)GetChildProcessesPacked,
+    (DWORD)GetProcessMetrics,
 };
 
 }  // namespace edgeview
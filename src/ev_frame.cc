@@ -61,7 +61,7 @@ void WINAPI ExecuteJavascriptAsync(FrameData* obj, LPCSTR script,
                     HRESULT errorCode, LPCWSTR resultObjectAsJson) {
                   auto json_ret = Utf8Conv::Utf16ToUtf8(resultObjectAsJson);
 
-                  weak_ptr->parent->PostEvent(base::BindOnce(
+                  weak_ptr->parent->PostEvent(BindOnceInline(
                       [](const std::string& json_ret,
                          ExecuteJavascriptCB callback,
                          LPVOID param) { callback(json_ret.c_str(), param); },
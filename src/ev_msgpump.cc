@@ -1,5 +1,8 @@
 #include "ev_msgpump.h"
 
+#include "api_stats.h"
+#include "hang_watchdog.h"
+
 namespace edgeview {
 
 namespace {
@@ -7,6 +10,10 @@ namespace {
 const wchar_t kWndClass[] = L"EdgeView_MessageWindow";
 const wchar_t kTaskMessageName[] = L"EdgeView_TaskMsgId";
 
+// Tasks run per wake up, the rest is picked up by a new message so input and
+// paint messages are not starved by a flood of events
+constexpr size_t kMaxTasksPerWakeup = 64;
+
 static bool pump_register = false;
 
 void SetUserDataPtr(HWND hWnd, void* ptr) {
@@ -41,13 +48,62 @@ MessagePump::MessagePump()
 
 MessagePump::~MessagePump() { DestroyWindow(message_window); }
 
-void MessagePump::PostTask(base::OnceClosure task) {
+void MessagePump::PostTask(InlineOnceClosure task, const char* name) {
   if (task.is_null()) return;
-  base::OnceClosure* task_ptr = new base::OnceClosure(std::move(task));
 
-  // Post the task for execution by the message window.
-  PostMessage(message_window, task_msgId, reinterpret_cast<WPARAM>(task_ptr),
-              0);
+  uint64_t flow_id = 0;
+  if (name && TraceEnabled(kTraceTasks)) {
+    flow_id = NextTraceFlowId();
+    AddTraceEvent('B', kTraceTasks, name);
+    AddTraceEvent('s', kTraceTasks, name, flow_id);
+    AddTraceEvent('E', kTraceTasks, name);
+  }
+
+  task_queue.Push({std::move(task), name, name ? LatencyNow() : 0, flow_id});
+
+  // One wake up message at a time, it drains everything queued so far.
+  if (!wakeup_posted.exchange(true))
+    PostMessage(message_window, task_msgId, 0, 0);
+}
+
+void MessagePump::RunPendingTasks() {
+  // Cleared before draining: a task queued after the last dequeue below
+  // always sees the flag down and posts a new message.
+  wakeup_posted.store(false);
+
+  PendingTask pending;
+  for (size_t i = 0; i < kMaxTasksPerWakeup; ++i) {
+    if (!task_queue.Pop(&pending)) return;
+
+    const int64_t start_time = pending.name ? LatencyNow() : 0;
+    if (pending.name) {
+      RecordLatency(LatencyCategory::kExport, pending.name,
+                    LatencyKind::kQueueDelay, start_time - pending.posted_time);
+    }
+
+    const bool traced = pending.name && TraceEnabled(kTraceTasks);
+    if (traced) {
+      AddTraceEvent('B', kTraceTasks, pending.name);
+      if (pending.flow_id)
+        AddTraceEvent('f', kTraceTasks, pending.name, pending.flow_id);
+    }
+
+    // Execute the task. It may pump messages itself (sync calls), which
+    // drains the queue further in the nested loop.
+    {
+      HangWatchScope hang_watch(pending.name);
+      std::move(pending.task).Run();
+    }
+
+    if (pending.name) {
+      RecordLatency(LatencyCategory::kExport, pending.name,
+                    LatencyKind::kExecution, LatencyNow() - start_time);
+    }
+    if (traced) AddTraceEvent('E', kTraceTasks, pending.name);
+  }
+
+  if (task_queue.HasPending() && !wakeup_posted.exchange(true))
+    PostMessage(message_window, task_msgId, 0, 0);
 }
 
 LRESULT MessagePump::WndProc(HWND hWnd, UINT message, WPARAM wParam,
@@ -55,10 +111,7 @@ LRESULT MessagePump::WndProc(HWND hWnd, UINT message, WPARAM wParam,
   MessagePump* self = GetUserDataPtr<MessagePump*>(hWnd);
 
   if (self && message == self->task_msgId) {
-    // Execute the task.
-    base::OnceClosure* task = reinterpret_cast<base::OnceClosure*>(wParam);
-    std::move(*task).Run();
-    delete task;
+    self->RunPendingTasks();
   } else {
     switch (message) {
       case WM_NCDESTROY:
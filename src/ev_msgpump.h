@@ -1,27 +1,49 @@
 #pragma once
 
+#include <atomic>
+
 #include "base/bind/callback.h"
 #include "base/memory/ref_counted.h"
-#include "base/third_party/concurrentqueue/blockingconcurrentqueue.h"
+#include "inline_closure.h"
+#include "task_poster.h"
+#include "task_queue.h"
 #include "util.h"
 
 namespace edgeview {
 
-class MessagePump : public base::RefCounted<MessagePump> {
+class MessagePump : public TaskPoster {
  public:
   MessagePump();
-  ~MessagePump();
+  ~MessagePump() override;
 
   MessagePump(const MessagePump&) = delete;
   MessagePump& operator=(const MessagePump&) = delete;
 
-  void PostTask(base::OnceClosure task);
+  // Tasks are queued by value and run in posting order across threads, the
+  // window message only wakes the pump up. Named tasks record their queue
+  // delay and run time in the api stats and are traced from the post to the
+  // run.
+  void PostTask(InlineOnceClosure task, const char* name = nullptr) override;
 
  private:
   static LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam,
                                   LPARAM lParam);
+  void RunPendingTasks();
+
   HWND message_window;
   UINT task_msgId;
+
+  struct PendingTask {
+    InlineOnceClosure task;
+    const char* name = nullptr;
+    int64_t posted_time = 0;
+    // Trace flow from the posting thread, 0 if not traced
+    uint64_t flow_id = 0;
+  };
+
+  TaskQueue<PendingTask> task_queue;
+  // Set while a wake up message is in flight
+  std::atomic_bool wakeup_posted{false};
 };
 
 }  // namespace edgeview
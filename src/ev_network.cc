@@ -2,6 +2,8 @@
 
 #include "edgeview_data.h"
 #include "modp_b64.h"
+#include "packed_array.h"
+#include "string_arena.h"
 
 namespace edgeview {
 
@@ -78,29 +80,25 @@ void WINAPI GetCookies(CookieManagerData* obj, LPCSTR url, LPVOID* ary) {
 
                   uint32_t cookie_size = 0;
                   cookieList->get_Count(&cookie_size);
-                  std::vector<WRL::ComPtr<ICoreWebView2Cookie>> cookies;
+
+                  // E owns every element and string of the array, so they
+                  // stay separate blocks. See GetCookiesPacked for the
+                  // single allocation variant.
+                  LPINT pAry = static_cast<LPINT>(edgeview_MemAlloc(
+                      sizeof(INT) * 2 + sizeof(DWORD) * cookie_size));
+                  pAry[0] = 1;
+                  pAry[1] = cookie_size;
+                  DWORD* pElements = reinterpret_cast<DWORD*>(pAry + 2);
                   for (uint32_t i = 0; i < cookie_size; ++i) {
                     WRL::ComPtr<ICoreWebView2Cookie> cookie;
                     cookieList->GetValueAtIndex(i, &cookie);
-                    cookies.push_back(std::move(cookie));
-                  }
 
-                  DWORD* pStrs = new DWORD[cookies.size()];
-                  for (size_t i = 0; i < cookies.size(); i++) {
                     CookieData* pNewClass = static_cast<CookieData*>(
-                        edgeview_MemAlloc(sizeof(CookieData) * cookies.size()));
-                    TransferCookie(cookies[i], pNewClass);
-                    pStrs[i] = (DWORD)pNewClass;
+                        edgeview_MemAlloc(sizeof(CookieData)));
+                    TransferCookie(cookie, pNewClass);
+                    pElements[i] = (DWORD)pNewClass;
                   }
 
-                  int nSize = cookies.size() * sizeof(DWORD);
-                  LPSTR pAry =
-                      (LPSTR)edgeview_MemAlloc(sizeof(INT) * 2 + nSize);
-                  *(LPINT)pAry = 1;
-                  *(LPINT)(pAry + sizeof(INT)) = cookies.size();
-                  memcpy(pAry + sizeof(INT) * 2, pStrs, nSize);
-                  delete[] pStrs;
-
                   *ary = pAry;
 
                   sync->Notify();
@@ -199,46 +197,95 @@ void WINAPI GetCookiesAsync(CookieManagerData* obj,
       scoped_refptr(obj), url, callback, param));
 }
 
+// Whole cookie list as one packed block of CookieData, see packed_array.h
+LPVOID WINAPI GetCookiesPacked(CookieManagerData* obj, LPCSTR url) {
+  LPVOID block = nullptr;
+
+  obj->browser->parent->PostUITask(base::BindOnce(
+      [](scoped_refptr<CookieManagerData> obj, scoped_refptr<Semaphore> sync,
+         std::string url, const void* site, LPVOID* block) {
+        obj->core_manager->GetCookies(
+            Utf8Conv::Utf8ToUtf16(url).c_str(),
+            WRL::Callback<ICoreWebView2GetCookiesCompletedHandler>(
+                [sync, site, block](HRESULT result,
+                                    ICoreWebView2CookieList* cookieList) {
+                  uint32_t cookie_size = 0;
+                  if (cookieList)
+                    cookieList->get_Count(&cookie_size);
+
+                  PackedArrayBuilder<CookieData> cookies(cookie_size);
+                  for (uint32_t i = 0; i < cookie_size; ++i) {
+                    WRL::ComPtr<ICoreWebView2Cookie> cookie;
+                    cookieList->GetValueAtIndex(i, &cookie);
+
+                    wil::unique_cotaskmem_string value = nullptr;
+                    cookie->get_Name(&value);
+                    cookies.SetString(i, &CookieData::name, value);
+                    cookie->get_Value(&value);
+                    cookies.SetString(i, &CookieData::value, value);
+                    cookie->get_Domain(&value);
+                    cookies.SetString(i, &CookieData::domain, value);
+                    cookie->get_Path(&value);
+                    cookies.SetString(i, &CookieData::path, value);
+
+                    CookieData& data = cookies[i];
+                    double exp;
+                    cookie->get_Expires(&exp);
+                    data.expires = exp;
+
+                    cookie->get_IsHttpOnly(&data.http_only);
+                    cookie->get_SameSite(&data.same_site);
+                    cookie->get_IsSecure(&data.is_secure);
+                    cookie->get_IsSession(&data.is_session);
+                  }
+
+                  *block = cookies.Finish(site);
+
+                  sync->Notify();
+                  return S_OK;
+                })
+                .Get());
+      },
+      scoped_refptr(obj), obj->browser->parent->semaphore(),
+      std::string(url ? url : ""), _ReturnAddress(), &block));
+  obj->browser->parent->SyncWaitIfNeed();
+
+  return block;
+}
+
 DWORD fnCookieManagerTable[] = {
     (DWORD)GetCookies,
     (DWORD)AddOrUpdateCookie,
     (DWORD)DeleteCookie,
     (DWORD)GetCookiesAsync,
+    (DWORD)GetCookiesPacked,
 };
 
-void TransferRequestJSON(const json& from, RequestData* to) {
-  to->url = WrapComString(from["url"].template get<std::string>().c_str());
+void TransferRequestJSON(const json& from,
+                         RequestData* to,
+                         StringArena* arena) {
+  to->url = arena->Wrap(from["url"].template get_ref<const std::string&>());
   to->method =
-      WrapComString(from["method"].template get<std::string>().c_str());
+      arena->Wrap(from["method"].template get_ref<const std::string&>());
 
   std::string str_headers;
   for (auto& it : from["headers"].items())
     str_headers +=
         it.key() + ": " + it.value().template get<std::string>() + "\r\n";
-  to->headers = WrapComString(str_headers.c_str());
+  to->headers = arena->Wrap(str_headers);
 
-  if (from.find("postData") != from.end()) {
-    auto post_data = from["postData"].template get<std::string>();
-    to->post_data = WrapComString(post_data.c_str());
-  }
+  if (from.find("postData") != from.end())
+    to->post_data =
+        arena->Wrap(from["postData"].template get_ref<const std::string&>());
 
   to->has_post_data = false;
   if (from.find("hasPostData") != from.end())
     to->has_post_data = from["hasPostData"].template get<bool>();
 
-  to->initial_priority = WrapComString(
-      from["initialPriority"].template get<std::string>().c_str());
-  to->referrer_policy =
-      WrapComString(from["referrerPolicy"].template get<std::string>().c_str());
-}
-
-void FreeJSONRequest(RequestData* obj) {
-  FreeComString(obj->url);
-  FreeComString(obj->method);
-  FreeComString(obj->headers);
-  FreeComString(obj->post_data);
-  FreeComString(obj->initial_priority);
-  FreeComString(obj->referrer_policy);
+  to->initial_priority = arena->Wrap(
+      from["initialPriority"].template get_ref<const std::string&>());
+  to->referrer_policy = arena->Wrap(
+      from["referrerPolicy"].template get_ref<const std::string&>());
 }
 
 void WINAPI ContinueRequest(ResourceRequestCallback* obj,
@@ -274,9 +321,8 @@ void WINAPI ContinueRequest(ResourceRequestCallback* obj,
 
   obj->browser->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<ResourceRequestCallback> obj, json continue_args) {
-        obj->browser->core_webview->CallDevToolsProtocolMethod(
-            L"Fetch.continueRequest",
-            Utf8Conv::Utf8ToUtf16(continue_args.dump()).c_str(), nullptr);
+        obj->browser->cdp_backend->CallMethod("Fetch.continueRequest",
+                                             continue_args.dump());
       },
       scoped_refptr(obj), std::move(continue_args)));
 }
@@ -292,9 +338,8 @@ void WINAPI FailedRequest(ResourceRequestCallback* obj, LPCSTR failed_reason) {
 
   obj->browser->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<ResourceRequestCallback> obj, json continue_args) {
-        obj->browser->core_webview->CallDevToolsProtocolMethod(
-            L"Fetch.failRequest",
-            Utf8Conv::Utf8ToUtf16(continue_args.dump()).c_str(), nullptr);
+        obj->browser->cdp_backend->CallMethod("Fetch.failRequest",
+                                             continue_args.dump());
       },
       scoped_refptr(obj), std::move(continue_args)));
 }
@@ -339,9 +384,8 @@ void WINAPI FulfillRequest(ResourceRequestCallback* obj,
 
   obj->browser->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<ResourceRequestCallback> obj, json continue_args) {
-        obj->browser->core_webview->CallDevToolsProtocolMethod(
-            L"Fetch.fulfillRequest",
-            Utf8Conv::Utf8ToUtf16(continue_args.dump()).c_str(), nullptr);
+        obj->browser->cdp_backend->CallMethod("Fetch.fulfillRequest",
+                                             continue_args.dump());
       },
       scoped_refptr(obj), std::move(continue_args)));
 }
@@ -386,9 +430,8 @@ void WINAPI ContinueResponse(ResourceResponseCallback* obj,
 
   obj->browser->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<ResourceResponseCallback> obj, json continue_args) {
-        obj->browser->core_webview->CallDevToolsProtocolMethod(
-            L"Fetch.continueResponse",
-            Utf8Conv::Utf8ToUtf16(continue_args.dump()).c_str(), nullptr);
+        obj->browser->cdp_backend->CallMethod("Fetch.continueResponse",
+                                             continue_args.dump());
       },
       scoped_refptr(obj), std::move(continue_args)));
 }
@@ -405,17 +448,15 @@ void WINAPI GetResponseBodyData(ResourceResponseCallback* obj,
   obj->browser->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<ResourceResponseCallback> obj, json continue_args,
          ReceivedResponseCallback callback, LPVOID param) {
-        obj->browser->core_webview->CallDevToolsProtocolMethod(
-            L"Fetch.getResponseBody",
-            Utf8Conv::Utf8ToUtf16(continue_args.dump()).c_str(),
-            WRL::Callback<
-                ICoreWebView2CallDevToolsProtocolMethodCompletedHandler>(
-                [weak_ptr = obj->browser, callback, param](
-                    HRESULT errorCode, LPCWSTR returnObjectAsJson) {
-                  json ret_args =
-                      json::parse(Utf8Conv::Utf16ToUtf8(returnObjectAsJson));
-
-                  weak_ptr->parent->PostEvent(base::BindOnce(
+        obj->browser->cdp_backend->CallMethod(
+            "Fetch.getResponseBody", continue_args.dump(), std::string(),
+            base::BindOnce(
+                [](base::WeakPtr<BrowserData> weak_ptr,
+                   ReceivedResponseCallback callback, LPVOID param,
+                   int errorCode, const std::string& reply) {
+                  json ret_args = json::parse(reply);
+
+                  weak_ptr->parent->PostEvent(BindOnceInline(
                       [](const json& ret_args,
                          ReceivedResponseCallback callback, LPVOID param) {
                         std::string body;
@@ -440,10 +481,8 @@ void WINAPI GetResponseBodyData(ResourceResponseCallback* obj,
                           edgeview_MemFree(lpMem);
                       },
                       std::move(ret_args), callback, param));
-
-                  return S_OK;
-                })
-                .Get());
+                },
+                obj->browser, callback, param));
       },
       scoped_refptr(obj), std::move(continue_args), callback, param));
 }
@@ -458,15 +497,13 @@ void WINAPI GetResponseBodyDataSync(ResourceResponseCallback* obj,
       [](scoped_refptr<ResourceResponseCallback> obj,
          scoped_refptr<Semaphore> sync, json continue_args, LPVOID* data_ptr,
          int32_t* data_size) {
-        obj->browser->core_webview->CallDevToolsProtocolMethod(
-            L"Fetch.getResponseBody",
-            Utf8Conv::Utf8ToUtf16(continue_args.dump()).c_str(),
-            WRL::Callback<
-                ICoreWebView2CallDevToolsProtocolMethodCompletedHandler>(
-                [sync, data_ptr, data_size](HRESULT errorCode,
-                                            LPCWSTR returnObjectAsJson) {
-                  json ret_args =
-                      json::parse(Utf8Conv::Utf16ToUtf8(returnObjectAsJson));
+        obj->browser->cdp_backend->CallMethod(
+            "Fetch.getResponseBody", continue_args.dump(), std::string(),
+            base::BindOnce(
+                [](scoped_refptr<Semaphore> sync, LPVOID* data_ptr,
+                   int32_t* data_size, int errorCode,
+                   const std::string& reply) {
+                  json ret_args = json::parse(reply);
 
                   std::string body;
                   if (ret_args.find("body") != ret_args.end()) {
@@ -487,10 +524,8 @@ void WINAPI GetResponseBodyDataSync(ResourceResponseCallback* obj,
                   *data_size = body.size();
 
                   sync->Notify();
-
-                  return S_OK;
-                })
-                .Get());
+                },
+                sync, data_ptr, data_size));
       },
       scoped_refptr(obj), obj->browser->parent->semaphore(),
       std::move(continue_args), data_ptr, data_size));
@@ -538,9 +573,8 @@ void WINAPI FulfillResponse(ResourceResponseCallback* obj,
 
   obj->browser->parent->PostUITask(base::BindOnce(
       [](scoped_refptr<ResourceResponseCallback> obj, json continue_args) {
-        obj->browser->core_webview->CallDevToolsProtocolMethod(
-            L"Fetch.fulfillRequest",
-            Utf8Conv::Utf8ToUtf16(continue_args.dump()).c_str(), nullptr);
+        obj->browser->cdp_backend->CallMethod("Fetch.fulfillRequest",
+                                             continue_args.dump());
       },
       scoped_refptr(obj), std::move(continue_args)));
 }
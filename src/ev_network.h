@@ -4,6 +4,8 @@
 
 namespace edgeview {
 
+class StringArena;
+
 using RequestData = struct {
   LPCSTR url;
   LPCSTR method;
@@ -20,8 +22,10 @@ using ResponseData = struct {
   LPCSTR response_headers;
 };
 
-void TransferRequestJSON(const json& from, RequestData* to);
-void FreeJSONRequest(RequestData* obj);
+// Strings of |to| live in |arena| and are released with the dispatch scope
+void TransferRequestJSON(const json& from,
+                         RequestData* to,
+                         StringArena* arena);
 
 extern DWORD fnCookieManagerTable[];
 extern DWORD fnResourceRequestCallbackTable[];
@@ -0,0 +1,172 @@
+#include "ev_screencast.h"
+
+#include "edgeview_data.h"
+#include "ev_msgpump.h"
+#include "modp_b64.h"
+
+namespace edgeview {
+
+ScreencastSession::ScreencastSession(base::WeakPtr<BrowserData> browser,
+                                     scoped_refptr<MessagePump> pump,
+                                     ScreencastFrameCB callback,
+                                     LPVOID param,
+                                     size_t ring_size)
+    : browser(browser),
+      msg_pump(pump),
+      callback(callback),
+      param(param),
+      ring(ring_size ? ring_size : 1) {}
+
+ScreencastSession::~ScreencastSession() {
+  Stop();
+}
+
+void ScreencastSession::Start() {
+  // Taken on the ui thread, the decoder only copies it into posted tasks so
+  // the last reference is never dropped on the thread Stop() joins
+  weak_this = weak_ptr_.GetWeakPtr();
+  decoder = std::thread(&ScreencastSession::DecodeLoop, this);
+}
+
+void ScreencastSession::Stop() {
+  stopped.store(true);
+
+  if (decoder.joinable()) {
+    // Empty payload wakes the decoder and ends the loop
+    pending.enqueue(std::string());
+    decoder.join();
+  }
+}
+
+void ScreencastSession::OnFrameReceived(const std::string& params) {
+  if (stopped.load() || params.empty())
+    return;
+
+  pending.enqueue(params);
+}
+
+void ScreencastSession::DecodeLoop() {
+  for (;;) {
+    std::string params;
+    pending.wait_dequeue(params);
+    if (params.empty())
+      break;
+
+    int session_id = 0;
+    bool decoded = DecodeFrame(params, &session_id);
+
+    if (stopped.load())
+      break;
+
+    // Ack broken frames right away, otherwise the renderer stops producing
+    if (!decoded) {
+      msg_pump->PostTask(base::BindOnce(&ScreencastSession::AckFrame,
+                                        weak_this, session_id));
+      continue;
+    }
+
+    bool overwritten = false;
+    int overwritten_session_id = 0;
+    {
+      base::AutoLock lock(ring_lock);
+      if (ring_count == ring.size()) {
+        // Host fell behind, overwrite the oldest frame
+        overwritten = true;
+        overwritten_session_id = ring[ring_head].session_id;
+        ring_head = (ring_head + 1) % ring.size();
+        --ring_count;
+        ++dropped;
+      }
+
+      decoding.session_id = session_id;
+      decoding.meta.dropped_frames = dropped;
+      std::swap(ring[(ring_head + ring_count) % ring.size()], decoding);
+      ++ring_count;
+    }
+
+    if (overwritten)
+      msg_pump->PostTask(base::BindOnce(&ScreencastSession::AckFrame,
+                                        weak_this, overwritten_session_id));
+
+    if (!deliver_posted.exchange(true))
+      msg_pump->PostTask(base::BindOnce(&ScreencastSession::DeliverFrames,
+                                        weak_this));
+  }
+}
+
+bool ScreencastSession::DecodeFrame(const std::string& params,
+                                    int* session_id) {
+  json frame = json::parse(params, nullptr, false);
+  if (frame.is_discarded())
+    return false;
+
+  *session_id = frame.value("sessionId", 0);
+
+  // The slot was swapped out of the ring, do not carry over its metadata
+  decoding.meta = ScreencastFrameMetadata{0};
+  decoding.meta.page_scale_factor = 1.0;
+  if (frame["metadata"].is_object()) {
+    json& meta = frame["metadata"];
+    decoding.meta.timestamp = meta.value("timestamp", 0.0);
+    decoding.meta.offset_top = meta.value("offsetTop", 0.0);
+    decoding.meta.page_scale_factor = meta.value("pageScaleFactor", 1.0);
+    decoding.meta.device_width = meta.value("deviceWidth", 0.0);
+    decoding.meta.device_height = meta.value("deviceHeight", 0.0);
+    decoding.meta.scroll_offset_x = meta.value("scrollOffsetX", 0.0);
+    decoding.meta.scroll_offset_y = meta.value("scrollOffsetY", 0.0);
+  }
+
+  if (!frame["data"].is_string())
+    return false;
+
+  const std::string& data = frame["data"].get_ref<const std::string&>();
+  size_t capacity = modp_b64_decode_len(data.size());
+  // Slot buffers only grow, steady state streaming does not allocate
+  if (decoding.data.size() < capacity)
+    decoding.data.resize(capacity);
+
+  size_t size = modp_b64_decode(reinterpret_cast<char*>(decoding.data.data()),
+                                data.data(), data.size());
+  if (size == MODP_B64_ERROR)
+    return false;
+
+  decoding.size = size;
+
+  return true;
+}
+
+void ScreencastSession::AckFrame(int session_id) {
+  if (stopped.load() || !browser)
+    return;
+
+  json args = json::object();
+  args["sessionId"] = session_id;
+
+  browser->cdp_backend->CallMethod("Page.screencastFrameAck", args.dump());
+}
+
+void ScreencastSession::DeliverFrames() {
+  deliver_posted.store(false);
+
+  while (!stopped.load()) {
+    {
+      base::AutoLock lock(ring_lock);
+      if (!ring_count)
+        break;
+
+      std::swap(ring[ring_head], delivering);
+      ring_head = (ring_head + 1) % ring.size();
+      --ring_count;
+    }
+
+    // Frame memory is valid until the callback returns
+    if (callback)
+      callback(delivering.data.data(), static_cast<uint32_t>(delivering.size),
+               &delivering.meta, param);
+
+    // The renderer sends the next frame once the host took this one
+    AckFrame(delivering.session_id);
+  }
+}
+
+}  // namespace edgeview
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/memory/lock.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/third_party/concurrentqueue/blockingconcurrentqueue.h"
+#include "util.h"
+
+namespace edgeview {
+
+struct BrowserData;
+class MessagePump;
+
+using ScreencastFrameMetadata = struct {
+  double timestamp;
+  double offset_top;
+  double page_scale_factor;
+  double device_width;
+  double device_height;
+  double scroll_offset_x;
+  double scroll_offset_y;
+  // Frames discarded since the session started because the host fell behind
+  uint32_t dropped_frames;
+};
+
+using ScreencastFrameCB = void(CALLBACK*)(LPBYTE data,
+                                          uint32_t size,
+                                          ScreencastFrameMetadata* meta,
+                                          LPVOID param);
+
+// Receives Page.screencastFrame events on the ui thread and hands the
+// payload to a decoder thread. Decoded frames wait in a fixed size ring, the
+// oldest frame is dropped when the host does not keep up. Frames are acked
+// once the host consumed them or the ring dropped them. The renderer keeps
+// only a few unacked frames in flight, so it paces itself to the host and the
+// undecoded queue stays bounded.
+class ScreencastSession
+    : public base::RefCountedThreadSafe<ScreencastSession> {
+ public:
+  ScreencastSession(base::WeakPtr<BrowserData> browser,
+                    scoped_refptr<MessagePump> pump,
+                    ScreencastFrameCB callback,
+                    LPVOID param,
+                    size_t ring_size);
+  ~ScreencastSession();
+
+  ScreencastSession(const ScreencastSession&) = delete;
+  ScreencastSession& operator=(const ScreencastSession&) = delete;
+
+  // Ui thread only
+  void Start();
+  void Stop();
+
+  // Page.screencastFrame parameters, ui thread only
+  void OnFrameReceived(const std::string& params);
+
+  // CDPBackend listener feeding OnFrameReceived
+  int listener_id() const { return listener; }
+  void set_listener_id(int id) { listener = id; }
+
+ private:
+  struct Frame {
+    std::vector<uint8_t> data;
+    size_t size = 0;
+    // Acked when the frame leaves the ring
+    int session_id = 0;
+    ScreencastFrameMetadata meta{0};
+  };
+
+  void DecodeLoop();
+  bool DecodeFrame(const std::string& params, int* session_id);
+  void AckFrame(int session_id);
+  void DeliverFrames();
+
+  base::WeakPtr<BrowserData> browser;
+  scoped_refptr<MessagePump> msg_pump;
+  ScreencastFrameCB callback;
+  LPVOID param;
+  int listener = 0;
+
+  std::thread decoder;
+  moodycamel::BlockingConcurrentQueue<std::string> pending;
+  std::atomic_bool stopped{false};
+  std::atomic_bool deliver_posted{false};
+
+  // Decoder thread only
+  Frame decoding;
+
+  // Ui thread only
+  Frame delivering;
+
+  base::Lock ring_lock{"ScreencastRing"};
+  std::vector<Frame> ring;
+  size_t ring_head = 0;
+  size_t ring_count = 0;
+  uint32_t dropped = 0;
+
+  base::WeakPtr<ScreencastSession> weak_this;
+  base::WeakPtrFactory<ScreencastSession> weak_ptr_{this};
+};
+
+}  // namespace edgeview
@@ -1,13 +1,31 @@
 #include "event_notify.h"
 
+#include "api_stats.h"
 #include "ev_browser.h"
 #include "ev_contextmenu.h"
 #include "ev_download.h"
 #include "ev_frame.h"
+#include "string_arena.h"
 #include "struct_class.h"
 
 namespace edgeview {
 
+namespace {
+
+// String member of |object| without copying it, empty when it is missing or
+// not a string
+const std::string& StringMember(const json& object, const char* key) {
+  static const std::string* empty = new std::string();
+
+  auto it = object.find(key);
+  if (it == object.end() || !it->is_string())
+    return *empty;
+
+  return it->template get_ref<const std::string&>();
+}
+
+}  // namespace
+
 BrowserEventDispatcher::BrowserEventDispatcher(
     base::WeakPtr<BrowserData> browser, LPVOID callback)
     : self(browser), ecallback(callback) {}
@@ -16,6 +34,7 @@ BrowserEventDispatcher::~BrowserEventDispatcher() {}
 
 void BrowserEventDispatcher::OnCreated() {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -43,6 +62,7 @@ void BrowserEventDispatcher::OnCreated() {
 
 void BrowserEventDispatcher::OnCloseRequested() {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -71,6 +91,7 @@ void BrowserEventDispatcher::OnCloseRequested() {
 void BrowserEventDispatcher::OnNewWindowRequested(
     scoped_refptr<NewWindowDelegate> delegate) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -104,6 +125,9 @@ void BrowserEventDispatcher::OnNewWindowRequested(
 
 void BrowserEventDispatcher::OnDocumentTitleChanged(LPCSTR title) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(), [&] {
+    return json{{"title", title ? title : ""}};
+  });
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -133,6 +157,9 @@ void BrowserEventDispatcher::OnDocumentTitleChanged(LPCSTR title) {
 
 void BrowserEventDispatcher::OnFullscreenModeChanged(BOOL fullscreen) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(), [&] {
+    return json{{"fullscreen", !!fullscreen}};
+  });
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -164,6 +191,13 @@ BOOL BrowserEventDispatcher::OnBeforeNavigation(LPCSTR url, BOOL user_gesture,
                                                 LPCSTR headers,
                                                 uint64_t nav_id) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(), [&] {
+    return json{{"url", url ? url : ""},
+                {"userGesture", !!user_gesture},
+                {"isRedirect", !!is_redirect},
+                {"headers", headers ? headers : ""},
+                {"navigationId", nav_id}};
+  });
   BOOL bRetVal = FALSE;
   if (ecallback) {
     LPVOID pClass = ecallback;
@@ -205,6 +239,9 @@ BOOL BrowserEventDispatcher::OnBeforeNavigation(LPCSTR url, BOOL user_gesture,
 void BrowserEventDispatcher::OnContentLoading(BOOL error_page,
                                               uint64_t nav_id) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(), [&] {
+    return json{{"errorPage", !!error_page}, {"navigationId", nav_id}};
+  });
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -237,6 +274,9 @@ void BrowserEventDispatcher::OnContentLoading(BOOL error_page,
 
 void BrowserEventDispatcher::OnSourceChanged(BOOL new_document) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(), [&] {
+    return json{{"newDocument", !!new_document}};
+  });
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -265,6 +305,8 @@ void BrowserEventDispatcher::OnSourceChanged(BOOL new_document) {
 
 void BrowserEventDispatcher::OnHistoryChanged() {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(),
+                          [] { return json::object(); });
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -294,6 +336,11 @@ void BrowserEventDispatcher::OnNavigationComplete(BOOL success,
                                                   int error_status,
                                                   uint64_t nav_id) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(), [&] {
+    return json{{"success", !!success},
+                {"errorStatus", error_status},
+                {"navigationId", nav_id}};
+  });
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -329,6 +376,7 @@ void BrowserEventDispatcher::OnScriptDialogRequested(
     LPCSTR url, int kind, LPCSTR message, LPCSTR deftext,
     scoped_refptr<ScriptDialogDelegate> delegate) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -370,6 +418,7 @@ void BrowserEventDispatcher::OnScriptDialogRequested(
 void BrowserEventDispatcher::OnContextMenuRequested(
     scoped_refptr<ContextMenuParams> params) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -404,6 +453,7 @@ void BrowserEventDispatcher::OnContextMenuRequested(
 void BrowserEventDispatcher::OnContextMenuExecute(
     scoped_refptr<ContextMenuItem> item) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -438,6 +488,7 @@ void BrowserEventDispatcher::OnPermissionRequested(
     LPCSTR url, int kind, BOOL user_gesture,
     scoped_refptr<PermissionDelegate> delegate) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -473,24 +524,28 @@ void BrowserEventDispatcher::OnPermissionRequested(
   }
 }
 
-void BrowserEventDispatcher::OnResourceRequested(json request_parameter) {
+void BrowserEventDispatcher::OnResourceRequested(json parameter) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   scoped_refptr<ResourceRequestCallback> callback =
       new ResourceRequestCallback();
   callback->browser = browser->weak_ptr_.GetWeakPtr();
-  callback->event_parameter = request_parameter;
+  // Moved into the callback object, it outlives this dispatch anyway
+  callback->event_parameter = std::move(parameter);
+  json& request_parameter = callback->event_parameter;
 
-  LPCSTR network_id = WrapComString(
-      request_parameter["requestId"].template get<std::string>().c_str());
-  LPCSTR frame_id = WrapComString(
-      request_parameter["frameId"].template get<std::string>().c_str());
+  ScopedStringArena arena;
+  LPCSTR network_id = arena.Wrap(
+      request_parameter["requestId"].template get_ref<const std::string&>());
+  LPCSTR frame_id = arena.Wrap(
+      request_parameter["frameId"].template get_ref<const std::string&>());
 
-  std::unique_ptr<RequestData> request(new RequestData());
-  RequestData* pReq = request.get();
-  TransferRequestJSON(request_parameter["request"], request.get());
+  RequestData request{};
+  RequestData* pReq = &request;
+  TransferRequestJSON(request_parameter["request"], pReq, arena.get());
 
-  LPCSTR resource_type = WrapComString(
-      request_parameter["resourceType"].template get<std::string>().c_str());
+  LPCSTR resource_type = arena.Wrap(
+      request_parameter["resourceType"].template get_ref<const std::string&>());
 
   if (ecallback) {
     LPVOID pClass = ecallback;
@@ -529,43 +584,40 @@ void BrowserEventDispatcher::OnResourceRequested(json request_parameter) {
     browser->Release();
     callback->Release();
   }
-
-  FreeComString(network_id);
-  FreeComString(frame_id);
-  FreeComString(resource_type);
-
-  FreeJSONRequest(request.get());
 }
 
-void BrowserEventDispatcher::OnResourceReceiveResponse(json request_parameter) {
+void BrowserEventDispatcher::OnResourceReceiveResponse(json parameter) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   scoped_refptr<ResourceResponseCallback> callback =
       new ResourceResponseCallback();
   callback->browser = browser->weak_ptr_.GetWeakPtr();
-  callback->event_parameter = request_parameter;
+  // Moved into the callback object, it outlives this dispatch anyway
+  callback->event_parameter = std::move(parameter);
+  json& request_parameter = callback->event_parameter;
 
-  LPCSTR network_id = WrapComString(
-      request_parameter["requestId"].template get<std::string>().c_str());
-  LPCSTR frame_id = WrapComString(
-      request_parameter["frameId"].template get<std::string>().c_str());
+  ScopedStringArena arena;
+  LPCSTR network_id = arena.Wrap(
+      request_parameter["requestId"].template get_ref<const std::string&>());
+  LPCSTR frame_id = arena.Wrap(
+      request_parameter["frameId"].template get_ref<const std::string&>());
 
-  std::unique_ptr<RequestData> request(new RequestData());
-  RequestData* pReq = request.get();
-  TransferRequestJSON(request_parameter["request"], request.get());
+  RequestData request{};
+  RequestData* pReq = &request;
+  TransferRequestJSON(request_parameter["request"], pReq, arena.get());
 
-  LPCSTR resource_type = WrapComString(
-      request_parameter["resourceType"].template get<std::string>().c_str());
+  LPCSTR resource_type = arena.Wrap(
+      request_parameter["resourceType"].template get_ref<const std::string&>());
 
-  std::unique_ptr<ResponseData> response(new ResponseData());
-  ResponseData* pResponse = response.get();
+  ResponseData response{};
+  ResponseData* pResponse = &response;
 
   {
-    response->response_code =
+    response.response_code =
         request_parameter["responseStatusCode"].template get<int>();
-    response->response_phrase =
-        WrapComString(request_parameter["responseStatusText"]
-                          .template get<std::string>()
-                          .c_str());
+    response.response_phrase =
+        arena.Wrap(request_parameter["responseStatusText"]
+                       .template get_ref<const std::string&>());
 
     std::string header_raw;
     auto headers = request_parameter["responseHeaders"];
@@ -574,7 +626,7 @@ void BrowserEventDispatcher::OnResourceReceiveResponse(json request_parameter) {
                     it["value"].template get<std::string>() + "\r\n";
     }
 
-    response->response_headers = WrapComString(header_raw.c_str());
+    response.response_headers = arena.Wrap(header_raw);
   }
 
   if (ecallback) {
@@ -616,21 +668,13 @@ void BrowserEventDispatcher::OnResourceReceiveResponse(json request_parameter) {
     browser->Release();
     callback->Release();
   }
-
-  FreeComString(network_id);
-  FreeComString(frame_id);
-  FreeComString(resource_type);
-
-  FreeComString(response->response_phrase);
-  FreeComString(response->response_headers);
-
-  FreeJSONRequest(request.get());
 }
 
 BOOL BrowserEventDispatcher::OnKeyEvent(
     COREWEBVIEW2_KEY_EVENT_KIND kind, uint32_t virtual_key, int lparam,
     COREWEBVIEW2_PHYSICAL_KEY_STATUS* status) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   BOOL bRetVal = FALSE;
 
   if (ecallback) {
@@ -670,6 +714,7 @@ void BrowserEventDispatcher::BasicAuthRequested(
     LPCSTR url, LPCSTR challenge,
     scoped_refptr<BasicAuthenticationCallback> callback) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -708,6 +753,7 @@ void BrowserEventDispatcher::BasicAuthRequested(
 void BrowserEventDispatcher::OnReceivedWebMessage(
     scoped_refptr<FrameData> frame, LPCSTR source_url, LPCSTR json_args) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -744,6 +790,7 @@ void BrowserEventDispatcher::OnFileChooserRequested(LPCSTR frame_id,
                                                     BOOL multiselect,
                                                     int node_id) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -775,29 +822,31 @@ void BrowserEventDispatcher::OnFileChooserRequested(LPCSTR frame_id,
 
 void BrowserEventDispatcher::OnConsoleMessage(json args) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
     IMP_NEWECLASS(TempBrowser, browser.get(), eClass::m_pVfTable_Browser,
                   fnBrowserTable);
 
-    json console_event = args["message"];
+    // A missing message reports empty members instead of indexing null
+    static const json* no_message = new json(json::object());
+    auto message = args.find("message");
+    const json& console_event =
+        message != args.end() && message->is_object() ? *message : *no_message;
 
-    LPCSTR pSrc = WrapComString(
-        console_event["source"].template get<std::string>().c_str());
-    LPCSTR pLvl = WrapComString(
-        console_event["level"].template get<std::string>().c_str());
-    LPCSTR pTxt = WrapComString(
-        console_event["text"].template get<std::string>().c_str());
+    ScopedStringArena arena;
+    LPCSTR pSrc = arena.Wrap(StringMember(console_event, "source"));
+    LPCSTR pLvl = arena.Wrap(StringMember(console_event, "level"));
+    LPCSTR pTxt = arena.Wrap(StringMember(console_event, "text"));
 
     LPCSTR pURL = nullptr;
     int line = 0;
     int column = 0;
     if (console_event.find("url") != console_event.end()) {
-      pURL = WrapComString(
-          console_event["url"].template get<std::string>().c_str());
-      line = console_event["line"].template get<int>();
-      column = console_event["column"].template get<int>();
+      pURL = arena.Wrap(StringMember(console_event, "url"));
+      line = console_event.value("line", 0);
+      column = console_event.value("column", 0);
     }
 
     __asm {
@@ -827,17 +876,13 @@ void BrowserEventDispatcher::OnConsoleMessage(json args) {
 			pop ecx;
     }
     browser->Release();
-
-    FreeComString(pSrc);
-    FreeComString(pLvl);
-    FreeComString(pTxt);
-    FreeComString(pURL);
   }
 }
 
 void BrowserEventDispatcher::OnBeforeDownload(
     scoped_refptr<DownloadConfirm> confirm) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -868,6 +913,9 @@ void BrowserEventDispatcher::OnBeforeDownload(
 
 void BrowserEventDispatcher::OnFaviconChanged(LPCSTR favicon) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(), [&] {
+    return json{{"favicon", favicon ? favicon : ""}};
+  });
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -897,6 +945,9 @@ void BrowserEventDispatcher::OnFaviconChanged(LPCSTR favicon) {
 
 void BrowserEventDispatcher::OnAudioStateChanged(BOOL audible) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(), [&] {
+    return json{{"audible", !!audible}};
+  });
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -925,6 +976,9 @@ void BrowserEventDispatcher::OnAudioStateChanged(BOOL audible) {
 
 void BrowserEventDispatcher::OnStatusTextChanged(LPCSTR status) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(), [&] {
+    return json{{"status", status ? status : ""}};
+  });
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -955,6 +1009,9 @@ void BrowserEventDispatcher::OnStatusTextChanged(LPCSTR status) {
 void BrowserEventDispatcher::OnProcessFailed(
     COREWEBVIEW2_PROCESS_FAILED_KIND kind) {
   scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get(), [&] {
+    return json{{"kind", static_cast<int>(kind)}};
+  });
   if (ecallback) {
     LPVOID pClass = ecallback;
     browser->AddRef();
@@ -981,4 +1038,76 @@ void BrowserEventDispatcher::OnProcessFailed(
   }
 }
 
+void BrowserEventDispatcher::OnNetworkIdle(NetworkIdleCB callback,
+                                           uint32_t idle_ms,
+                                           uint32_t max_inflight,
+                                           LPVOID param) {
+  scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
+  if (callback)
+    callback(idle_ms, max_inflight, param);
+}
+
+void BrowserEventDispatcher::OnLifecycle(LifecycleCB callback,
+                                         LPCSTR name,
+                                         LPCSTR frame_id,
+                                         BOOL main_frame,
+                                         LPVOID param) {
+  scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
+  if (callback)
+    callback(name, frame_id, main_frame, param);
+}
+
+void BrowserEventDispatcher::OnMemoryThreshold(MemoryThresholdCB callback,
+                                               uint32_t exceeded,
+                                               MemorySampleData* sample,
+                                               LPVOID param) {
+  scoped_refptr<BrowserData> browser(self.get());
+  HostCallScope host_call(__func__, browser.get());
+  if (callback)
+    callback(exceeded, sample, param);
+}
+
+bool BrowserEventDispatcher::ReplayHostCall(const std::string& method,
+                                            const json& args) {
+  if (!args.is_object())
+    return false;
+
+  const uint64_t nav_id = args.value("navigationId", uint64_t(0));
+  if (method == "OnDocumentTitleChanged") {
+    OnDocumentTitleChanged(StringMember(args, "title").c_str());
+  } else if (method == "OnFullscreenModeChanged") {
+    OnFullscreenModeChanged(args.value("fullscreen", false));
+  } else if (method == "OnBeforeNavigation") {
+    // The recorded navigation already happened, the answer is dropped
+    OnBeforeNavigation(StringMember(args, "url").c_str(),
+                       args.value("userGesture", false),
+                       args.value("isRedirect", false),
+                       StringMember(args, "headers").c_str(), nav_id);
+  } else if (method == "OnContentLoading") {
+    OnContentLoading(args.value("errorPage", false), nav_id);
+  } else if (method == "OnSourceChanged") {
+    OnSourceChanged(args.value("newDocument", false));
+  } else if (method == "OnHistoryChanged") {
+    OnHistoryChanged();
+  } else if (method == "OnNavigationComplete") {
+    OnNavigationComplete(args.value("success", false),
+                         args.value("errorStatus", 0), nav_id);
+  } else if (method == "OnFaviconChanged") {
+    OnFaviconChanged(StringMember(args, "favicon").c_str());
+  } else if (method == "OnAudioStateChanged") {
+    OnAudioStateChanged(args.value("audible", false));
+  } else if (method == "OnStatusTextChanged") {
+    OnStatusTextChanged(StringMember(args, "status").c_str());
+  } else if (method == "OnProcessFailed") {
+    OnProcessFailed(static_cast<COREWEBVIEW2_PROCESS_FAILED_KIND>(
+        args.value("kind", 0)));
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
 }  // namespace edgeview
@@ -64,6 +64,21 @@ class BrowserEventDispatcher : public base::RefCounted<BrowserEventDispatcher> {
   void OnStatusTextChanged(LPCSTR status);
   void OnProcessFailed(COREWEBVIEW2_PROCESS_FAILED_KIND kind);
 
+  // Callbacks the host registered with SetLoadStateObserver. Recorded
+  // without arguments, replaying the CDP events behind them calls them again.
+  void OnNetworkIdle(NetworkIdleCB callback, uint32_t idle_ms,
+                     uint32_t max_inflight, LPVOID param);
+  void OnLifecycle(LifecycleCB callback, LPCSTR name, LPCSTR frame_id,
+                   BOOL main_frame, LPVOID param);
+  // Threshold callback the host registered with StartMemorySampler
+  void OnMemoryThreshold(MemoryThresholdCB callback, uint32_t exceeded,
+                         MemorySampleData* sample, LPVOID param);
+
+  // Calls |method| again with the arguments a CDP recording captured for
+  // it. False for methods recorded without arguments, those carry host
+  // objects or are reproduced by replaying their CDP event.
+  bool ReplayHostCall(const std::string& method, const json& args);
+
  private:
   base::WeakPtr<BrowserData> self;
   LPVOID ecallback = nullptr;
@@ -0,0 +1,44 @@
+#include "fake_cdp_backend.h"
+
+namespace edgeview {
+
+FakeCDPBackend::FakeCDPBackend(const void* browser,
+                               scoped_refptr<TaskPoster> poster)
+    : CDPBackend(browser), poster(poster) {}
+
+void FakeCDPBackend::SendMethod(const std::string& method,
+                                const std::string& params,
+                                const std::string& session,
+                                ReplyCallback callback) {
+  if (callback.is_null())
+    return;
+
+  Reply reply;
+  auto it = replies.find(method);
+  if (it != replies.end())
+    reply = it->second;
+  else
+    reply.body = "{}";
+
+  poster->PostTask(BindOnceInline(
+      [](ReplyCallback callback, Reply reply) {
+        std::move(callback).Run(reply.status, reply.body);
+      },
+      std::move(callback), std::move(reply)));
+}
+
+void FakeCDPBackend::SetReply(const std::string& method,
+                              const std::string& reply,
+                              int status) {
+  replies[method] = {reply, status};
+}
+
+void FakeCDPBackend::SetReplies(const nlohmann::json& replies_obj) {
+  if (!replies_obj.is_object())
+    return;
+
+  for (auto it = replies_obj.begin(); it != replies_obj.end(); ++it)
+    SetReply(it.key(), it.value().dump());
+}
+
+}  // namespace edgeview
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "cdp_backend.h"
+#include "task_poster.h"
+
+namespace edgeview {
+
+// Deterministic CDPBackend without a browser. Calls are answered from
+// scripted replies, asynchronously through |poster| in call order like the
+// real channel. An installed traffic observer sees them like any other
+// traffic. Events are only produced on demand, through EmitEvents.
+class FakeCDPBackend : public CDPBackend {
+ public:
+  FakeCDPBackend(const void* browser, scoped_refptr<TaskPoster> poster);
+
+  FakeCDPBackend(const FakeCDPBackend&) = delete;
+  FakeCDPBackend& operator=(const FakeCDPBackend&) = delete;
+
+  // Methods without a scripted reply answer "{}" with status 0
+  void SetReply(const std::string& method,
+                const std::string& reply,
+                int status = 0);
+  // Object of method name -> reply object
+  void SetReplies(const nlohmann::json& replies);
+
+ protected:
+  void SendMethod(const std::string& method,
+                  const std::string& params,
+                  const std::string& session,
+                  ReplyCallback callback) override;
+
+ private:
+  ~FakeCDPBackend() override = default;
+
+  struct Reply {
+    std::string body;
+    int status = 0;
+  };
+
+  scoped_refptr<TaskPoster> poster;
+  std::map<std::string, Reply> replies;
+};
+
+}  // namespace edgeview
@@ -0,0 +1,170 @@
+#include "fake_cdp_backend.h"
+
+#include <string>
+#include <vector>
+
+#include "base/bind/bind.h"
+#include "gtest/gtest.h"
+#include "task_queue.h"
+
+namespace edgeview {
+
+namespace {
+
+class QueueTaskPoster : public TaskPoster {
+ public:
+  void PostTask(InlineOnceClosure task,
+                const char* name = nullptr) override {
+    queue.Push(std::move(task));
+  }
+
+  void RunPending() {
+    InlineOnceClosure task;
+    while (queue.Pop(&task))
+      std::move(task).Run();
+  }
+
+ private:
+  ~QueueTaskPoster() override = default;
+
+  TaskQueue<InlineOnceClosure> queue;
+};
+
+class RecordingObserver : public CDPTrafficObserver {
+ public:
+  uint64_t OnCommand(const void* browser,
+                     const std::string& method,
+                     const std::string& session,
+                     const std::string& params) override {
+    log.push_back("command " + method);
+    return ++last_id;
+  }
+
+  void OnReply(const void* browser,
+               uint64_t id,
+               int status,
+               const std::string& reply) override {
+    log.push_back("reply " + std::to_string(id) + " " + reply);
+  }
+
+  void OnEvent(const void* browser,
+               const std::string& event,
+               const std::string& session,
+               const std::string& params) override {
+    log.push_back("event " + event);
+  }
+
+  std::vector<std::string> log;
+  uint64_t last_id = 0;
+};
+
+using Replies = std::vector<std::pair<int, std::string>>;
+
+CDPBackend::ReplyCallback CollectReply(Replies* replies) {
+  return base::BindOnce(
+      [](Replies* replies, int status, const std::string& reply) {
+        replies->emplace_back(status, reply);
+      },
+      replies);
+}
+
+TEST(FakeCDPBackendTest, RepliesAsynchronouslyInCallOrder) {
+  auto poster = base::MakeRefCounted<QueueTaskPoster>();
+  auto backend = base::MakeRefCounted<FakeCDPBackend>(nullptr, poster);
+  backend->SetReply("Page.navigate", R"({"frameId":"1"})");
+  backend->SetReply("DOM.getDocument", "{}", -1);
+
+  Replies replies;
+  backend->CallMethod("Page.navigate", "{}", std::string(),
+                      CollectReply(&replies));
+  backend->CallMethod("DOM.getDocument", "{}", std::string(),
+                      CollectReply(&replies));
+  backend->CallMethod("Page.reload", "{}", std::string(),
+                      CollectReply(&replies));
+  EXPECT_TRUE(replies.empty());
+
+  poster->RunPending();
+  ASSERT_EQ(3u, replies.size());
+  EXPECT_EQ(Replies::value_type(0, R"({"frameId":"1"})"), replies[0]);
+  EXPECT_EQ(-1, replies[1].first);
+  EXPECT_EQ(Replies::value_type(0, "{}"), replies[2]);
+
+  EXPECT_TRUE(ParseCDPReply(replies[1].first, replies[1].second).is_null());
+  EXPECT_EQ("1", ParseCDPReply(replies[0].first, replies[0].second)["frameId"]);
+}
+
+TEST(FakeCDPBackendTest, EmitEventsNumbersThePayloads) {
+  auto poster = base::MakeRefCounted<QueueTaskPoster>();
+  auto backend = base::MakeRefCounted<FakeCDPBackend>(nullptr, poster);
+
+  std::vector<std::string> received;
+  int id = backend->AddEventListener(
+      "Network.requestWillBeSent",
+      base::BindRepeating(
+          [](std::vector<std::string>* received, const std::string& params,
+             const std::string& session) { received->push_back(params); },
+          &received));
+  EXPECT_NE(0, id);
+
+  backend->EmitEvents("Network.requestWillBeSent", R"({"requestId":"$i"})",
+                      3);
+  backend->EmitEvents("Network.loadingFinished", "{}", 1);
+  EXPECT_EQ((std::vector<std::string>{R"({"requestId":"0"})",
+                                      R"({"requestId":"1"})",
+                                      R"({"requestId":"2"})"}),
+            received);
+
+  backend->RemoveEventListener(id);
+  backend->EmitEvents("Network.requestWillBeSent", "{}", 1);
+  EXPECT_EQ(3u, received.size());
+}
+
+TEST(FakeCDPBackendTest, AdoptedListenersKeepTheirId) {
+  auto poster = base::MakeRefCounted<QueueTaskPoster>();
+  auto first = base::MakeRefCounted<FakeCDPBackend>(nullptr, poster);
+
+  int calls = 0;
+  int id = first->AddEventListener(
+      "Page.loadEventFired",
+      base::BindRepeating([](int* calls, const std::string& params,
+                             const std::string& session) { ++*calls; },
+                          &calls));
+
+  auto second = base::MakeRefCounted<FakeCDPBackend>(nullptr, poster);
+  second->AdoptListeners(*first);
+  second->DispatchEvent("Page.loadEventFired", "{}");
+  EXPECT_EQ(1, calls);
+
+  second->RemoveEventListener(id);
+  second->DispatchEvent("Page.loadEventFired", "{}");
+  EXPECT_EQ(1, calls);
+}
+
+TEST(FakeCDPBackendTest, ObserverSeesTheTraffic) {
+  auto poster = base::MakeRefCounted<QueueTaskPoster>();
+  auto backend = base::MakeRefCounted<FakeCDPBackend>(nullptr, poster);
+  backend->SetReply("Runtime.evaluate", R"({"result":{}})");
+
+  RecordingObserver observer;
+  SetCDPTrafficObserver(&observer);
+
+  Replies replies;
+  backend->CallMethod("Runtime.evaluate", "{}", std::string(),
+                      CollectReply(&replies));
+  backend->CallMethod("Page.enable", "{}");
+  backend->DispatchEvent("Page.frameNavigated", "{}");
+  poster->RunPending();
+
+  SetCDPTrafficObserver(nullptr);
+  backend->DispatchEvent("Page.frameNavigated", "{}");
+
+  EXPECT_EQ((std::vector<std::string>{
+                "command Runtime.evaluate", "command Page.enable",
+                "event Page.frameNavigated", R"(reply 1 {"result":{}})"}),
+            observer.log);
+  EXPECT_EQ(1u, replies.size());
+}
+
+}  // namespace
+
+}  // namespace edgeview
@@ -0,0 +1,299 @@
+#include "hang_watchdog.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "api_stats.h"
+#include "base/memory/lock.h"
+
+namespace edgeview {
+
+std::atomic<uint32_t> g_hang_threshold_ms{0};
+
+namespace {
+
+// Heartbeat of one thread running pump tasks. Written by the owning thread,
+// sampled by the watchdog; the fields are read one by one, which is good
+// enough for a report.
+struct WatchedThread {
+  WatchedThread() : thread_id(GetCurrentThreadId()) {}
+
+  const DWORD thread_id;
+  std::atomic<int64_t> last_beat{0};
+  std::atomic<uint32_t> depth{0};
+  // Bumped on every task start and end, tells stalls apart
+  std::atomic<uint64_t> beats{0};
+  std::atomic<const char*> task{nullptr};
+  std::atomic<const char*> host_call{nullptr};
+  std::atomic<const void*> browser{nullptr};
+
+  // Watchdog side: |beats| of the stall reported last
+  uint64_t reported_beat = 0;
+  std::string reported_name;
+};
+
+struct EventHangStats {
+  uint64_t slow_calls = 0;  // Host calls which returned past the threshold
+  uint64_t hangs = 0;       // Stalls the watchdog caught while running
+  int64_t max_stall_ms = 0;
+};
+
+class HangWatchdog {
+ public:
+  static HangWatchdog* GetInstance() {
+    // Leaked on purpose, watched threads may outlive static destruction
+    static HangWatchdog* instance = new HangWatchdog();
+    return instance;
+  }
+
+  HangWatchdog(const HangWatchdog&) = delete;
+  HangWatchdog& operator=(const HangWatchdog&) = delete;
+
+  void Start(uint32_t threshold_ms, HangDetectedCB cb, LPVOID cb_param) {
+    base::AutoLock auto_lock(control_lock);
+    StopLocked();
+
+    {
+      base::AutoLock stats_auto_lock(stats_lock);
+      callback = cb;
+      param = cb_param;
+    }
+
+    if (!stop_event)
+      stop_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    g_hang_threshold_ms.store(threshold_ms);
+    watchdog = std::thread(&HangWatchdog::WatchdogThread, this, threshold_ms);
+  }
+
+  void Stop() {
+    base::AutoLock auto_lock(control_lock);
+    StopLocked();
+  }
+
+  WatchedThread* CurrentThread() {
+    static thread_local ThreadHolder holder;
+    if (!holder.thread) {
+      holder.thread = std::make_shared<WatchedThread>();
+
+      base::AutoLock auto_lock(threads_lock);
+      threads.push_back(holder.thread);
+    }
+
+    return holder.thread.get();
+  }
+
+  void RecordSlowCall(const char* name, int64_t elapsed_ms) {
+    base::AutoLock auto_lock(stats_lock);
+    EventHangStats& stats = events[name];
+    ++stats.slow_calls;
+    stats.max_stall_ms = std::max<int64_t>(stats.max_stall_ms, elapsed_ms);
+  }
+
+  json GetStats() {
+    base::AutoLock auto_lock(stats_lock);
+
+    json result = json::object();
+    result["threshold_ms"] = g_hang_threshold_ms.load();
+    result["hangs"] = total_hangs;
+
+    json items = json::object();
+    for (const auto& it : events) {
+      json item = json::object();
+      item["slow_calls"] = it.second.slow_calls;
+      item["hangs"] = it.second.hangs;
+      item["max_stall_ms"] = it.second.max_stall_ms;
+      items[it.first] = std::move(item);
+    }
+    result["events"] = std::move(items);
+    result["last_hang"] = last_hang;
+
+    return result;
+  }
+
+ private:
+  struct ThreadHolder {
+    ~ThreadHolder() {
+      if (!thread)
+        return;
+
+      base::AutoLock auto_lock(GetInstance()->threads_lock);
+      auto& list = GetInstance()->threads;
+      list.erase(std::remove(list.begin(), list.end(), thread), list.end());
+    }
+
+    std::shared_ptr<WatchedThread> thread;
+  };
+
+  HangWatchdog() = default;
+  ~HangWatchdog() = default;
+
+  void StopLocked() {
+    g_hang_threshold_ms.store(0);
+    if (!watchdog.joinable())
+      return;
+
+    SetEvent(stop_event);
+    watchdog.join();
+  }
+
+  void WatchdogThread(uint32_t threshold_ms) {
+    const DWORD interval = std::clamp<DWORD>(threshold_ms / 4, 10, 1000);
+    while (WaitForSingleObject(stop_event, interval) == WAIT_TIMEOUT)
+      CheckThreads(threshold_ms);
+  }
+
+  void CheckThreads(uint32_t threshold_ms) {
+    std::vector<std::shared_ptr<WatchedThread>> snapshot;
+    {
+      base::AutoLock auto_lock(threads_lock);
+      snapshot = threads;
+    }
+
+    const int64_t now = LatencyNow();
+    for (const auto& thread : snapshot) {
+      if (!thread->depth.load())
+        continue;
+
+      const int64_t stalled_ms = (now - thread->last_beat.load()) / 1000000;
+      if (stalled_ms < threshold_ms)
+        continue;
+
+      const uint64_t beat = thread->beats.load();
+      if (beat == thread->reported_beat) {
+        // Still the same stall, keep its length up to date
+        base::AutoLock auto_lock(stats_lock);
+        EventHangStats& stats = events[thread->reported_name];
+        stats.max_stall_ms = std::max<int64_t>(stats.max_stall_ms, stalled_ms);
+        continue;
+      }
+
+      ReportHang(thread.get(), beat, stalled_ms);
+    }
+  }
+
+  void ReportHang(WatchedThread* thread, uint64_t beat, int64_t stalled_ms) {
+    const char* host_call = thread->host_call.load();
+    const char* task = thread->task.load();
+
+    std::string name = "unknown";
+    if (host_call)
+      name = host_call;
+    else if (task)
+      name = ShortFunctionName(task);
+
+    thread->reported_beat = beat;
+    thread->reported_name = name;
+
+    json hang = json::object();
+    hang["event"] = name;
+    hang["task"] = task ? ShortFunctionName(task) : "";
+    hang["browser"] = reinterpret_cast<uintptr_t>(thread->browser.load());
+    hang["thread_id"] = thread->thread_id;
+    hang["stalled_ms"] = stalled_ms;
+
+    HangDetectedCB cb = nullptr;
+    LPVOID cb_param = nullptr;
+    {
+      base::AutoLock auto_lock(stats_lock);
+      EventHangStats& stats = events[name];
+      ++stats.hangs;
+      stats.max_stall_ms = std::max<int64_t>(stats.max_stall_ms, stalled_ms);
+      ++total_hangs;
+      last_hang = hang;
+
+      cb = callback;
+      cb_param = param;
+    }
+
+    if (cb)
+      cb(hang.dump().c_str(), cb_param);
+  }
+
+  // Serializes Start and Stop
+  base::Lock control_lock{"HangWatchdogControl"};
+  std::thread watchdog;
+  // Created by the first Start and kept
+  HANDLE stop_event = nullptr;
+
+  base::Lock threads_lock{"HangWatchdogThreads"};
+  std::vector<std::shared_ptr<WatchedThread>> threads;
+
+  base::Lock stats_lock{"HangWatchdogStats"};
+  HangDetectedCB callback = nullptr;
+  LPVOID param = nullptr;
+  std::map<std::string, EventHangStats> events;
+  uint64_t total_hangs = 0;
+  json last_hang;
+};
+
+void Beat(WatchedThread* thread) {
+  thread->last_beat.store(LatencyNow());
+  thread->beats.fetch_add(1);
+}
+
+}  // namespace
+
+// static
+const char* HangWatchScope::BeginTask(const char* task_name) {
+  WatchedThread* thread = HangWatchdog::GetInstance()->CurrentThread();
+  const char* previous = thread->task.exchange(task_name);
+  Beat(thread);
+  thread->depth.fetch_add(1);
+  return previous;
+}
+
+// static
+void HangWatchScope::EndTask(const char* previous_task) {
+  WatchedThread* thread = HangWatchdog::GetInstance()->CurrentThread();
+  thread->depth.fetch_sub(1);
+  thread->task.store(previous_task);
+  Beat(thread);
+}
+
+HostCallFrame EnterHostCall(const char* name, const void* browser) {
+  WatchedThread* thread = HangWatchdog::GetInstance()->CurrentThread();
+  HostCallFrame previous = {thread->host_call.exchange(name),
+                            thread->browser.exchange(browser)};
+  // Host calls made outside any pump task (WebView2 event handlers) are
+  // watched on their own
+  Beat(thread);
+  thread->depth.fetch_add(1);
+  return previous;
+}
+
+void LeaveHostCall(const HostCallFrame& previous,
+                   const char* name,
+                   int64_t elapsed_ns) {
+  HangWatchdog* watchdog = HangWatchdog::GetInstance();
+  WatchedThread* thread = watchdog->CurrentThread();
+  thread->depth.fetch_sub(1);
+  thread->host_call.store(previous.name);
+  thread->browser.store(previous.browser);
+  Beat(thread);
+
+  const uint32_t threshold_ms = g_hang_threshold_ms.load();
+  const int64_t elapsed_ms = elapsed_ns / 1000000;
+  if (threshold_ms && elapsed_ms >= threshold_ms)
+    watchdog->RecordSlowCall(name, elapsed_ms);
+}
+
+json GetHangStats() {
+  return HangWatchdog::GetInstance()->GetStats();
+}
+
+EV_EXPORTS(SetHangWatchdog, BOOL)(uint32_t threshold_ms,
+                                  HangDetectedCB callback,
+                                  LPVOID param) {
+  if (!threshold_ms) {
+    HangWatchdog::GetInstance()->Stop();
+    return TRUE;
+  }
+
+  HangWatchdog::GetInstance()->Start(threshold_ms, callback, param);
+  return TRUE;
+}
+
+}  // namespace edgeview
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+
+#include "util.h"
+
+namespace edgeview {
+
+// Receives a JSON description of the stall, on the watchdog thread
+using HangDetectedCB = void(CALLBACK*)(LPCSTR json, LPVOID param);
+
+// Stall threshold in milliseconds, 0 while the watchdog is off
+extern std::atomic<uint32_t> g_hang_threshold_ms;
+
+inline bool HangWatchEnabled() {
+  return g_hang_threshold_ms.load(std::memory_order_relaxed) != 0;
+}
+
+// Heartbeat of the thread running a pump task, the watchdog reports tasks
+// which keep the thread busy past the threshold. Nested tasks (sync waits
+// pumping messages) count as progress.
+class HangWatchScope {
+ public:
+  explicit HangWatchScope(const char* task_name)
+      : watched(HangWatchEnabled()) {
+    if (watched)
+      previous_task = BeginTask(task_name);
+  }
+  ~HangWatchScope() {
+    if (watched)
+      EndTask(previous_task);
+  }
+
+  HangWatchScope(const HangWatchScope&) = delete;
+  HangWatchScope& operator=(const HangWatchScope&) = delete;
+
+ private:
+  // Return the task which was running on the thread before
+  static const char* BeginTask(const char* task_name);
+  static void EndTask(const char* previous_task);
+
+  const bool watched;
+  const char* previous_task = nullptr;
+};
+
+// Dispatcher method running on the watched thread, stalls are attributed to
+// it and to |browser| rather than to the pump task. Entering and leaving beat
+// like a task, so calls from WebView2 event handlers are watched too.
+struct HostCallFrame {
+  const char* name = nullptr;
+  const void* browser = nullptr;
+};
+
+// Returns the frame to restore once the call returns
+HostCallFrame EnterHostCall(const char* name, const void* browser);
+// Counts the call as slow if it took longer than the threshold
+void LeaveHostCall(const HostCallFrame& previous,
+                   const char* name,
+                   int64_t elapsed_ns);
+
+// Slow call and stall counts per event, part of edgeview_GetStats
+json GetHangStats();
+
+// |threshold_ms| 0 stops the watchdog
+EV_EXPORTS(SetHangWatchdog, BOOL)(uint32_t threshold_ms,
+                                  HangDetectedCB callback,
+                                  LPVOID param);
+
+}  // namespace edgeview
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "base/bind/callback.h"
+
+namespace edgeview {
+
+// Move only void() task with small buffer storage. Callables up to
+// kInlineSize bytes live inside the object, larger ones fall back to the heap.
+// A base::OnceClosure converts implicitly and is stored inline as well, so
+// existing BindOnce call sites keep working; BindOnceInline below also skips
+// the BindState allocation of base::BindOnce.
+class InlineOnceClosure {
+ public:
+  static constexpr size_t kInlineSize = 64;
+
+  InlineOnceClosure() = default;
+
+  InlineOnceClosure(base::OnceClosure closure) {
+    if (closure.is_null())
+      return;
+
+    Emplace([closure = std::move(closure)]() mutable {
+      std::move(closure).Run();
+    });
+  }
+
+  template <typename Functor,
+            typename = std::enable_if_t<
+                !std::is_same_v<std::decay_t<Functor>, InlineOnceClosure> &&
+                !std::is_same_v<std::decay_t<Functor>, base::OnceClosure>>>
+  explicit InlineOnceClosure(Functor&& functor) {
+    Emplace(std::forward<Functor>(functor));
+  }
+
+  InlineOnceClosure(InlineOnceClosure&& other) noexcept { MoveFrom(other); }
+
+  InlineOnceClosure& operator=(InlineOnceClosure&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+    return *this;
+  }
+
+  InlineOnceClosure(const InlineOnceClosure&) = delete;
+  InlineOnceClosure& operator=(const InlineOnceClosure&) = delete;
+
+  ~InlineOnceClosure() { Reset(); }
+
+  bool is_null() const { return !ops; }
+  explicit operator bool() const { return !!ops; }
+
+  void Run() && {
+    // Reset even if the task is empty, the object is consumed either way
+    InlineOnceClosure task = std::move(*this);
+    if (task.ops)
+      task.ops->run(task.storage);
+  }
+
+  void Reset() {
+    if (ops) {
+      ops->destroy(storage);
+      ops = nullptr;
+    }
+  }
+
+ private:
+  struct Ops {
+    void (*run)(void* storage);
+    // Move constructs into |dst| and destroys |src|
+    void (*relocate)(void* dst, void* src);
+    void (*destroy)(void* storage);
+  };
+
+  template <typename F>
+  static constexpr bool kStoredInline =
+      sizeof(F) <= kInlineSize && alignof(F) <= alignof(std::max_align_t);
+
+  template <typename F>
+  struct InlineOps {
+    static void Run(void* storage) { (*static_cast<F*>(storage))(); }
+    static void Relocate(void* dst, void* src) {
+      new (dst) F(std::move(*static_cast<F*>(src)));
+      static_cast<F*>(src)->~F();
+    }
+    static void Destroy(void* storage) { static_cast<F*>(storage)->~F(); }
+
+    static constexpr Ops kOps = {Run, Relocate, Destroy};
+  };
+
+  template <typename F>
+  struct HeapOps {
+    static F*& Ptr(void* storage) { return *static_cast<F**>(storage); }
+    static void Run(void* storage) { (*Ptr(storage))(); }
+    static void Relocate(void* dst, void* src) {
+      *static_cast<F**>(dst) = Ptr(src);
+      Ptr(src) = nullptr;
+    }
+    static void Destroy(void* storage) { delete Ptr(storage); }
+
+    static constexpr Ops kOps = {Run, Relocate, Destroy};
+  };
+
+  template <typename Functor>
+  void Emplace(Functor&& functor) {
+    using F = std::decay_t<Functor>;
+    if constexpr (kStoredInline<F>) {
+      new (storage) F(std::forward<Functor>(functor));
+      ops = &InlineOps<F>::kOps;
+    } else {
+      *reinterpret_cast<F**>(storage) = new F(std::forward<Functor>(functor));
+      ops = &HeapOps<F>::kOps;
+    }
+  }
+
+  void MoveFrom(InlineOnceClosure& other) {
+    if (other.ops) {
+      other.ops->relocate(storage, other.storage);
+      ops = other.ops;
+      other.ops = nullptr;
+    }
+  }
+
+  alignas(std::max_align_t) unsigned char storage[kInlineSize];
+  const Ops* ops = nullptr;
+};
+
+// Binds |args| by value to |functor| without a heap allocated BindState.
+// Arguments are moved into the call, like base::BindOnce does. Meant for
+// lambdas: there is no WeakPtr receiver cancellation as for bound methods.
+template <typename Functor, typename... Args>
+InlineOnceClosure BindOnceInline(Functor&& functor, Args&&... args) {
+  return InlineOnceClosure(
+      [functor = std::forward<Functor>(functor),
+       bound = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+        std::apply(std::move(functor), std::move(bound));
+      });
+}
+
+}  // namespace edgeview
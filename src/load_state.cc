@@ -0,0 +1,394 @@
+#include "load_state.h"
+
+#include <algorithm>
+
+#include "edgeview_data.h"
+#include "event_notify.h"
+
+namespace edgeview {
+
+namespace {
+
+// What Puppeteer calls networkidle0 and networkidle2
+constexpr NetworkIdleWindow kDefaultWindows[] = {{500, 0}, {500, 2}};
+
+constexpr int64_t kNanosecondsPerMs = 1000000;
+
+// Thread timers carry no context, ui thread only
+std::map<UINT_PTR, base::WeakPtr<LoadStateTracker>>& ActiveTimers() {
+  static auto* timers =
+      new std::map<UINT_PTR, base::WeakPtr<LoadStateTracker>>();
+  return *timers;
+}
+
+std::string StringField(const json& object, const char* key) {
+  auto it = object.find(key);
+  return it != object.end() && it->is_string() ? it->get<std::string>()
+                                               : std::string();
+}
+
+}  // namespace
+
+LoadStateTracker::LoadStateTracker(base::WeakPtr<BrowserData> browser)
+    : browser(browser) {
+  Configure({}, nullptr, nullptr, nullptr);
+}
+
+LoadStateTracker::~LoadStateTracker() {
+  // Thread timers only die on their own thread, off it OnTimer finds the
+  // tracker gone and cleans up
+  if (timer_id && KillTimer(nullptr, timer_id))
+    ActiveTimers().erase(timer_id);
+
+  // Blocked exports must not wait for a state nobody tracks anymore
+  std::vector<Waiter> pending = std::move(waiters);
+  for (auto& waiter : pending)
+    std::move(waiter.callback).Run(false);
+}
+
+void LoadStateTracker::Start() {
+  if (started || !browser)
+    return;
+  started = true;
+
+  CDPBackend* cdp = browser->cdp_backend.get();
+  cdp->CallMethod("Network.enable", "{}");
+  cdp->CallMethod("Page.enable", "{}");
+  cdp->CallMethod("Page.setLifecycleEventsEnabled", R"({"enabled":true})");
+  cdp->CallMethod(
+      "Page.getFrameTree", "{}", std::string(),
+      base::BindOnce(
+          [](base::WeakPtr<LoadStateTracker> self, int result,
+             const std::string& reply) {
+            json reply_obj = json::parse(reply, nullptr, false);
+            if (!self || FAILED(result) || !reply_obj.is_object())
+              return;
+
+            const json& frame = reply_obj["frameTree"]["frame"];
+            if (frame.is_object() && self->main_frame_id.empty())
+              self->main_frame_id = StringField(frame, "id");
+          },
+          weak_ptr_.GetWeakPtr()));
+
+  using Handler = void (LoadStateTracker::*)(const std::string&);
+  const std::pair<const char*, Handler> handlers[] = {
+      {"Network.requestWillBeSent", &LoadStateTracker::OnRequestWillBeSent},
+      {"Network.loadingFinished", &LoadStateTracker::OnRequestDone},
+      {"Network.loadingFailed", &LoadStateTracker::OnRequestDone},
+      {"Page.lifecycleEvent", &LoadStateTracker::OnLifecycleEvent},
+      {"Page.frameNavigated", &LoadStateTracker::OnFrameNavigated},
+      {"Page.frameDetached", &LoadStateTracker::OnFrameDetached},
+  };
+  for (const auto& it : handlers) {
+    cdp->AddEventListener(
+        it.first, base::BindRepeating(
+                      [](base::WeakPtr<LoadStateTracker> self,
+                         Handler handler, const std::string& params,
+                         const std::string& session) {
+                        // Child target sessions have their own frames
+                        if (self && session.empty())
+                          (self.get()->*handler)(params);
+                      },
+                      weak_ptr_.GetWeakPtr(), it.second));
+  }
+}
+
+void LoadStateTracker::Configure(std::vector<NetworkIdleWindow> windows,
+                                 NetworkIdleCB idle_callback,
+                                 LifecycleCB lifecycle_callback,
+                                 LPVOID param) {
+  if (windows.empty())
+    windows.assign(std::begin(kDefaultWindows), std::end(kDefaultWindows));
+
+  this->windows.clear();
+  for (const auto& window : windows) {
+    IdleWindow item;
+    item.window = window;
+    item.fired =
+        reached.count("networkidle" + std::to_string(window.max_inflight));
+    this->windows.push_back(item);
+  }
+
+  this->idle_callback = idle_callback;
+  this->lifecycle_callback = lifecycle_callback;
+  this->param = param;
+
+  UpdateIdleWindows();
+}
+
+void LoadStateTracker::OnNavigationStarting(uint64_t nav_id) {
+  // Redirects start again under the same id
+  if (nav_id == this->nav_id)
+    return;
+
+  this->nav_id = nav_id;
+  ++document;
+  ResetDocumentState();
+}
+
+void LoadStateTracker::WaitForState(
+    const std::string& state,
+    bool next_document,
+    uint32_t timeout_ms,
+    base::OnceCallback<void(bool reached)> callback) {
+  const uint64_t wanted_document = document + (next_document ? 1 : 0);
+  if (!next_document && reached.count(state))
+    return std::move(callback).Run(true);
+
+  Waiter waiter;
+  waiter.state = state;
+  waiter.document = wanted_document;
+  waiter.deadline =
+      timeout_ms ? LatencyNow() + timeout_ms * kNanosecondsPerMs : 0;
+  waiter.callback = std::move(callback);
+  waiters.push_back(std::move(waiter));
+
+  ScheduleTimer();
+}
+
+json LoadStateTracker::GetInflightRequests() const {
+  json frames = json::object();
+  for (const auto& it : frame_inflight)
+    frames[it.first] = it.second;
+
+  return {{"total", inflight.size()}, {"frames", std::move(frames)}};
+}
+
+void LoadStateTracker::OnRequestWillBeSent(const std::string& params) {
+  json params_obj = json::parse(params, nullptr, false);
+  if (!params_obj.is_object())
+    return;
+
+  std::string request_id = StringField(params_obj, "requestId");
+  if (request_id.empty() || inflight.count(request_id))
+    return;
+
+  Request& request = inflight[request_id];
+  request.frame_id = StringField(params_obj, "frameId");
+  request.loader_id = StringField(params_obj, "loaderId");
+  ++frame_inflight[request.frame_id];
+
+  UpdateIdleWindows();
+}
+
+void LoadStateTracker::OnRequestDone(const std::string& params) {
+  json params_obj = json::parse(params, nullptr, false);
+  if (!params_obj.is_object())
+    return;
+
+  auto it = inflight.find(StringField(params_obj, "requestId"));
+  if (it == inflight.end())
+    return;
+
+  auto frame = frame_inflight.find(it->second.frame_id);
+  if (frame != frame_inflight.end() && !--frame->second)
+    frame_inflight.erase(frame);
+  inflight.erase(it);
+
+  UpdateIdleWindows();
+}
+
+void LoadStateTracker::OnLifecycleEvent(const std::string& params) {
+  json params_obj = json::parse(params, nullptr, false);
+  if (!params_obj.is_object())
+    return;
+
+  std::string name = StringField(params_obj, "name");
+  std::string frame_id = StringField(params_obj, "frameId");
+  const bool main_frame = !frame_id.empty() && frame_id == main_frame_id;
+
+  if (main_frame) {
+    // A committed document starts over, whatever the navigation events said
+    if (name == "init")
+      ResetDocumentState();
+    else
+      ReachState(name);
+  }
+
+  if (lifecycle_callback && browser)
+    browser->dispatcher->OnLifecycle(lifecycle_callback, name.c_str(),
+                                     frame_id.c_str(), main_frame, param);
+}
+
+void LoadStateTracker::OnFrameNavigated(const std::string& params) {
+  json params_obj = json::parse(params, nullptr, false);
+  if (!params_obj.is_object() || !params_obj["frame"].is_object())
+    return;
+
+  const json& frame = params_obj["frame"];
+  std::string frame_id = StringField(frame, "id");
+  if (!frame.contains("parentId"))
+    main_frame_id = frame_id;
+
+  // Requests of the replaced document never report back reliably
+  RemoveRequests(frame_id, StringField(frame, "loaderId"));
+  UpdateIdleWindows();
+}
+
+void LoadStateTracker::OnFrameDetached(const std::string& params) {
+  json params_obj = json::parse(params, nullptr, false);
+  if (!params_obj.is_object())
+    return;
+
+  RemoveRequests(StringField(params_obj, "frameId"), std::string());
+  UpdateIdleWindows();
+}
+
+void LoadStateTracker::RemoveRequests(const std::string& frame_id,
+                                      const std::string& keep_loader_id) {
+  for (auto it = inflight.begin(); it != inflight.end();) {
+    if (it->second.frame_id != frame_id ||
+        (!keep_loader_id.empty() && it->second.loader_id == keep_loader_id)) {
+      ++it;
+      continue;
+    }
+
+    auto frame = frame_inflight.find(frame_id);
+    if (frame != frame_inflight.end() && !--frame->second)
+      frame_inflight.erase(frame);
+    it = inflight.erase(it);
+  }
+}
+
+void LoadStateTracker::ResetDocumentState() {
+  reached.clear();
+  for (auto& window : windows) {
+    window.quiet_since = 0;
+    window.fired = false;
+  }
+
+  UpdateIdleWindows();
+}
+
+void LoadStateTracker::UpdateIdleWindows() {
+  const int64_t now = LatencyNow();
+  for (auto& window : windows) {
+    if (inflight.size() > window.window.max_inflight)
+      window.quiet_since = 0;
+    else if (!window.quiet_since)
+      window.quiet_since = now;
+  }
+
+  CheckDeadlines();
+}
+
+void LoadStateTracker::ReachState(const std::string& state) {
+  reached.insert(state);
+
+  // Host callbacks may wait again, finish the list first
+  std::vector<base::OnceCallback<void(bool)>> done;
+  std::erase_if(waiters, [&](Waiter& waiter) {
+    if (waiter.state != state || waiter.document > document)
+      return false;
+
+    done.push_back(std::move(waiter.callback));
+    return true;
+  });
+
+  for (auto& callback : done)
+    std::move(callback).Run(true);
+}
+
+void LoadStateTracker::CheckDeadlines() {
+  const int64_t now = LatencyNow();
+
+  for (size_t i = 0; i < windows.size(); ++i) {
+    IdleWindow& window = windows[i];
+    if (window.fired || !window.quiet_since ||
+        now - window.quiet_since <
+            window.window.idle_ms * kNanosecondsPerMs)
+      continue;
+
+    window.fired = true;
+    const NetworkIdleWindow fired = window.window;
+    ReachState("networkidle" + std::to_string(fired.max_inflight));
+    if (idle_callback && browser)
+      browser->dispatcher->OnNetworkIdle(idle_callback, fired.idle_ms,
+                                         fired.max_inflight, param);
+  }
+
+  std::vector<base::OnceCallback<void(bool)>> expired;
+  std::erase_if(waiters, [&](Waiter& waiter) {
+    if (!waiter.deadline || waiter.deadline > now)
+      return false;
+
+    expired.push_back(std::move(waiter.callback));
+    return true;
+  });
+
+  for (auto& callback : expired)
+    std::move(callback).Run(false);
+
+  ScheduleTimer();
+}
+
+void LoadStateTracker::ScheduleTimer() {
+  int64_t next = 0;
+  auto earliest = [&next](int64_t deadline) {
+    if (!next || deadline < next)
+      next = deadline;
+  };
+
+  for (const auto& window : windows) {
+    if (!window.fired && window.quiet_since)
+      earliest(window.quiet_since + window.window.idle_ms * kNanosecondsPerMs);
+  }
+  for (const auto& waiter : waiters) {
+    if (waiter.deadline)
+      earliest(waiter.deadline);
+  }
+
+  if (!next) {
+    if (timer_id) {
+      KillTimer(nullptr, timer_id);
+      ActiveTimers().erase(timer_id);
+      timer_id = 0;
+    }
+    return;
+  }
+
+  // Rounded up, firing early would only rearm
+  const int64_t delay =
+      (std::max<int64_t>(next - LatencyNow(), 0) + kNanosecondsPerMs - 1) /
+      kNanosecondsPerMs;
+  UINT_PTR new_id = SetTimer(nullptr, timer_id,
+                             static_cast<UINT>(std::max<int64_t>(delay, 1)),
+                             &LoadStateTracker::OnTimer);
+  if (new_id && new_id != timer_id) {
+    ActiveTimers().erase(timer_id);
+    timer_id = new_id;
+  }
+  ActiveTimers()[timer_id] = weak_ptr_.GetWeakPtr();
+}
+
+// static
+void CALLBACK LoadStateTracker::OnTimer(HWND window,
+                                        UINT message,
+                                        UINT_PTR timer_id,
+                                        DWORD time) {
+  auto it = ActiveTimers().find(timer_id);
+  base::WeakPtr<LoadStateTracker> self =
+      it != ActiveTimers().end() ? it->second : nullptr;
+  if (!self) {
+    KillTimer(nullptr, timer_id);
+    if (it != ActiveTimers().end())
+      ActiveTimers().erase(it);
+    return;
+  }
+
+  // Keep the tracker alive through host callbacks
+  scoped_refptr<LoadStateTracker> tracker(self.get());
+  tracker->CheckDeadlines();
+}
+
+LoadStateTracker* EnsureLoadStateTracker(BrowserData* browser) {
+  if (!browser->load_state) {
+    browser->load_state = base::MakeRefCounted<LoadStateTracker>(
+        browser->weak_ptr_.GetWeakPtr());
+    browser->load_state->Start();
+  }
+
+  return browser->load_state.get();
+}
+
+}  // namespace edgeview
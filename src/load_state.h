@@ -0,0 +1,141 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "base/bind/callback.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "util.h"
+
+namespace edgeview {
+
+struct BrowserData;
+
+// The page counts as idle once at most |max_inflight| requests were pending
+// for |idle_ms|
+using NetworkIdleWindow = struct {
+  uint32_t idle_ms;
+  uint32_t max_inflight;
+};
+
+using NetworkIdleCB = void(CALLBACK*)(uint32_t idle_ms,
+                                      uint32_t max_inflight,
+                                      LPVOID param);
+// Page.lifecycleEvent names: init, DOMContentLoaded, load, firstPaint ...
+using LifecycleCB = void(CALLBACK*)(LPCSTR name,
+                                    LPCSTR frame_id,
+                                    BOOL main_frame,
+                                    LPVOID param);
+
+// Tracks the in-flight requests of every frame from the Network events and
+// the main frame lifecycle from Page.lifecycleEvent. Each idle window fires
+// once per document and is reached as the "networkidle<max_inflight>" state,
+// next to the lifecycle names of the main frame. Deadlines run on a ui
+// thread timer. Ui thread only.
+class LoadStateTracker : public base::RefCountedThreadSafe<LoadStateTracker> {
+ public:
+  explicit LoadStateTracker(base::WeakPtr<BrowserData> browser);
+
+  LoadStateTracker(const LoadStateTracker&) = delete;
+  LoadStateTracker& operator=(const LoadStateTracker&) = delete;
+
+  // Enables the events and subscribes to them, once
+  void Start();
+
+  // Empty |windows| restores the default 500 ms windows for 0 and 2
+  // requests. Windows already reached stay reached.
+  void Configure(std::vector<NetworkIdleWindow> windows,
+                 NetworkIdleCB idle_callback,
+                 LifecycleCB lifecycle_callback,
+                 LPVOID param);
+
+  // A new main frame document begins
+  void OnNavigationStarting(uint64_t nav_id);
+
+  // Runs |callback| with true once |state| is reached, on the current
+  // document or, with |next_document|, on the one after the next
+  // NavigationStarting. False after |timeout_ms|, 0 waits without limit.
+  void WaitForState(const std::string& state,
+                    bool next_document,
+                    uint32_t timeout_ms,
+                    base::OnceCallback<void(bool reached)> callback);
+
+  // {"total": n, "frames": {frame id: n}}
+  json GetInflightRequests() const;
+
+ private:
+  friend class base::RefCountedThreadSafe<LoadStateTracker>;
+  // Runs the pending waiters with false
+  ~LoadStateTracker();
+
+  struct IdleWindow {
+    NetworkIdleWindow window;
+    // Since when the window condition holds, 0 while busy
+    int64_t quiet_since = 0;
+    bool fired = false;
+  };
+
+  struct Request {
+    std::string frame_id;
+    std::string loader_id;
+  };
+
+  struct Waiter {
+    std::string state;
+    uint64_t document = 0;
+    // 0 without timeout
+    int64_t deadline = 0;
+    base::OnceCallback<void(bool)> callback;
+  };
+
+  void OnRequestWillBeSent(const std::string& params);
+  void OnRequestDone(const std::string& params);
+  void OnLifecycleEvent(const std::string& params);
+  void OnFrameNavigated(const std::string& params);
+  void OnFrameDetached(const std::string& params);
+
+  void RemoveRequests(const std::string& frame_id,
+                      const std::string& keep_loader_id);
+  void ResetDocumentState();
+  void UpdateIdleWindows();
+  void ReachState(const std::string& state);
+  // Fires the due windows, expires the due waiters and rearms the timer
+  void CheckDeadlines();
+  void ScheduleTimer();
+
+  static void CALLBACK OnTimer(HWND window,
+                               UINT message,
+                               UINT_PTR timer_id,
+                               DWORD time);
+
+  base::WeakPtr<BrowserData> browser;
+  bool started = false;
+
+  NetworkIdleCB idle_callback = nullptr;
+  LifecycleCB lifecycle_callback = nullptr;
+  LPVOID param = nullptr;
+
+  std::vector<IdleWindow> windows;
+  // By requestId, redirects keep theirs
+  std::map<std::string, Request> inflight;
+  std::map<std::string, uint32_t> frame_inflight;
+
+  std::string main_frame_id;
+  uint64_t document = 0;
+  uint64_t nav_id = 0;
+  std::set<std::string> reached;
+  std::vector<Waiter> waiters;
+
+  UINT_PTR timer_id = 0;
+
+  base::WeakPtrFactory<LoadStateTracker> weak_ptr_{this};
+};
+
+// Load state tracker of |browser|, created and started on first use. Ui
+// thread only.
+LoadStateTracker* EnsureLoadStateTracker(BrowserData* browser);
+
+}  // namespace edgeview
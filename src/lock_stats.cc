@@ -0,0 +1,53 @@
+#include "lock_stats.h"
+
+#include <map>
+
+#include "base/memory/lock.h"
+
+namespace edgeview {
+
+EV_EXPORTS(SetLockContentionTracking, void)(BOOL enable) {
+  base::SetLockContentionTracking(!!enable);
+}
+
+EV_EXPORTS(GetLockStats, LPCSTR)() {
+  struct Totals {
+    uint64_t instances = 0;
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0;
+    uint64_t wait_ns = 0;
+  };
+
+  // Per type locks (pools, shards) share a name, report them summed up
+  std::map<std::pair<std::string, std::string>, Totals> totals;
+  for (const auto& it : base::GetLockContentionStats()) {
+    Totals& total = totals[{it.name, it.mode}];
+    ++total.instances;
+    total.acquisitions += it.acquisitions;
+    total.contended += it.contended;
+    total.wait_ns += it.wait_ns;
+  }
+
+  json stats = json::object();
+  for (const auto& it : totals) {
+    const Totals& total = it.second;
+
+    json item = json::object();
+    item["instances"] = total.instances;
+    item["acquisitions"] = total.acquisitions;
+    item["contended"] = total.contended;
+    item["contention_rate"] =
+        total.acquisitions
+            ? static_cast<double>(total.contended) / total.acquisitions
+            : 0.0;
+    item["wait_us"] = total.wait_ns / 1000;
+    item["avg_wait_us"] =
+        total.contended ? total.wait_ns / 1000.0 / total.contended : 0.0;
+
+    stats[it.first.first][it.first.second] = std::move(item);
+  }
+
+  return WrapComString(stats.dump().c_str());
+}
+
+}  // namespace edgeview
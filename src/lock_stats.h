@@ -0,0 +1,11 @@
+#pragma once
+
+#include "util.h"
+
+namespace edgeview {
+
+// Contention counters of the named base::Lock / base::RWLock instances
+EV_EXPORTS(SetLockContentionTracking, void)(BOOL enable);
+EV_EXPORTS(GetLockStats, LPCSTR)();
+
+}  // namespace edgeview
@@ -0,0 +1,262 @@
+#include "mem_accounting.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <unordered_map>
+
+#include "base/memory/lock.h"
+
+namespace edgeview {
+
+namespace {
+
+constexpr size_t kCategoryCount = static_cast<size_t>(AllocCategory::kCount);
+constexpr size_t kShardCount = 16;
+
+const char* const kCategoryNames[kCategoryCount] = {
+    "raw",
+    "string",
+    "buffer",
+    "array",
+};
+
+std::atomic_bool accounting_enabled{false};
+// Records still in the tables, frees keep looking them up while non zero
+std::atomic<int64_t> tracked_blocks{0};
+
+// Written by the owning thread only, summed up by GetMemoryStats
+struct Counters {
+  std::atomic<int64_t> allocations[kCategoryCount]{};
+  std::atomic<int64_t> allocated_bytes[kCategoryCount]{};
+  std::atomic<int64_t> frees[kCategoryCount]{};
+  std::atomic<int64_t> freed_bytes[kCategoryCount]{};
+
+  void Add(const Counters& other) {
+    for (size_t i = 0; i < kCategoryCount; ++i) {
+      allocations[i] += other.allocations[i].load(std::memory_order_relaxed);
+      allocated_bytes[i] +=
+          other.allocated_bytes[i].load(std::memory_order_relaxed);
+      frees[i] += other.frees[i].load(std::memory_order_relaxed);
+      freed_bytes[i] += other.freed_bytes[i].load(std::memory_order_relaxed);
+    }
+  }
+};
+
+// Leaked, thread exit and late frees from the host may still touch these
+// after static destructors have run.
+base::Lock& CountersLock() {
+  static base::Lock* lock = new base::Lock("MemoryCounters");
+  return *lock;
+}
+
+std::vector<Counters*>& LiveCounters() {
+  static std::vector<Counters*>* counters = new std::vector<Counters*>();
+  return *counters;
+}
+
+// Totals of threads which already exited
+Counters& RetiredCounters() {
+  static Counters* counters = new Counters();
+  return *counters;
+}
+
+class ThreadCounters {
+ public:
+  ThreadCounters() {
+    base::AutoLock auto_lock(CountersLock());
+    LiveCounters().push_back(&counters);
+  }
+
+  ~ThreadCounters() {
+    base::AutoLock auto_lock(CountersLock());
+    RetiredCounters().Add(counters);
+    auto& live = LiveCounters();
+    live.erase(std::remove(live.begin(), live.end(), &counters), live.end());
+  }
+
+  Counters counters;
+};
+
+Counters& CurrentCounters() {
+  static thread_local ThreadCounters thread_counters;
+  return thread_counters.counters;
+}
+
+inline void Bump(std::atomic<int64_t>& counter, int64_t value) {
+  // Owner thread only, a plain load/store pair is enough
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+struct BlockRecord {
+  size_t size;
+  AllocCategory category;
+  const void* site;
+};
+
+struct Shard {
+  base::Lock lock{"MemoryShard"};
+  std::unordered_map<const void*, BlockRecord> blocks;
+};
+
+Shard& ShardAt(size_t index) {
+  static Shard* shards = new Shard[kShardCount];
+  return shards[index];
+}
+
+Shard& ShardFor(const void* ptr) {
+  // Heap blocks are 16 byte aligned, skip the always zero bits
+  return ShardAt((reinterpret_cast<uintptr_t>(ptr) >> 4) % kShardCount);
+}
+
+std::string FormatSite(const void* site) {
+  HMODULE module = nullptr;
+  if (!site || !GetModuleHandleExW(
+                   GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                       GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                   static_cast<LPCWSTR>(site), &module)) {
+    char raw[32];
+    snprintf(raw, sizeof(raw), "0x%p", site);
+    return raw;
+  }
+
+  char path[MAX_PATH] = {0};
+  GetModuleFileNameA(module, path, MAX_PATH);
+  LPCSTR file_name = PathFindFileNameA(path);
+
+  char site_str[MAX_PATH + 32];
+  snprintf(site_str, sizeof(site_str), "%s+0x%Ix", file_name,
+           reinterpret_cast<uintptr_t>(site) -
+               reinterpret_cast<uintptr_t>(module));
+  return site_str;
+}
+
+}  // namespace
+
+LPVOID AccountedAlloc(size_t size, AllocCategory category, const void* site) {
+  LPVOID mem = ::HeapAlloc(::GetProcessHeap(), HEAP_ZERO_MEMORY, size);
+  if (!mem || !accounting_enabled.load(std::memory_order_relaxed))
+    return mem;
+
+  const size_t index = static_cast<size_t>(category);
+  Counters& counters = CurrentCounters();
+  Bump(counters.allocations[index], 1);
+  Bump(counters.allocated_bytes[index], size);
+
+  Shard& shard = ShardFor(mem);
+  {
+    base::AutoLock auto_lock(shard.lock);
+    shard.blocks[mem] = {size, category, site};
+  }
+  tracked_blocks.fetch_add(1, std::memory_order_relaxed);
+
+  return mem;
+}
+
+BOOL AccountedFree(LPVOID mem) {
+  if (mem && tracked_blocks.load(std::memory_order_relaxed) > 0) {
+    Shard& shard = ShardFor(mem);
+    BlockRecord record;
+    bool found = false;
+    {
+      base::AutoLock auto_lock(shard.lock);
+      auto it = shard.blocks.find(mem);
+      if (it != shard.blocks.end()) {
+        record = it->second;
+        shard.blocks.erase(it);
+        found = true;
+      }
+    }
+
+    if (found) {
+      tracked_blocks.fetch_sub(1, std::memory_order_relaxed);
+
+      const size_t index = static_cast<size_t>(record.category);
+      Counters& counters = CurrentCounters();
+      Bump(counters.frees[index], 1);
+      Bump(counters.freed_bytes[index], record.size);
+    }
+  }
+
+  return ::HeapFree(::GetProcessHeap(), 0, mem);
+}
+
+EV_EXPORTS(SetMemoryAccounting, void)(BOOL enable) {
+  accounting_enabled.store(!!enable);
+}
+
+EV_EXPORTS(GetMemoryStats, LPCSTR)() {
+  Counters total;
+  {
+    base::AutoLock auto_lock(CountersLock());
+    total.Add(RetiredCounters());
+    for (Counters* counters : LiveCounters())
+      total.Add(*counters);
+  }
+
+  json stats = json::object();
+  stats["enabled"] = accounting_enabled.load();
+
+  int64_t live_bytes = 0, live_count = 0;
+  json categories = json::object();
+  for (size_t i = 0; i < kCategoryCount; ++i) {
+    json item = json::object();
+    item["allocations"] = total.allocations[i].load();
+    item["allocated_bytes"] = total.allocated_bytes[i].load();
+    item["live_count"] = total.allocations[i].load() - total.frees[i].load();
+    item["live_bytes"] =
+        total.allocated_bytes[i].load() - total.freed_bytes[i].load();
+
+    live_count += item["live_count"].get<int64_t>();
+    live_bytes += item["live_bytes"].get<int64_t>();
+    categories[kCategoryNames[i]] = std::move(item);
+  }
+  stats["categories"] = std::move(categories);
+  stats["live_count"] = live_count;
+  stats["live_bytes"] = live_bytes;
+
+  return WrapComString(stats.dump().c_str());
+}
+
+EV_EXPORTS(DumpAllocationSites, LPCSTR)(int top_count) {
+  struct SiteStats {
+    AllocCategory category;
+    int64_t count = 0;
+    int64_t bytes = 0;
+  };
+
+  std::map<const void*, SiteStats> sites;
+  for (size_t i = 0; i < kShardCount; ++i) {
+    Shard& shard = ShardAt(i);
+    base::AutoLock auto_lock(shard.lock);
+    for (const auto& it : shard.blocks) {
+      SiteStats& site = sites[it.second.site];
+      site.category = it.second.category;
+      ++site.count;
+      site.bytes += it.second.size;
+    }
+  }
+
+  std::vector<std::pair<const void*, SiteStats>> sorted(sites.begin(),
+                                                        sites.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+    return a.second.bytes > b.second.bytes;
+  });
+  if (top_count > 0 && sorted.size() > static_cast<size_t>(top_count))
+    sorted.resize(top_count);
+
+  json dump = json::array();
+  for (const auto& it : sorted) {
+    json item = json::object();
+    item["site"] = FormatSite(it.first);
+    item["category"] = kCategoryNames[static_cast<size_t>(it.second.category)];
+    item["live_count"] = it.second.count;
+    item["live_bytes"] = it.second.bytes;
+    dump.push_back(std::move(item));
+  }
+
+  return WrapComString(dump.dump().c_str());
+}
+
+}  // namespace edgeview
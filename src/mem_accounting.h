@@ -0,0 +1,28 @@
+#pragma once
+
+#include <intrin.h>
+
+#include "util.h"
+
+namespace edgeview {
+
+// What a block handed to the host holds
+enum class AllocCategory : uint8_t {
+  kRaw = 0,  // edgeview_MemAlloc called directly
+  kString,   // WrapComString results
+  kBuffer,   // byte streams, images, pdf data
+  kArray,    // E arrays and packed results
+  kCount,
+};
+
+// Process heap allocation. With accounting enabled the block is recorded with
+// its category and call site until it comes back through AccountedFree.
+// Blocks released by the E runtime itself never come back and stay listed.
+LPVOID AccountedAlloc(size_t size, AllocCategory category, const void* site);
+BOOL AccountedFree(LPVOID mem);
+
+EV_EXPORTS(SetMemoryAccounting, void)(BOOL enable);
+EV_EXPORTS(GetMemoryStats, LPCSTR)();
+EV_EXPORTS(DumpAllocationSites, LPCSTR)(int top_count);
+
+}  // namespace edgeview
@@ -0,0 +1,173 @@
+#include "memory_sampler.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "edgeview_data.h"
+#include "event_notify.h"
+#include "ev_msgpump.h"
+#include "process_metrics.h"
+
+namespace edgeview {
+
+namespace {
+
+constexpr uint64_t kMegabyte = 1024 * 1024;
+
+}  // namespace
+
+MemorySampler::MemorySampler(base::WeakPtr<BrowserData> browser,
+                             scoped_refptr<MessagePump> pump,
+                             const MemorySamplerParams& params,
+                             MemoryThresholdCB callback,
+                             LPVOID param)
+    : browser(browser),
+      msg_pump(pump),
+      params(params),
+      callback(callback),
+      param(param),
+      ring_size(std::max<uint32_t>(params.history, 1)) {
+  ring.reserve(ring_size);
+}
+
+MemorySampler::~MemorySampler() {
+  Stop();
+  if (stop_event)
+    CloseHandle(stop_event);
+}
+
+void MemorySampler::Start() {
+  stop_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  timer = std::thread(&MemorySampler::TimerLoop, this,
+                      weak_ptr_.GetWeakPtr());
+}
+
+void MemorySampler::Stop() {
+  stopped.store(true);
+
+  if (timer.joinable()) {
+    SetEvent(stop_event);
+    timer.join();
+  }
+}
+
+void MemorySampler::TimerLoop(base::WeakPtr<MemorySampler> weak_this) {
+  const DWORD interval = std::max<uint32_t>(params.interval_ms, 1);
+  while (WaitForSingleObject(stop_event, interval) == WAIT_TIMEOUT)
+    msg_pump->PostTask(base::BindOnce(&MemorySampler::Sample, weak_this));
+}
+
+void MemorySampler::Sample() {
+  // A slow renderer skips ticks instead of queueing samples up
+  if (stopped.load() || sampling || !browser)
+    return;
+  sampling = true;
+
+  MemorySampleData sample{0};
+  sample.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+
+  browser->cdp_backend->CallMethod(
+      "Memory.getDOMCounters", "{}", std::string(),
+      base::BindOnce(&MemorySampler::OnDOMCounters, scoped_refptr(this),
+                     sample));
+}
+
+void MemorySampler::OnDOMCounters(MemorySampleData sample,
+                                  int result,
+                                  const std::string& reply) {
+  if (stopped.load() || !browser) {
+    sampling = false;
+    return;
+  }
+
+  json reply_obj = json::parse(reply, nullptr, false);
+  if (SUCCEEDED(result) && reply_obj.is_object()) {
+    sample.documents = reply_obj.value("documents", 0u);
+    sample.nodes = reply_obj.value("nodes", 0u);
+    sample.js_event_listeners = reply_obj.value("jsEventListeners", 0u);
+  }
+
+  browser->cdp_backend->CallMethod(
+      "Runtime.getHeapUsage", "{}", std::string(),
+      base::BindOnce(&MemorySampler::OnHeapUsage, scoped_refptr(this),
+                     sample));
+}
+
+void MemorySampler::OnHeapUsage(MemorySampleData sample,
+                                int result,
+                                const std::string& reply) {
+  if (stopped.load() || !browser) {
+    sampling = false;
+    return;
+  }
+
+  json reply_obj = json::parse(reply, nullptr, false);
+  if (SUCCEEDED(result) && reply_obj.is_object()) {
+    // Sizes come as doubles
+    sample.js_heap_used =
+        static_cast<uint64_t>(reply_obj.value("usedSize", 0.0));
+    sample.js_heap_total =
+        static_cast<uint64_t>(reply_obj.value("totalSize", 0.0));
+  }
+
+  FindRendererProcess(
+      scoped_refptr(browser.get()),
+      base::BindOnce(&MemorySampler::OnRendererFound, scoped_refptr(this),
+                     sample));
+}
+
+void MemorySampler::OnRendererFound(MemorySampleData sample, int pid) {
+  sampling = false;
+  if (stopped.load())
+    return;
+
+  ProcessCounters counters;
+  sample.renderer_pid = pid;
+  if (pid && QueryProcessCounters(pid, &counters))
+    sample.private_bytes = counters.private_bytes;
+
+  if (ring.size() < ring_size) {
+    ring.push_back(sample);
+  } else {
+    ring[ring_head] = sample;
+    ring_head = (ring_head + 1) % ring.size();
+  }
+
+  const uint32_t previous = exceeded;
+  exceeded = ExceededThresholds(sample);
+  if (callback && browser && (exceeded & ~previous))
+    browser->dispatcher->OnMemoryThreshold(callback, exceeded, &sample, param);
+}
+
+uint32_t MemorySampler::ExceededThresholds(
+    const MemorySampleData& sample) const {
+  auto above = [](uint64_t value, uint64_t limit) {
+    return limit && value > limit;
+  };
+
+  uint32_t mask = 0;
+  if (above(sample.documents, params.max_documents))
+    mask |= kMemoryDocuments;
+  if (above(sample.nodes, params.max_nodes))
+    mask |= kMemoryNodes;
+  if (above(sample.js_event_listeners, params.max_js_event_listeners))
+    mask |= kMemoryJSEventListeners;
+  if (above(sample.js_heap_used, params.max_js_heap_mb * kMegabyte))
+    mask |= kMemoryJSHeap;
+  if (above(sample.private_bytes, params.max_private_mb * kMegabyte))
+    mask |= kMemoryPrivateBytes;
+
+  return mask;
+}
+
+std::vector<MemorySampleData> MemorySampler::GetSamples() const {
+  std::vector<MemorySampleData> samples;
+  samples.reserve(ring.size());
+  samples.insert(samples.end(), ring.begin() + ring_head, ring.end());
+  samples.insert(samples.end(), ring.begin(), ring.begin() + ring_head);
+  return samples;
+}
+
+}  // namespace edgeview
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "util.h"
+
+namespace edgeview {
+
+struct BrowserData;
+class MessagePump;
+
+using MemorySamplerParams = struct {
+  uint32_t interval_ms;
+  // Samples kept per browser
+  uint32_t history;
+  // Alert thresholds, 0 disables one
+  uint32_t max_documents;
+  uint32_t max_nodes;
+  uint32_t max_js_event_listeners;
+  uint32_t max_js_heap_mb;
+  uint32_t max_private_mb;
+};
+
+using MemorySampleData = struct {
+  // Unix time in milliseconds
+  int64_t time;
+  uint64_t js_heap_used;
+  uint64_t js_heap_total;
+  // Private bytes of the renderer process, 0 when it was not found
+  uint64_t private_bytes;
+  uint32_t documents;
+  uint32_t nodes;
+  uint32_t js_event_listeners;
+  int renderer_pid;
+};
+
+// Bits of the exceeded mask
+enum MemoryThreshold : uint32_t {
+  kMemoryDocuments = 1 << 0,
+  kMemoryNodes = 1 << 1,
+  kMemoryJSEventListeners = 1 << 2,
+  kMemoryJSHeap = 1 << 3,
+  kMemoryPrivateBytes = 1 << 4,
+};
+
+// |exceeded| holds every threshold above its limit in |sample|, it fires
+// when one more threshold is crossed and rearms once a value falls back
+using MemoryThresholdCB = void(CALLBACK*)(uint32_t exceeded,
+                                          MemorySampleData* sample,
+                                          LPVOID param);
+
+// Samples Memory.getDOMCounters, Runtime.getHeapUsage and the private bytes
+// of the renderer of one browser every |interval_ms|. A timer thread only
+// posts the ticks, through a WeakPtr so it never holds the last reference,
+// sampling runs on the ui thread with at most one sample in flight. Samples
+// wait in a fixed size ring.
+class MemorySampler : public base::RefCountedThreadSafe<MemorySampler> {
+ public:
+  MemorySampler(base::WeakPtr<BrowserData> browser,
+                scoped_refptr<MessagePump> pump,
+                const MemorySamplerParams& params,
+                MemoryThresholdCB callback,
+                LPVOID param);
+
+  MemorySampler(const MemorySampler&) = delete;
+  MemorySampler& operator=(const MemorySampler&) = delete;
+
+  // Start on the ui thread only. Stop from any thread, joins the timer
+  // thread.
+  void Start();
+  void Stop();
+
+  // Samples oldest first, ui thread only
+  std::vector<MemorySampleData> GetSamples() const;
+
+ private:
+  friend class base::RefCountedThreadSafe<MemorySampler>;
+  ~MemorySampler();
+
+  void TimerLoop(base::WeakPtr<MemorySampler> weak_this);
+  // One step per reply: DOM counters, heap usage, renderer process
+  void Sample();
+  void OnDOMCounters(MemorySampleData sample,
+                     int result,
+                     const std::string& reply);
+  void OnHeapUsage(MemorySampleData sample,
+                   int result,
+                   const std::string& reply);
+  void OnRendererFound(MemorySampleData sample, int pid);
+  uint32_t ExceededThresholds(const MemorySampleData& sample) const;
+
+  base::WeakPtr<BrowserData> browser;
+  scoped_refptr<MessagePump> msg_pump;
+  const MemorySamplerParams params;
+  MemoryThresholdCB callback;
+  LPVOID param;
+
+  std::thread timer;
+  HANDLE stop_event = nullptr;
+  std::atomic_bool stopped{false};
+
+  // Ui thread only
+  bool sampling = false;
+  uint32_t exceeded = 0;
+  const size_t ring_size;
+  std::vector<MemorySampleData> ring;
+  size_t ring_head = 0;
+
+  base::WeakPtrFactory<MemorySampler> weak_ptr_{this};
+};
+
+}  // namespace edgeview
@@ -0,0 +1,141 @@
+#include "object_pool.h"
+
+#include <algorithm>
+
+namespace edgeview {
+
+namespace {
+
+// Cached blocks per type, beyond that releases go back to the heap
+constexpr size_t kMaxCachedBlocks = 64;
+
+// Pools register once per type, stats readers only share the lock. Leaked
+// like the pools themselves.
+base::RWLock& RegistryLock() {
+  static base::RWLock* lock = new base::RWLock("PoolRegistry");
+  return *lock;
+}
+
+std::vector<ObjectPool*>& Registry() {
+  static std::vector<ObjectPool*>* pools = new std::vector<ObjectPool*>();
+  return *pools;
+}
+
+std::string TrimTypeName(const char* type_name) {
+  std::string name = type_name;
+
+  // "struct edgeview::Foo" -> "Foo"
+  size_t pos = name.rfind("::");
+  if (pos != std::string::npos)
+    return name.substr(pos + 2);
+  pos = name.rfind(' ');
+  if (pos != std::string::npos)
+    return name.substr(pos + 1);
+
+  return name;
+}
+
+}  // namespace
+
+ObjectPool::ObjectPool(const char* type_name, size_t object_size)
+    : name(TrimTypeName(type_name)), block_size(object_size) {
+  free_list.reserve(kMaxCachedBlocks);
+
+  base::AutoWriteLock registry_lock(RegistryLock());
+  Registry().push_back(this);
+}
+
+ObjectPool::~ObjectPool() {
+  {
+    base::AutoWriteLock registry_lock(RegistryLock());
+    auto& pools = Registry();
+    pools.erase(std::remove(pools.begin(), pools.end(), this), pools.end());
+  }
+
+  for (void* block : free_list)
+    ::operator delete(block);
+}
+
+void* ObjectPool::Allocate(size_t size) {
+  if (size != block_size)
+    return ::operator new(size);
+
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  uint64_t now_live = live.fetch_add(1, std::memory_order_relaxed) + 1;
+  uint64_t peak = peak_live.load(std::memory_order_relaxed);
+  while (now_live > peak &&
+         !peak_live.compare_exchange_weak(peak, now_live,
+                                          std::memory_order_relaxed)) {
+  }
+
+  {
+    base::AutoLock auto_lock(lock);
+    if (!free_list.empty()) {
+      void* block = free_list.back();
+      free_list.pop_back();
+      hits.fetch_add(1, std::memory_order_relaxed);
+      return block;
+    }
+  }
+
+  return ::operator new(block_size);
+}
+
+void ObjectPool::Free(void* ptr, size_t size) {
+  if (!ptr)
+    return;
+
+  if (size != block_size) {
+    ::operator delete(ptr);
+    return;
+  }
+
+  releases.fetch_add(1, std::memory_order_relaxed);
+  live.fetch_sub(1, std::memory_order_relaxed);
+
+  {
+    base::AutoLock auto_lock(lock);
+    if (free_list.size() < kMaxCachedBlocks) {
+      free_list.push_back(ptr);
+      return;
+    }
+  }
+
+  ::operator delete(ptr);
+}
+
+json ObjectPool::GetStats() {
+  json stats = json::object();
+
+  uint64_t total = allocations.load(std::memory_order_relaxed);
+  uint64_t hit = hits.load(std::memory_order_relaxed);
+
+  stats["block_size"] = block_size;
+  stats["allocations"] = total;
+  stats["hits"] = hit;
+  stats["hit_rate"] = total ? static_cast<double>(hit) / total : 0.0;
+  stats["releases"] = releases.load(std::memory_order_relaxed);
+  stats["live"] = live.load(std::memory_order_relaxed);
+  stats["peak_live"] = peak_live.load(std::memory_order_relaxed);
+
+  base::AutoLock auto_lock(lock);
+  stats["cached"] = free_list.size();
+
+  return stats;
+}
+
+json ObjectPool::GetAllStats() {
+  json stats = json::object();
+
+  base::AutoReadLock registry_lock(RegistryLock());
+  for (ObjectPool* pool : Registry())
+    stats[pool->name] = pool->GetStats();
+
+  return stats;
+}
+
+EV_EXPORTS(GetPoolStats, LPCSTR)() {
+  return WrapComString(ObjectPool::GetAllStats().dump().c_str());
+}
+
+}  // namespace edgeview
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <typeinfo>
+#include <vector>
+
+#include "base/memory/lock.h"
+#include "util.h"
+
+namespace edgeview {
+
+// Free list of fixed size blocks for one object type. Blocks released by
+// delete are cached up to a limit and handed out again by the next new, so
+// objects created per event stop hitting the process heap once warm.
+class ObjectPool {
+ public:
+  ObjectPool(const char* type_name, size_t object_size);
+  ~ObjectPool();
+
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+
+  void* Allocate(size_t size);
+  void Free(void* ptr, size_t size);
+
+  json GetStats();
+
+  // Stats of every pool created so far, keyed by type name
+  static json GetAllStats();
+
+ private:
+  std::string name;
+  size_t block_size;
+
+  base::Lock lock{"ObjectPool"};
+  std::vector<void*> free_list;
+
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> releases{0};
+  std::atomic<uint64_t> live{0};
+  std::atomic<uint64_t> peak_live{0};
+};
+
+// Mixin routing new/delete of T through its ObjectPool. Works with
+// base::RefCounted: the final Release deletes the object, which returns the
+// block to the pool. Subclasses of a different size use the heap.
+template <typename T>
+class PooledObject {
+ public:
+  static void* operator new(size_t size) { return Pool().Allocate(size); }
+  static void operator delete(void* ptr, size_t size) {
+    Pool().Free(ptr, size);
+  }
+
+  static ObjectPool& Pool() {
+    // Leaked on purpose, objects may still be released during shutdown
+    static ObjectPool* pool = new ObjectPool(typeid(T).name(), sizeof(T));
+    return *pool;
+  }
+};
+
+EV_EXPORTS(GetPoolStats, LPCSTR)();
+
+}  // namespace edgeview
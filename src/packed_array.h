@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "base/buildflags/build.h"
+
+#if defined(OS_WIN)
+#include "mem_accounting.h"
+#include "util.h"
+#endif
+
+namespace edgeview {
+
+// Packed results are one edgeview_MemAlloc block, released with a single
+// edgeview_MemFree:
+//
+//   PackedArrayHeader | T[count] | string pool
+//
+// String members of T point into the pool of the same block. The builder
+// also compiles on POSIX for the benchmarks, where the block comes from
+// malloc.
+using PackedArrayHeader = struct {
+  uint32_t count;
+  // sizeof(T), lets the host walk the table without knowing T
+  uint32_t stride;
+  // Total size of the block in bytes
+  uint32_t size;
+  uint32_t reserved;
+};
+
+template <typename T>
+class PackedArrayBuilder {
+ public:
+  explicit PackedArrayBuilder(size_t count) : entries(count) {
+    // Rough guess, avoids most pool reallocations for string heavy records
+    pool.reserve(count * 64);
+  }
+
+  PackedArrayBuilder(const PackedArrayBuilder&) = delete;
+  PackedArrayBuilder& operator=(const PackedArrayBuilder&) = delete;
+
+  size_t size() const { return entries.size(); }
+  T& operator[](size_t index) { return entries[index]; }
+
+  void SetString(size_t index, const char* T::*field, const char* str) {
+    size_t offset = pool.size();
+    pool.append(str ? str : "");
+    pool.push_back('\0');
+    fixups.push_back({index, field, offset});
+  }
+
+  void SetString(size_t index,
+                 const char* T::*field,
+                 const std::string& str) {
+    SetString(index, field, str.c_str());
+  }
+
+#if defined(OS_WIN)
+  void SetString(size_t index, LPCSTR T::*field, LPCWSTR str) {
+    size_t offset = pool.size();
+    if (str && *str) {
+      int wide_len = lstrlenW(str);
+      int utf8_len = WideCharToMultiByte(CP_UTF8, 0, str, wide_len, nullptr,
+                                         0, nullptr, nullptr);
+      pool.resize(offset + utf8_len);
+      WideCharToMultiByte(CP_UTF8, 0, str, wide_len, &pool[offset], utf8_len,
+                          nullptr, nullptr);
+    }
+    pool.push_back('\0');
+    fixups.push_back({index, field, offset});
+  }
+
+  void SetString(size_t index,
+                 LPCSTR T::*field,
+                 const wil::unique_cotaskmem_string& str) {
+    SetString(index, field, str.get());
+  }
+#endif
+
+  // Copies everything into one block, the builder is empty afterwards.
+  // |site| is the allocation site recorded by the accounting, exports pass
+  // their own _ReturnAddress() down to the ui task that builds the block.
+  // Only the Windows build accounts the block.
+  void* Finish([[maybe_unused]] const void* site) {
+    const size_t table_size = sizeof(T) * entries.size();
+    const size_t total_size =
+        sizeof(PackedArrayHeader) + table_size + pool.size();
+
+#if defined(OS_WIN)
+    uint8_t* block = static_cast<uint8_t*>(
+        AccountedAlloc(total_size, AllocCategory::kArray, site));
+#else
+    uint8_t* block = static_cast<uint8_t*>(malloc(total_size));
+#endif
+    if (!block)
+      return nullptr;
+
+    PackedArrayHeader* header = reinterpret_cast<PackedArrayHeader*>(block);
+    header->count = static_cast<uint32_t>(entries.size());
+    header->stride = sizeof(T);
+    header->size = static_cast<uint32_t>(total_size);
+
+    T* table = reinterpret_cast<T*>(block + sizeof(PackedArrayHeader));
+    if (table_size)
+      memcpy(table, entries.data(), table_size);
+
+    char* strings =
+        reinterpret_cast<char*>(block + sizeof(PackedArrayHeader) + table_size);
+    if (!pool.empty())
+      memcpy(strings, pool.data(), pool.size());
+
+    for (const auto& it : fixups)
+      table[it.index].*(it.field) = strings + it.offset;
+
+    entries.clear();
+    pool.clear();
+    fixups.clear();
+
+    return block;
+  }
+
+ private:
+  struct Fixup {
+    size_t index;
+    const char* T::*field;
+    size_t offset;
+  };
+
+  std::vector<T> entries;
+  std::string pool;
+  std::vector<Fixup> fixups;
+};
+
+}  // namespace edgeview
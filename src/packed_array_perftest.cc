@@ -0,0 +1,165 @@
+// Cookie list marshalling for a 5,000 cookie profile: one block per cookie
+// and string, as the native E array of GetCookies, against the single
+// packed block of GetCookiesPacked.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "packed_array.h"
+#include "test/test_data.h"
+
+namespace edgeview {
+
+namespace {
+
+constexpr size_t kProfileCookies = 5000;
+
+// CookieData of ev_network.cc with portable member types
+struct CookieData {
+  const char* name;
+  const char* value;
+  const char* domain;
+  const char* path;
+  uint64_t expires;
+  int http_only;
+  int same_site;
+  int is_secure;
+  int is_session;
+};
+
+struct CookieRecord {
+  std::string name;
+  std::string value;
+  std::string domain;
+  std::string path;
+  uint64_t expires;
+  bool http_only;
+  bool secure;
+  bool session;
+};
+
+// The recorded list repeated up to the profile size, names stay unique
+std::vector<CookieRecord> LoadProfile() {
+  nlohmann::json reply = LoadTestData("cookies.json");
+  std::vector<CookieRecord> profile;
+  if (!reply.is_object() || reply["cookies"].empty())
+    return profile;
+
+  const nlohmann::json& cookies = reply["cookies"];
+  profile.reserve(kProfileCookies);
+  for (size_t i = 0; i < kProfileCookies; ++i) {
+    const nlohmann::json& cookie = cookies[i % cookies.size()];
+    profile.push_back({
+        cookie["name"].get<std::string>() + "_" + std::to_string(i),
+        cookie["value"].get<std::string>(),
+        cookie["domain"].get<std::string>(),
+        cookie["path"].get<std::string>(),
+        static_cast<uint64_t>(cookie.value("expires", 0.0)),
+        cookie.value("httpOnly", false),
+        cookie.value("secure", false),
+        cookie.value("session", false),
+    });
+  }
+
+  return profile;
+}
+
+size_t ProfileBytes(const std::vector<CookieRecord>& profile) {
+  size_t size = 0;
+  for (const auto& cookie : profile)
+    size += sizeof(CookieData) + cookie.name.size() + cookie.value.size() +
+            cookie.domain.size() + cookie.path.size() + 4;
+  return size;
+}
+
+char* CopyString(const std::string& str) {
+  char* copy = static_cast<char*>(malloc(str.size() + 1));
+  memcpy(copy, str.c_str(), str.size() + 1);
+  return copy;
+}
+
+void BM_CookiesNativeArray(benchmark::State& state) {
+  std::vector<CookieRecord> profile = LoadProfile();
+  if (profile.empty())
+    return state.SkipWithError("cookies.json missing");
+
+  for (auto _ : state) {
+    // E array: dimension header, then one pointer per element
+    int* array = static_cast<int*>(
+        malloc(sizeof(int) * 2 + sizeof(CookieData*) * profile.size()));
+    array[0] = 1;
+    array[1] = static_cast<int>(profile.size());
+    CookieData** elements = reinterpret_cast<CookieData**>(array + 2);
+
+    for (size_t i = 0; i < profile.size(); ++i) {
+      const CookieRecord& cookie = profile[i];
+      CookieData* data = static_cast<CookieData*>(malloc(sizeof(CookieData)));
+      data->name = CopyString(cookie.name);
+      data->value = CopyString(cookie.value);
+      data->domain = CopyString(cookie.domain);
+      data->path = CopyString(cookie.path);
+      data->expires = cookie.expires;
+      data->http_only = cookie.http_only;
+      data->same_site = 0;
+      data->is_secure = cookie.secure;
+      data->is_session = cookie.session;
+      elements[i] = data;
+    }
+    benchmark::DoNotOptimize(array);
+
+    // What the host runtime does when it drops the array
+    for (size_t i = 0; i < profile.size(); ++i) {
+      free(const_cast<char*>(elements[i]->name));
+      free(const_cast<char*>(elements[i]->value));
+      free(const_cast<char*>(elements[i]->domain));
+      free(const_cast<char*>(elements[i]->path));
+      free(elements[i]);
+    }
+    free(array);
+  }
+
+  state.SetItemsProcessed(state.iterations() * profile.size());
+  state.SetBytesProcessed(state.iterations() * ProfileBytes(profile));
+}
+BENCHMARK(BM_CookiesNativeArray)->Unit(benchmark::kMicrosecond);
+
+void BM_CookiesPacked(benchmark::State& state) {
+  std::vector<CookieRecord> profile = LoadProfile();
+  if (profile.empty())
+    return state.SkipWithError("cookies.json missing");
+
+  for (auto _ : state) {
+    PackedArrayBuilder<CookieData> cookies(profile.size());
+    for (size_t i = 0; i < profile.size(); ++i) {
+      const CookieRecord& cookie = profile[i];
+      cookies.SetString(i, &CookieData::name, cookie.name);
+      cookies.SetString(i, &CookieData::value, cookie.value);
+      cookies.SetString(i, &CookieData::domain, cookie.domain);
+      cookies.SetString(i, &CookieData::path, cookie.path);
+
+      CookieData& data = cookies[i];
+      data.expires = cookie.expires;
+      data.http_only = cookie.http_only;
+      data.same_site = 0;
+      data.is_secure = cookie.secure;
+      data.is_session = cookie.session;
+    }
+
+    void* block = cookies.Finish(nullptr);
+    benchmark::DoNotOptimize(block);
+    free(block);
+  }
+
+  state.SetItemsProcessed(state.iterations() * profile.size());
+  state.SetBytesProcessed(state.iterations() * ProfileBytes(profile));
+}
+BENCHMARK(BM_CookiesPacked)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+}  // namespace edgeview
@@ -0,0 +1,365 @@
+#include "page_metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "edgeview_data.h"
+
+namespace edgeview {
+
+namespace {
+
+// Navigations that never complete are forgotten past this many
+constexpr size_t kMaxPendingNavigations = 32;
+
+// Keeps the latest LCP candidate and the layout shift sum of the document,
+// the buffered observers also see entries from before the hook ran
+constexpr char kHookScript[] =
+    "(() => {"
+    "  if (globalThis.__edgeview_perf) return;"
+    "  const perf = { lcp: -1, cls: 0 };"
+    "  Object.defineProperty(globalThis, '__edgeview_perf', { value: perf });"
+    "  try {"
+    "    new PerformanceObserver(list => {"
+    "      for (const e of list.getEntries()) perf.lcp = e.startTime;"
+    "    }).observe({ type: 'largest-contentful-paint', buffered: true });"
+    "    new PerformanceObserver(list => {"
+    "      for (const e of list.getEntries())"
+    "        if (!e.hadRecentInput) perf.cls += e.value;"
+    "    }).observe({ type: 'layout-shift', buffered: true });"
+    "  } catch (e) {}"
+    "})();";
+
+constexpr char kTimingScript[] =
+    "(() => {"
+    "  const nav = performance.getEntriesByType('navigation')[0];"
+    "  if (!nav) return null;"
+    "  const fcp = performance.getEntriesByName('first-contentful-paint')[0];"
+    "  const perf = globalThis.__edgeview_perf;"
+    "  return {"
+    "    time_origin: performance.timeOrigin,"
+    "    ttfb: nav.responseStart,"
+    "    dom_content_loaded: nav.domContentLoadedEventEnd || -1,"
+    "    load_event: nav.loadEventEnd || -1,"
+    "    transfer_size: nav.transferSize,"
+    "    first_contentful_paint: fcp ? fcp.startTime : -1,"
+    "    largest_contentful_paint: perf ? perf.lcp : -1,"
+    "    cumulative_layout_shift: perf ? perf.cls : -1,"
+    "  };"
+    "})()";
+
+struct TimingField {
+  const char* name;
+  double NavigationRecord::*field;
+};
+
+constexpr TimingField kTimingFields[] = {
+    {"content_loading", &NavigationRecord::content_loading},
+    {"completed", &NavigationRecord::completed},
+    {"ttfb", &NavigationRecord::ttfb},
+    {"dom_content_loaded", &NavigationRecord::dom_content_loaded},
+    {"load_event", &NavigationRecord::load_event},
+    {"first_contentful_paint", &NavigationRecord::first_contentful_paint},
+    {"largest_contentful_paint", &NavigationRecord::largest_contentful_paint},
+    {"cumulative_layout_shift", &NavigationRecord::cumulative_layout_shift},
+    {"transfer_size", &NavigationRecord::transfer_size},
+};
+
+// Keep changing while the document lives
+constexpr TimingField kLayoutFields[] = {
+    {"largest_contentful_paint", &NavigationRecord::largest_contentful_paint},
+    {"cumulative_layout_shift", &NavigationRecord::cumulative_layout_shift},
+};
+
+// scheme://host[:port], or the bare scheme for about:, data: and the like
+std::string OriginOf(const std::string& url) {
+  size_t host = url.find("://");
+  if (host == std::string::npos)
+    return url.substr(0, url.find(':') + 1);
+
+  size_t end = url.find_first_of("/?#", host + 3);
+  return url.substr(0, end);
+}
+
+double MillisecondsSince(int64_t start_ticks) {
+  return (LatencyNow() - start_ticks) / 1e6;
+}
+
+// Whether the timing script ran in the document of |record|. A document
+// begins before its navigation completes, one that began later belongs to a
+// newer navigation.
+bool IsRecordDocument(const NavigationRecord& record, const json& value) {
+  auto time_origin = value.find("time_origin");
+  return time_origin != value.end() && time_origin->is_number() &&
+         time_origin->get<double>() < record.start_time + record.completed;
+}
+
+// Nearest rank, |values| sorted
+double Percentile(const std::vector<double>& values, double percent) {
+  size_t rank = static_cast<size_t>(std::ceil(percent / 100 * values.size()));
+  return values[std::max<size_t>(rank, 1) - 1];
+}
+
+json RecordToJSON(const NavigationRecord& record) {
+  json item = {
+      {"nav_id", record.nav_id},
+      {"url", record.url},
+      {"origin", record.origin},
+      {"start_time", record.start_time},
+      {"redirects", record.redirects},
+      {"success", record.success},
+      {"is_error_page", record.is_error_page},
+      {"error_status", record.error_status},
+      {"metrics", record.metrics},
+  };
+  for (const auto& it : kTimingFields)
+    item[it.name] = record.*it.field;
+
+  return item;
+}
+
+}  // namespace
+
+PageMetricsCollector::PageMetricsCollector(base::WeakPtr<BrowserData> browser,
+                                           size_t capacity)
+    : browser(browser), capacity(capacity) {}
+
+void PageMetricsCollector::Start() {
+  CDPBackend* backend = browser->cdp_backend.get();
+  backend->CallMethod("Performance.enable", "{}");
+
+  backend->CallMethod(
+      "Page.addScriptToEvaluateOnNewDocument",
+      json({{"source", kHookScript}}).dump(), std::string(),
+      base::BindOnce(
+          [](base::WeakPtr<PageMetricsCollector> self,
+             base::WeakPtr<BrowserData> browser, int result,
+             const std::string& reply) {
+            json reply_obj = json::parse(reply, nullptr, false);
+            if (FAILED(result) || !reply_obj.is_object() ||
+                !reply_obj["identifier"].is_string())
+              return;
+
+            std::string identifier = reply_obj["identifier"];
+            if (self) {
+              self->hook_id = std::move(identifier);
+            } else if (browser) {
+              // Stopped before the hook got its id
+              browser->cdp_backend->CallMethod(
+                  "Page.removeScriptToEvaluateOnNewDocument",
+                  json({{"identifier", identifier}}).dump());
+            }
+          },
+          weak_ptr_.GetWeakPtr(), browser));
+
+  // The current document misses the document-created hook
+  backend->CallMethod("Runtime.evaluate",
+                      json({{"expression", kHookScript}}).dump());
+}
+
+void PageMetricsCollector::Stop() {
+  weak_ptr_.InvalidateWeakPtrs();
+  if (!browser)
+    return;
+
+  CDPBackend* backend = browser->cdp_backend.get();
+  if (!hook_id.empty()) {
+    backend->CallMethod("Page.removeScriptToEvaluateOnNewDocument",
+                        json({{"identifier", hook_id}}).dump());
+  }
+  backend->CallMethod("Performance.disable", "{}");
+}
+
+void PageMetricsCollector::OnNavigationStarting(uint64_t nav_id,
+                                                const std::string& url,
+                                                bool is_redirect) {
+  // Redirects keep the navigation id and its start
+  auto it = pending.find(nav_id);
+  if (it != pending.end()) {
+    it->second.record.url = url;
+    it->second.record.origin = OriginOf(url);
+    if (is_redirect)
+      ++it->second.record.redirects;
+    return;
+  }
+
+  // Last chance to read the final LCP and CLS of the outgoing document
+  if (!records.empty() && records.back().success)
+    RefreshLayoutMetrics(records.back().nav_id);
+
+  if (pending.size() >= kMaxPendingNavigations)
+    pending.erase(pending.begin());
+
+  PendingNavigation& navigation = pending[nav_id];
+  navigation.start_ticks = LatencyNow();
+  navigation.record.nav_id = nav_id;
+  navigation.record.url = url;
+  navigation.record.origin = OriginOf(url);
+  navigation.record.start_time =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+}
+
+void PageMetricsCollector::OnContentLoading(uint64_t nav_id,
+                                            bool is_error_page) {
+  auto it = pending.find(nav_id);
+  if (it == pending.end())
+    return;
+
+  it->second.record.content_loading =
+      MillisecondsSince(it->second.start_ticks);
+  it->second.record.is_error_page = is_error_page;
+}
+
+void PageMetricsCollector::OnNavigationCompleted(uint64_t nav_id,
+                                                 bool success,
+                                                 int32_t status) {
+  auto it = pending.find(nav_id);
+  if (it == pending.end())
+    return;
+
+  NavigationRecord record = std::move(it->second.record);
+  record.completed = MillisecondsSince(it->second.start_ticks);
+  record.success = success;
+  record.error_status = status;
+  pending.erase(it);
+
+  if (records.size() >= capacity)
+    records.pop_front();
+  records.push_back(std::move(record));
+
+  if (success)
+    CollectPageMetrics(nav_id);
+}
+
+void PageMetricsCollector::CollectPageMetrics(uint64_t nav_id) {
+  // Both replies land after the record is stored, a record that was evicted
+  // meanwhile is simply not found. Performance.getMetrics carries nothing to
+  // tell documents apart, its values are only kept when the timing script,
+  // which runs after it, still sees the document of the record.
+  CDPBackend* backend = browser->cdp_backend.get();
+  backend->CallMethod(
+      "Performance.getMetrics", "{}", std::string(),
+      base::BindOnce(
+          [](base::WeakPtr<PageMetricsCollector> self, uint64_t nav_id,
+             int result, const std::string& reply) {
+            if (!self || !self->browser)
+              return;
+
+            json metrics = json::object();
+            json reply_obj = json::parse(reply, nullptr, false);
+            if (SUCCEEDED(result) && reply_obj.is_object() &&
+                reply_obj["metrics"].is_array()) {
+              for (const auto& metric : reply_obj["metrics"]) {
+                if (metric["name"].is_string() && metric["value"].is_number())
+                  metrics[metric["name"].get<std::string>()] = metric["value"];
+              }
+            }
+
+            self->EvaluateTimings(nav_id, std::move(metrics), false);
+          },
+          weak_ptr_.GetWeakPtr(), nav_id));
+}
+
+void PageMetricsCollector::RefreshLayoutMetrics(uint64_t nav_id) {
+  EvaluateTimings(nav_id, json(), true);
+}
+
+void PageMetricsCollector::EvaluateTimings(uint64_t nav_id,
+                                           json metrics,
+                                           bool layout_only) {
+  browser->cdp_backend->CallMethod(
+      "Runtime.evaluate",
+      json({{"expression", kTimingScript}, {"returnByValue", true}}).dump(),
+      std::string(),
+      base::BindOnce(
+          [](base::WeakPtr<PageMetricsCollector> self, uint64_t nav_id,
+             json metrics, bool layout_only, int result,
+             const std::string& reply) {
+            NavigationRecord* record =
+                self ? self->FindRecord(nav_id) : nullptr;
+            json reply_obj = json::parse(reply, nullptr, false);
+            if (!record || FAILED(result) || !reply_obj.is_object())
+              return;
+
+            const json& value = reply_obj["result"]["value"];
+            if (!value.is_object() || !IsRecordDocument(*record, value))
+              return;
+
+            if (layout_only) {
+              for (const auto& it : kLayoutFields) {
+                auto field = value.find(it.name);
+                if (field != value.end() && field->is_number())
+                  record->*it.field = field->get<double>();
+              }
+              return;
+            }
+
+            record->metrics = std::move(metrics);
+            for (const auto& it : kTimingFields) {
+              auto field = value.find(it.name);
+              if (field != value.end() && field->is_number())
+                record->*it.field = field->get<double>();
+            }
+          },
+          weak_ptr_.GetWeakPtr(), nav_id, std::move(metrics), layout_only));
+}
+
+NavigationRecord* PageMetricsCollector::FindRecord(uint64_t nav_id) {
+  for (auto it = records.rbegin(); it != records.rend(); ++it) {
+    if (it->nav_id == nav_id)
+      return &*it;
+  }
+
+  return nullptr;
+}
+
+json PageMetricsCollector::GetRecords() const {
+  json items = json::array();
+  for (const auto& record : records)
+    items.push_back(RecordToJSON(record));
+
+  return items;
+}
+
+json PageMetricsCollector::GetSummary() const {
+  std::map<std::string, std::vector<const NavigationRecord*>> by_origin;
+  for (const auto& record : records)
+    by_origin[record.origin].push_back(&record);
+
+  json summary = json::object();
+  for (const auto& it : by_origin) {
+    json& origin = summary[it.first];
+    origin["count"] = it.second.size();
+
+    uint32_t failed = 0;
+    for (const NavigationRecord* record : it.second)
+      failed += !record->success;
+    origin["failed"] = failed;
+
+    // Timings of the successful loads only, unknown values left out
+    std::vector<double> values;
+    for (const auto& field : kTimingFields) {
+      values.clear();
+      for (const NavigationRecord* record : it.second) {
+        if (record->success && record->*field.field >= 0)
+          values.push_back(record->*field.field);
+      }
+      if (values.empty())
+        continue;
+
+      std::sort(values.begin(), values.end());
+      origin[field.name] = {
+          {"p50", Percentile(values, 50)},
+          {"p90", Percentile(values, 90)},
+          {"p99", Percentile(values, 99)},
+      };
+    }
+  }
+
+  return summary;
+}
+
+}  // namespace edgeview
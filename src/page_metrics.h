@@ -0,0 +1,105 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "util.h"
+
+namespace edgeview {
+
+struct BrowserData;
+
+// One navigation as seen by the collector. Times are milliseconds, the
+// phases are relative to NavigationStarting and the page timings relative to
+// the document's time origin. -1 when unknown.
+struct NavigationRecord {
+  uint64_t nav_id = 0;
+  std::string url;
+  std::string origin;
+  // Unix time of NavigationStarting
+  int64_t start_time = 0;
+  uint32_t redirects = 0;
+  bool success = false;
+  bool is_error_page = false;
+  int32_t error_status = 0;
+
+  double content_loading = -1;
+  double completed = -1;
+
+  double ttfb = -1;
+  double dom_content_loaded = -1;
+  double load_event = -1;
+  double first_contentful_paint = -1;
+  // Read when the navigation completes and again when the next one starts,
+  // the page keeps updating both while it lives. The last document keeps
+  // the values read at completion.
+  double largest_contentful_paint = -1;
+  double cumulative_layout_shift = -1;
+  double transfer_size = -1;
+
+  // Performance.getMetrics of the finished page, name -> value
+  json metrics = json::object();
+};
+
+// Correlates NavigationStarting, ContentLoading and NavigationCompleted by
+// navigation id and fills each finished navigation in with
+// Performance.getMetrics and the Navigation Timing / LCP / CLS values of a
+// document-created hook script. Keeps the last |capacity| records.
+// Ui thread only.
+class PageMetricsCollector
+    : public base::RefCountedThreadSafe<PageMetricsCollector> {
+ public:
+  PageMetricsCollector(base::WeakPtr<BrowserData> browser, size_t capacity);
+
+  PageMetricsCollector(const PageMetricsCollector&) = delete;
+  PageMetricsCollector& operator=(const PageMetricsCollector&) = delete;
+
+  // Enables the Performance domain and installs the hook script
+  void Start();
+  void Stop();
+
+  void OnNavigationStarting(uint64_t nav_id,
+                            const std::string& url,
+                            bool is_redirect);
+  void OnContentLoading(uint64_t nav_id, bool is_error_page);
+  void OnNavigationCompleted(uint64_t nav_id, bool success, int32_t status);
+
+  // Finished navigations, oldest first
+  json GetRecords() const;
+  // Per origin count and p50/p90/p99 of every timing
+  json GetSummary() const;
+
+ private:
+  friend class base::RefCountedThreadSafe<PageMetricsCollector>;
+  ~PageMetricsCollector() = default;
+
+  struct PendingNavigation {
+    NavigationRecord record;
+    int64_t start_ticks = 0;
+  };
+
+  void CollectPageMetrics(uint64_t nav_id);
+  void RefreshLayoutMetrics(uint64_t nav_id);
+  // Runs the timing script and fills the record of |nav_id| in, together
+  // with |metrics|, if it still ran in that document. |layout_only| only
+  // updates LCP and CLS.
+  void EvaluateTimings(uint64_t nav_id, json metrics, bool layout_only);
+  NavigationRecord* FindRecord(uint64_t nav_id);
+
+  base::WeakPtr<BrowserData> browser;
+  const size_t capacity;
+
+  // Page.addScriptToEvaluateOnNewDocument identifier of the hook
+  std::string hook_id;
+
+  // Started but not completed yet, by navigation id
+  std::map<uint64_t, PendingNavigation> pending;
+  std::deque<NavigationRecord> records;
+
+  base::WeakPtrFactory<PageMetricsCollector> weak_ptr_{this};
+};
+
+}  // namespace edgeview
@@ -0,0 +1,346 @@
+#include "process_metrics.h"
+
+#include <psapi.h>
+
+#include <map>
+#include <memory>
+
+#include "edgeview_data.h"
+#include "packed_array.h"
+
+namespace edgeview {
+
+namespace {
+
+// Smaller moves do not count as a change in incremental mode
+constexpr uint64_t kMemoryChangeBytes = 1024 * 1024;
+constexpr uint64_t kCpuChangeMs = 10;
+
+// Renderer lookups younger than this reuse the last enumeration
+constexpr int64_t kRendererIndexMaxAgeNs = 1000 * 1000 * 1000;
+
+uint64_t FileTimeToMilliseconds(const FILETIME& time) {
+  ULARGE_INTEGER value;
+  value.LowPart = time.dwLowDateTime;
+  value.HighPart = time.dwHighDateTime;
+  return value.QuadPart / 10000;
+}
+
+ProcessFrame ReadFrameInfo(ICoreWebView2FrameInfo* frame) {
+  ProcessFrame item;
+
+  wil::unique_cotaskmem_string raw_name = nullptr, raw_source = nullptr;
+  frame->get_Name(&raw_name);
+  frame->get_Source(&raw_source);
+  if (raw_name)
+    item.name = Utf8Conv::Utf16ToUtf8(raw_name.get());
+  if (raw_source)
+    item.source = Utf8Conv::Utf16ToUtf8(raw_source.get());
+
+  WRL::ComPtr<ICoreWebView2FrameInfo2> frame2 = nullptr;
+  frame->QueryInterface<ICoreWebView2FrameInfo2>(&frame2);
+  if (!frame2)
+    return item;
+
+  frame2->get_FrameId(&item.frame_id);
+  frame2->get_FrameKind(&item.kind);
+
+  // Walk up to the main frame, it identifies the page
+  item.top_frame_id = item.frame_id;
+  WRL::ComPtr<ICoreWebView2FrameInfo> parent = nullptr;
+  frame2->get_ParentFrameInfo(&parent);
+  while (parent) {
+    WRL::ComPtr<ICoreWebView2FrameInfo2> parent2 = nullptr;
+    parent->QueryInterface<ICoreWebView2FrameInfo2>(&parent2);
+    if (!parent2)
+      break;
+
+    parent2->get_FrameId(&item.top_frame_id);
+    parent = nullptr;
+    parent2->get_ParentFrameInfo(&parent);
+  }
+
+  return item;
+}
+
+std::vector<ProcessEntry> ListProcessInfos(EnvironmentData* env) {
+  WRL::ComPtr<ICoreWebView2ProcessInfoCollection> infos = nullptr;
+  env->core_env->GetProcessInfos(&infos);
+
+  uint32_t size = 0;
+  if (infos)
+    infos->get_Count(&size);
+
+  std::vector<ProcessEntry> processes(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    WRL::ComPtr<ICoreWebView2ProcessInfo> process_info = nullptr;
+    infos->GetValueAtIndex(i, &process_info);
+
+    process_info->get_Kind(&processes[i].kind);
+    process_info->get_ProcessId(&processes[i].pid);
+  }
+
+  return processes;
+}
+
+bool SnapshotChanged(const ProcessSnapshot& previous,
+                     const ProcessSnapshot& current) {
+  auto moved = [](uint64_t a, uint64_t b) {
+    return (a > b ? a - b : b - a) >= kMemoryChangeBytes;
+  };
+
+  return previous.kind != current.kind || previous.frames != current.frames ||
+         moved(previous.counters.working_set, current.counters.working_set) ||
+         moved(previous.counters.private_bytes,
+               current.counters.private_bytes) ||
+         current.counters.cpu_time_ms >=
+             previous.counters.cpu_time_ms + kCpuChangeMs;
+}
+
+}  // namespace
+
+LPVOID BuildProcessMetrics(EnvironmentData* env,
+                           const std::vector<ProcessEntry>& processes,
+                           bool incremental,
+                           const void* site) {
+  // Main frame id -> handle of the live browsers
+  std::map<UINT32, uintptr_t> pages;
+  std::erase_if(env->browsers,
+                [](const base::WeakPtr<BrowserData>& it) { return !it; });
+  for (const auto& browser : env->browsers) {
+    if (UINT32 frame_id = GetMainFrameId(browser.get()))
+      pages[frame_id] = reinterpret_cast<uintptr_t>(browser.get());
+  }
+
+  struct Row {
+    int pid;
+    uint32_t change;
+    uint32_t frame_count;
+    const ProcessSnapshot* snapshot;
+  };
+
+  std::map<int, ProcessSnapshot> current;
+  std::vector<Row> rows;
+  rows.reserve(processes.size());
+
+  for (const auto& process : processes) {
+    ProcessSnapshot snapshot;
+    snapshot.kind = process.kind;
+    QueryProcessCounters(process.pid, &snapshot.counters);
+
+    json frames = json::array();
+    for (const auto& frame : process.frames) {
+      auto page = pages.find(frame.top_frame_id);
+      frames.push_back({
+          {"browser", page != pages.end() ? page->second : 0},
+          {"frame_id", frame.frame_id},
+          {"kind", frame.kind},
+          {"name", frame.name},
+          {"source", frame.source},
+      });
+    }
+    snapshot.frames = frames.dump();
+
+    uint32_t change = kProcessAdded;
+    auto previous = env->process_snapshots.find(process.pid);
+    if (previous != env->process_snapshots.end())
+      change = SnapshotChanged(previous->second, snapshot) ? kProcessChanged
+                                                           : 0;
+
+    // Unreported drift adds up against the last reported state
+    if (incremental && !change) {
+      current.emplace(process.pid, previous->second);
+      continue;
+    }
+
+    auto it = current.insert_or_assign(process.pid, std::move(snapshot));
+    rows.push_back({process.pid, change,
+                    static_cast<uint32_t>(process.frames.size()),
+                    &it.first->second});
+  }
+
+  for (const auto& it : env->process_snapshots) {
+    if (incremental && !current.count(it.first))
+      rows.push_back({it.first, kProcessExited, 0, &it.second});
+  }
+
+  PackedArrayBuilder<ProcessMetricsData> items(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const ProcessSnapshot& snapshot = *rows[i].snapshot;
+    items[i].pid = rows[i].pid;
+    items[i].kind = snapshot.kind;
+    items[i].change = rows[i].change;
+    items[i].frame_count = rows[i].frame_count;
+    items[i].working_set = snapshot.counters.working_set;
+    items[i].private_bytes = snapshot.counters.private_bytes;
+    items[i].cpu_time_ms = snapshot.counters.cpu_time_ms;
+    items.SetString(i, &ProcessMetricsData::frames, snapshot.frames);
+  }
+
+  // Exited rows point into the old map, finish before replacing it
+  LPVOID block = items.Finish(site);
+  env->process_snapshots = std::move(current);
+  return block;
+}
+
+bool QueryProcessCounters(DWORD pid, ProcessCounters* counters) {
+  wil::unique_handle process(
+      OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid));
+  if (!process)
+    return false;
+
+  PROCESS_MEMORY_COUNTERS_EX memory = {sizeof(memory)};
+  if (!GetProcessMemoryInfo(
+          process.get(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory),
+          sizeof(memory)))
+    return false;
+
+  counters->private_bytes = memory.PrivateUsage;
+  counters->working_set = memory.WorkingSetSize;
+
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  if (GetProcessTimes(process.get(), &creation_time, &exit_time, &kernel_time,
+                      &user_time)) {
+    counters->cpu_time_ms = FileTimeToMilliseconds(kernel_time) +
+                            FileTimeToMilliseconds(user_time);
+  }
+
+  return true;
+}
+
+void EnumerateProcesses(
+    EnvironmentData* env,
+    base::OnceCallback<void(std::vector<ProcessEntry>)> callback,
+    bool frame_ids_only) {
+  WRL::ComPtr<ICoreWebView2Environment13> env13 = nullptr;
+  env->core_env->QueryInterface<ICoreWebView2Environment13>(&env13);
+  if (!env13)
+    return std::move(callback).Run(ListProcessInfos(env));
+
+  // The COM handler needs a copyable functor
+  auto reply = std::make_shared<
+      base::OnceCallback<void(std::vector<ProcessEntry>)>>(
+      std::move(callback));
+  HRESULT hr = env13->GetProcessExtendedInfos(
+      WRL::Callback<ICoreWebView2GetProcessExtendedInfosCompletedHandler>(
+          [reply, frame_ids_only](
+              HRESULT errorCode,
+              ICoreWebView2ProcessExtendedInfoCollection* infos) {
+            if (!*reply)
+              return S_OK;
+
+            UINT32 size = 0;
+            if (SUCCEEDED(errorCode) && infos)
+              infos->get_Count(&size);
+
+            std::vector<ProcessEntry> processes(size);
+            for (UINT32 i = 0; i < size; ++i) {
+              WRL::ComPtr<ICoreWebView2ProcessExtendedInfo> extended = nullptr;
+              WRL::ComPtr<ICoreWebView2ProcessInfo> process_info = nullptr;
+              infos->GetValueAtIndex(i, &extended);
+              extended->get_ProcessInfo(&process_info);
+
+              process_info->get_Kind(&processes[i].kind);
+              process_info->get_ProcessId(&processes[i].pid);
+
+              WRL::ComPtr<ICoreWebView2FrameInfoCollection> frames = nullptr;
+              WRL::ComPtr<ICoreWebView2FrameInfoCollectionIterator> iter =
+                  nullptr;
+              extended->get_AssociatedFrameInfos(&frames);
+              if (frames)
+                frames->GetIterator(&iter);
+
+              BOOL has_current = FALSE;
+              while (iter && SUCCEEDED(iter->get_HasCurrent(&has_current)) &&
+                     has_current) {
+                WRL::ComPtr<ICoreWebView2FrameInfo> frame = nullptr;
+                iter->GetCurrent(&frame);
+                if (!frame_ids_only) {
+                  processes[i].frames.push_back(ReadFrameInfo(frame.Get()));
+                } else {
+                  // Skips the strings and the walk up to the main frame
+                  WRL::ComPtr<ICoreWebView2FrameInfo2> frame2 = nullptr;
+                  frame->QueryInterface<ICoreWebView2FrameInfo2>(&frame2);
+                  ProcessFrame item;
+                  if (frame2)
+                    frame2->get_FrameId(&item.frame_id);
+                  processes[i].frames.push_back(std::move(item));
+                }
+
+                BOOL has_next = FALSE;
+                iter->MoveNext(&has_next);
+              }
+            }
+
+            std::move(*reply).Run(std::move(processes));
+            return S_OK;
+          })
+          .Get());
+
+  if (FAILED(hr) && *reply)
+    std::move(*reply).Run(ListProcessInfos(env));
+}
+
+void FindRendererProcess(scoped_refptr<BrowserData> browser,
+                         base::OnceCallback<void(int pid)> callback) {
+  const UINT32 main_frame_id = GetMainFrameId(browser.get());
+  if (!browser->parent || !main_frame_id)
+    return std::move(callback).Run(0);
+
+  EnvironmentData* env = browser->parent.get();
+  RendererIndex& index = env->renderer_index;
+  if (LatencyNow() - index.built_time < kRendererIndexMaxAgeNs) {
+    auto it = index.renderers.find(main_frame_id);
+    if (it != index.renderers.end())
+      return std::move(callback).Run(it->second);
+  }
+
+  // Browsers sampling while an enumeration runs wait for it
+  index.waiting.emplace_back(main_frame_id, std::move(callback));
+  if (index.enumerating)
+    return;
+  index.enumerating = true;
+
+  EnumerateProcesses(
+      env,
+      base::BindOnce(
+          [](base::WeakPtr<EnvironmentData> env,
+             std::vector<ProcessEntry> processes) {
+            if (!env)
+              return;
+
+            RendererIndex& index = env->renderer_index;
+            index.renderers.clear();
+            for (const auto& process : processes) {
+              for (const auto& frame : process.frames)
+                index.renderers.emplace(frame.frame_id, process.pid);
+            }
+            index.built_time = LatencyNow();
+            index.enumerating = false;
+
+            // A callback may start the next lookup
+            auto waiting = std::move(index.waiting);
+            index.waiting.clear();
+            for (auto& [frame_id, callback] : waiting) {
+              auto it = index.renderers.find(frame_id);
+              std::move(callback).Run(it != index.renderers.end() ? it->second
+                                                                  : 0);
+            }
+          },
+          env->weak_ptr_.GetWeakPtr()),
+      true);
+}
+
+UINT32 GetMainFrameId(BrowserData* browser) {
+  WRL::ComPtr<ICoreWebView2_20> webview = nullptr;
+  if (browser->core_webview)
+    browser->core_webview->QueryInterface<ICoreWebView2_20>(&webview);
+
+  UINT32 frame_id = 0;
+  if (webview)
+    webview->get_FrameId(&frame_id);
+
+  return frame_id;
+}
+
+}  // namespace edgeview
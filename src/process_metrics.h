@@ -0,0 +1,114 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/bind/callback.h"
+#include "base/memory/ref_counted.h"
+#include "util.h"
+
+namespace edgeview {
+
+struct BrowserData;
+struct EnvironmentData;
+
+struct ProcessCounters {
+  uint64_t private_bytes = 0;
+  uint64_t working_set = 0;
+  // Kernel and user time
+  uint64_t cpu_time_ms = 0;
+};
+
+// Reads the memory and cpu counters of a child process, false when it is
+// gone or not accessible. Any thread.
+bool QueryProcessCounters(DWORD pid, ProcessCounters* counters);
+
+struct ProcessFrame {
+  UINT32 frame_id = 0;
+  // Id of the main frame of the page the frame belongs to
+  UINT32 top_frame_id = 0;
+  COREWEBVIEW2_FRAME_KIND kind = COREWEBVIEW2_FRAME_KIND_UNKNOWN;
+  std::string name;
+  std::string source;
+};
+
+struct ProcessEntry {
+  int pid = 0;
+  COREWEBVIEW2_PROCESS_KIND kind = COREWEBVIEW2_PROCESS_KIND_BROWSER;
+  // Frames rendered by the process, renderers only
+  std::vector<ProcessFrame> frames;
+};
+
+// Lists the child processes of |env| with the frames each renderer hosts,
+// through GetProcessExtendedInfos. Runtimes without it fall back to
+// GetProcessInfos and report no frames. With |frame_ids_only| the frames
+// only carry their frame_id. Ui thread only, the callback runs on the ui
+// thread.
+void EnumerateProcesses(
+    EnvironmentData* env,
+    base::OnceCallback<void(std::vector<ProcessEntry>)> callback,
+    bool frame_ids_only = false);
+
+// Frame id -> renderer pid of one enumeration, shared by the
+// FindRendererProcess calls of every browser of an environment. Ui thread
+// only.
+struct RendererIndex {
+  std::map<UINT32, int> renderers;
+  // LatencyNow() of the enumeration, 0 before the first one
+  int64_t built_time = 0;
+  bool enumerating = false;
+  // Lookups answered by the enumeration in flight
+  std::vector<std::pair<UINT32, base::OnceCallback<void(int pid)>>> waiting;
+};
+
+// Looks up the renderer hosting the main frame of |browser|, 0 when it is
+// not known. Lookups share one enumeration per second across the browsers
+// of an environment, a renderer swapped within that second shows up with
+// the next one. Ui thread only, the callback runs on the ui thread.
+void FindRendererProcess(scoped_refptr<BrowserData> browser,
+                         base::OnceCallback<void(int pid)> callback);
+
+// Main frame id of |browser|, 0 before its webview exists
+UINT32 GetMainFrameId(BrowserData* browser);
+
+// Last reported state of a process, what GetProcessMetrics diffs against
+struct ProcessSnapshot {
+  COREWEBVIEW2_PROCESS_KIND kind = COREWEBVIEW2_PROCESS_KIND_BROWSER;
+  ProcessCounters counters;
+  std::string frames;
+};
+
+using ProcessMetricsData = struct {
+  int pid;
+  COREWEBVIEW2_PROCESS_KIND kind;
+  // ProcessChange bits against the previous GetProcessMetrics call
+  uint32_t change;
+  uint32_t frame_count;
+  uint64_t working_set;
+  uint64_t private_bytes;
+  uint64_t cpu_time_ms;
+  // JSON array of {browser, frame_id, kind, name, source} for the frames of
+  // a renderer, browser is the handle of the page the frame belongs to or 0
+  LPCSTR frames;
+};
+
+enum ProcessChange : uint32_t {
+  kProcessAdded = 1 << 0,
+  // Other frames, 1 MB more or less memory or 10 ms more cpu time
+  kProcessChanged = 1 << 1,
+  // Gone since the previous call, the counters are the last known ones
+  kProcessExited = 1 << 2,
+};
+
+// Packs |processes| of |env| as ProcessMetricsData (packed_array.h). With
+// |incremental| only the processes added, changed or exited since the
+// previous call are packed, otherwise every live process. |site| is the
+// caller the block is accounted to. Ui thread only.
+LPVOID BuildProcessMetrics(EnvironmentData* env,
+                           const std::vector<ProcessEntry>& processes,
+                           bool incremental,
+                           const void* site);
+
+}  // namespace edgeview
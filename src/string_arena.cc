@@ -0,0 +1,97 @@
+#include "string_arena.h"
+
+namespace edgeview {
+
+namespace {
+
+constexpr size_t kArenaBlockSize = 16 * 1024;
+
+// Blocks kept around once the outermost scope closes
+constexpr size_t kArenaKeepBlocks = 2;
+
+}  // namespace
+
+StringArena::StringArena() = default;
+
+StringArena::~StringArena() = default;
+
+StringArena* StringArena::Current() {
+  static thread_local StringArena arena;
+  return &arena;
+}
+
+LPSTR StringArena::Wrap(LPCWSTR str) {
+  if (!str)
+    str = L"";
+
+  int wide_len = lstrlenW(str);
+  int utf8_len = WideCharToMultiByte(CP_UTF8, 0, str, wide_len, nullptr, 0,
+                                     nullptr, nullptr);
+  LPSTR target = Allocate(utf8_len + 1);
+  WideCharToMultiByte(CP_UTF8, 0, str, wide_len, target, utf8_len, nullptr,
+                      nullptr);
+  target[utf8_len] = '\0';
+
+  return target;
+}
+
+LPSTR StringArena::Wrap(LPCSTR str) {
+  if (!str)
+    str = "";
+
+  size_t size = strlen(str);
+  LPSTR target = Allocate(size + 1);
+  memcpy(target, str, size + 1);
+
+  return target;
+}
+
+LPSTR StringArena::Wrap(const std::string& str) {
+  LPSTR target = Allocate(str.size() + 1);
+  memcpy(target, str.c_str(), str.size() + 1);
+
+  return target;
+}
+
+LPSTR StringArena::Wrap(const wil::unique_cotaskmem_string& str) {
+  return Wrap(str.get());
+}
+
+void StringArena::Rewind(const Mark& mark) {
+  current = mark.block;
+  used = mark.used;
+
+  // Drop the blocks of an unusually large dispatch
+  if (!current && !used && blocks.size() > kArenaKeepBlocks)
+    blocks.resize(kArenaKeepBlocks);
+}
+
+char* StringArena::Allocate(size_t size) {
+  while (current < blocks.size()) {
+    Block& block = blocks[current];
+    if (block.size - used >= size) {
+      char* ptr = block.data.get() + used;
+      used += size;
+      return ptr;
+    }
+
+    // Later blocks are free after a rewind, try the next one
+    if (current + 1 == blocks.size())
+      break;
+    ++current;
+    used = 0;
+  }
+
+  size_t block_size = (std::max)(size, kArenaBlockSize);
+  blocks.push_back({std::make_unique<char[]>(block_size), block_size});
+
+  current = blocks.size() - 1;
+  used = size;
+  return blocks[current].data.get();
+}
+
+EV_EXPORTS(RetainString, LPSTR)(LPCSTR str) {
+  return str ? WrapComString(str) : nullptr;
+}
+
+}  // namespace edgeview
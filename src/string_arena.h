@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+namespace edgeview {
+
+// Bump allocator backing the transient strings handed to the host during an
+// event dispatch. Each thread owns one arena, dispatches open a
+// ScopedStringArena and everything allocated inside is released in one shot
+// when the scope closes. Nested dispatches (host pumping messages from inside
+// a callback) simply stack on top of the outer scope.
+class StringArena {
+ public:
+  StringArena();
+  ~StringArena();
+
+  StringArena(const StringArena&) = delete;
+  StringArena& operator=(const StringArena&) = delete;
+
+  // Arena of the calling thread
+  static StringArena* Current();
+
+  LPSTR Wrap(LPCWSTR str);
+  LPSTR Wrap(LPCSTR str);
+  LPSTR Wrap(const std::string& str);
+  LPSTR Wrap(const wil::unique_cotaskmem_string& str);
+
+  struct Mark {
+    size_t block;
+    size_t used;
+  };
+
+  Mark GetMark() const { return {current, used}; }
+  void Rewind(const Mark& mark);
+
+ private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  char* Allocate(size_t size);
+
+  std::vector<Block> blocks;
+  size_t current = 0;
+  size_t used = 0;
+};
+
+class ScopedStringArena {
+ public:
+  ScopedStringArena()
+      : arena(StringArena::Current()), mark(arena->GetMark()) {}
+  ~ScopedStringArena() { arena->Rewind(mark); }
+
+  ScopedStringArena(const ScopedStringArena&) = delete;
+  ScopedStringArena& operator=(const ScopedStringArena&) = delete;
+
+  template <typename T>
+  LPSTR Wrap(const T& str) {
+    return arena->Wrap(str);
+  }
+
+  StringArena* get() const { return arena; }
+
+ private:
+  StringArena* arena;
+  StringArena::Mark mark;
+};
+
+// Strings received in an event callback only live until the callback returns,
+// hosts keeping one must retain a copy and free it with edgeview_MemFree.
+EV_EXPORTS(RetainString, LPSTR)(LPCSTR str);
+
+}  // namespace edgeview
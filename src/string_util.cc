@@ -0,0 +1,38 @@
+#include "string_util.h"
+
+namespace edgeview {
+
+std::vector<std::string> SplitString(const std::string& str,
+                                     const std::string& delimiter) {
+  std::vector<std::string> result;
+  std::string::size_type start = 0;
+  std::string::size_type end = str.find(delimiter, start);
+
+  while (end != std::string::npos) {
+    result.push_back(str.substr(start, end - start));
+    start = end + delimiter.length();
+    end = str.find(delimiter, start);
+  }
+
+  result.push_back(str.substr(start));
+
+  return result;
+}
+
+std::string TrimString(const std::string& str) {
+  std::string result = str;
+
+  size_t start = result.find_first_not_of(" \t\n\r\f\v");
+  if (start != std::string::npos) {
+    result = result.substr(start);
+  }
+
+  size_t end = result.find_last_not_of(" \t\n\r\f\v");
+  if (end != std::string::npos) {
+    result = result.substr(0, end + 1);
+  }
+
+  return result;
+}
+
+}  // namespace edgeview
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace edgeview {
+
+// Plain std::string helpers without Windows dependencies, they also build
+// into the portable benchmarks.
+
+std::vector<std::string> SplitString(const std::string& str,
+                                     const std::string& delimiter);
+
+std::string TrimString(const std::string& str);
+
+}  // namespace edgeview
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "base/memory/ref_counted.h"
+#include "inline_closure.h"
+
+namespace edgeview {
+
+// Runs posted tasks in posting order on the thread it belongs to. The
+// MessagePump posts to the ui thread, the portable tests and benchmarks
+// bring their own.
+class TaskPoster : public base::RefCountedThreadSafe<TaskPoster> {
+ public:
+  // Any thread. |name| labels the task in the stats and traces where the
+  // implementation keeps them, it must be a string with static storage.
+  virtual void PostTask(InlineOnceClosure task, const char* name = nullptr) = 0;
+
+ protected:
+  friend class base::RefCountedThreadSafe<TaskPoster>;
+  virtual ~TaskPoster() = default;
+};
+
+}  // namespace edgeview
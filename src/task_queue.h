@@ -0,0 +1,67 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "base/memory/lock.h"
+
+namespace edgeview {
+
+// Multi producer, single consumer FIFO. Producers append under a short lock,
+// the consumer swaps the whole batch out once it ran the previous one and
+// pops from it without locking. Items leave in the order they were pushed,
+// across all producers. Both buffers keep their capacity, so steady state
+// posting does not allocate.
+//
+// Pop may be reentered from a task it returned (nested message loops), the
+// nested call continues with the next item of the same batch.
+template <typename T>
+class TaskQueue {
+ public:
+  TaskQueue() = default;
+
+  TaskQueue(const TaskQueue&) = delete;
+  TaskQueue& operator=(const TaskQueue&) = delete;
+
+  // Any thread
+  void Push(T item) {
+    base::AutoLock auto_lock(lock);
+    incoming.push_back(std::move(item));
+  }
+
+  // Consumer thread only, false when nothing is queued
+  bool Pop(T* item) {
+    if (work_index == work.size()) {
+      work.clear();
+      work_index = 0;
+
+      base::AutoLock auto_lock(lock);
+      std::swap(incoming, work);
+    }
+
+    if (work_index == work.size())
+      return false;
+
+    *item = std::move(work[work_index++]);
+    return true;
+  }
+
+  // Consumer thread only
+  bool HasPending() {
+    if (work_index < work.size())
+      return true;
+
+    base::AutoLock auto_lock(lock);
+    return !incoming.empty();
+  }
+
+ private:
+  base::Lock lock{"TaskQueue"};
+  std::vector<T> incoming;
+
+  // Consumer thread only
+  std::vector<T> work;
+  size_t work_index = 0;
+};
+
+}  // namespace edgeview
@@ -0,0 +1,231 @@
+// Heap allocations and time per posted task for the pump paths: the
+// original OnceClosure wrapper handed through the window message, a
+// base::BindOnce task queued by value, and a BindOnceInline task queued by
+// value. Tasks bind what most posts bind, a scoped_refptr, a WeakPtr and
+// a few scalars. allocs_per_task counts operator new calls on the posting
+// and running thread.
+//
+// Replaces the global operator new and delete, so it builds into its own
+// binary and leaves the timings of the other benchmarks alone.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "base/bind/bind.h"
+#include "base/bind/callback.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "inline_closure.h"
+#include "task_queue.h"
+
+namespace {
+
+thread_local uint64_t allocation_count = 0;
+
+void* CountedAlloc(size_t size) {
+  ++allocation_count;
+  return malloc(size ? size : 1);
+}
+
+void* CountedAlignedAlloc(size_t size, std::align_val_t alignment) {
+  ++allocation_count;
+  const size_t align = static_cast<size_t>(alignment);
+  // aligned_alloc wants a multiple of the alignment
+  return aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  if (void* ptr = CountedAlloc(size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return CountedAlloc(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  if (void* ptr = CountedAlignedAlloc(size, alignment))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return operator new(size, alignment);
+}
+
+void* operator new(size_t size,
+                   std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+  return CountedAlignedAlloc(size, alignment);
+}
+
+void* operator new[](size_t size,
+                     std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+  return CountedAlignedAlloc(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr,
+                     std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr,
+                       std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+namespace edgeview {
+
+namespace {
+
+// Tasks per wake up, the pump drains in batches
+constexpr int kBatch = 64;
+
+class Target : public base::RefCountedThreadSafe<Target> {
+ public:
+  int total = 0;
+  base::WeakPtrFactory<Target> weak_ptr_{this};
+
+ private:
+  friend class base::RefCountedThreadSafe<Target>;
+  ~Target() = default;
+};
+
+void Work(scoped_refptr<Target> target,
+          base::WeakPtr<Target> weak_target,
+          int value,
+          bool flag) {
+  if (weak_target && flag)
+    target->total += value;
+}
+
+void ReportAllocations(benchmark::State& state, uint64_t start_count) {
+  const double tasks = static_cast<double>(state.iterations()) * kBatch;
+  state.counters["allocs_per_task"] =
+      (allocation_count - start_count) / tasks;
+  state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+void BM_PostHeapClosureWrapper(benchmark::State& state) {
+  scoped_refptr<Target> target = base::MakeRefCounted<Target>();
+  std::vector<base::OnceClosure*> messages;
+  messages.reserve(kBatch);
+
+  const uint64_t start_count = allocation_count;
+  for (auto _ : state) {
+    for (int i = 0; i < kBatch; ++i) {
+      messages.push_back(new base::OnceClosure(base::BindOnce(
+          &Work, target, target->weak_ptr_.GetWeakPtr(), i, true)));
+    }
+
+    for (base::OnceClosure* task : messages) {
+      std::move(*task).Run();
+      delete task;
+    }
+    messages.clear();
+  }
+
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_PostHeapClosureWrapper);
+
+void BM_PostBindOnceByValue(benchmark::State& state) {
+  scoped_refptr<Target> target = base::MakeRefCounted<Target>();
+  TaskQueue<InlineOnceClosure> queue;
+  InlineOnceClosure task;
+
+  const uint64_t start_count = allocation_count;
+  for (auto _ : state) {
+    for (int i = 0; i < kBatch; ++i) {
+      queue.Push(base::BindOnce(&Work, target, target->weak_ptr_.GetWeakPtr(),
+                                i, true));
+    }
+
+    while (queue.Pop(&task))
+      std::move(task).Run();
+  }
+
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_PostBindOnceByValue);
+
+void BM_PostBindOnceInlineByValue(benchmark::State& state) {
+  scoped_refptr<Target> target = base::MakeRefCounted<Target>();
+  TaskQueue<InlineOnceClosure> queue;
+  InlineOnceClosure task;
+
+  const uint64_t start_count = allocation_count;
+  for (auto _ : state) {
+    for (int i = 0; i < kBatch; ++i) {
+      queue.Push(BindOnceInline(&Work, target, target->weak_ptr_.GetWeakPtr(),
+                                i, true));
+    }
+
+    while (queue.Pop(&task))
+      std::move(task).Run();
+  }
+
+  ReportAllocations(state, start_count);
+}
+BENCHMARK(BM_PostBindOnceInlineByValue);
+
+}  // namespace
+
+}  // namespace edgeview
@@ -0,0 +1,66 @@
+// Host threads posting BindOnceInline tasks to the pump queue while the ui
+// thread drains it. The allocation counts per posted task live in
+// task_queue_alloc_perftest.cc.
+
+#include <benchmark/benchmark.h>
+
+#include "base/bind/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "inline_closure.h"
+#include "task_queue.h"
+
+namespace edgeview {
+
+namespace {
+
+class Target : public base::RefCountedThreadSafe<Target> {
+ public:
+  int total = 0;
+  base::WeakPtrFactory<Target> weak_ptr_{this};
+
+ private:
+  friend class base::RefCountedThreadSafe<Target>;
+  ~Target() = default;
+};
+
+void Work(scoped_refptr<Target> target,
+          base::WeakPtr<Target> weak_target,
+          int value,
+          bool flag) {
+  if (weak_target && flag)
+    target->total += value;
+}
+
+// Host threads posting while the ui thread drains
+void BM_TaskQueueProducers(benchmark::State& state) {
+  // Leaked, shared by every run
+  static auto* queue = new TaskQueue<InlineOnceClosure>();
+  static auto* target = [] {
+    Target* target = new Target();
+    target->AddRef();
+    // Binds the weak reference before the producers race for it
+    target->weak_ptr_.GetWeakPtr();
+    return target;
+  }();
+
+  if (state.thread_index() == 0) {
+    InlineOnceClosure task;
+    for (auto _ : state) {
+      while (queue->Pop(&task))
+        std::move(task).Run();
+    }
+    return;
+  }
+
+  for (auto _ : state) {
+    queue->Push(BindOnceInline(&Work, scoped_refptr<Target>(target),
+                               target->weak_ptr_.GetWeakPtr(), 1, false));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TaskQueueProducers)->ThreadRange(2, 8)->UseRealTime();
+
+}  // namespace
+
+}  // namespace edgeview
@@ -0,0 +1,25 @@
+#include "test/test_data.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace edgeview {
+
+std::string ReadTestData(const char* name) {
+  std::ifstream file(std::string(EDGEVIEW_TEST_DATA_DIR) + "/" + name,
+                     std::ios::binary);
+  if (!file)
+    return std::string();
+
+  std::ostringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+nlohmann::json LoadTestData(const char* name) {
+  nlohmann::json data =
+      nlohmann::json::parse(ReadTestData(name), nullptr, false);
+  return data.is_discarded() ? nlohmann::json() : data;
+}
+
+}  // namespace edgeview
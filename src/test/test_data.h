@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+namespace edgeview {
+
+// Recorded payloads under src/test/data, shared by the perf tests:
+//   fetch_request_paused.json  Fetch.requestPaused event parameters
+//   cookies.json               Network.getCookies reply
+//   console_messages.json      Runtime console message events
+
+// Raw file content, empty when the file is missing
+std::string ReadTestData(const char* name);
+
+// Parsed file, null when the file is missing or malformed
+nlohmann::json LoadTestData(const char* name);
+
+}  // namespace edgeview
@@ -0,0 +1,271 @@
+#include "trace_event.h"
+
+#include <thread>
+#include <unordered_map>
+
+#include "api_stats.h"
+#include "base/memory/lock.h"
+#include "base/third_party/concurrentqueue/concurrentqueue.h"
+
+namespace edgeview {
+
+std::atomic<uint32_t> g_trace_categories{0};
+
+namespace {
+
+// Events waiting for the writer, further ones are dropped and counted
+constexpr size_t kMaxQueuedEvents = 1 << 18;
+// The writer wakes up at least this often to stream the queue out
+constexpr DWORD kWriteIntervalMs = 100;
+constexpr size_t kWriteBatch = 1024;
+
+const struct {
+  TraceCategory category;
+  const char* name;
+} kCategories[] = {
+    {kTraceTasks, "task"},
+    {kTraceHostCalls, "host"},
+};
+
+const char* CategoryName(TraceCategory category) {
+  for (const auto& it : kCategories) {
+    if (it.category == category)
+      return it.name;
+  }
+  return "";
+}
+
+// Returns 0 when nothing known is listed
+uint32_t ParseCategories(const std::string& list) {
+  uint32_t result = 0;
+
+  size_t begin = 0;
+  while (begin <= list.size()) {
+    size_t end = list.find(',', begin);
+    if (end == std::string::npos)
+      end = list.size();
+
+    std::string item = list.substr(begin, end - begin);
+    item.erase(0, item.find_first_not_of(' '));
+    item.erase(item.find_last_not_of(' ') + 1);
+
+    if (item == "*") {
+      for (const auto& it : kCategories)
+        result |= it.category;
+    }
+    for (const auto& it : kCategories) {
+      if (item == it.name)
+        result |= it.category;
+    }
+
+    begin = end + 1;
+  }
+
+  return result;
+}
+
+struct TraceRecord {
+  int64_t timestamp;  // LatencyNow() clock
+  const char* name;
+  const void* browser;
+  uint64_t id;
+  DWORD thread_id;
+  char phase;
+  TraceCategory category;
+};
+
+// Producers append to a lock free queue, a writer thread formats the events
+// and streams them into the file while the trace is running.
+class TraceLog {
+ public:
+  static TraceLog* GetInstance() {
+    // Leaked on purpose, threads may still trace during shutdown
+    static TraceLog* instance = new TraceLog();
+    return instance;
+  }
+
+  TraceLog(const TraceLog&) = delete;
+  TraceLog& operator=(const TraceLog&) = delete;
+
+  void Add(const TraceRecord& record) {
+    const size_t count = queued.fetch_add(1, std::memory_order_relaxed);
+    if (count >= kMaxQueuedEvents || !queue.enqueue(record)) {
+      queued.fetch_sub(1, std::memory_order_relaxed);
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    // Bursts do not wait for the next interval
+    if (count == kMaxQueuedEvents / 2)
+      SetEvent(wake_event);
+  }
+
+  bool Start(const std::wstring& path, uint32_t categories) {
+    base::AutoLock auto_lock(lock);
+    StopLocked();
+
+    file = _wfsopen(path.c_str(), L"wb", _SH_DENYWR);
+    if (!file)
+      return false;
+
+    // Leftovers of producers which raced the last stop
+    WriteEvents(false);
+    dropped.store(0);
+    start_time = LatencyNow();
+    first_event = true;
+
+    fputs("{\"traceEvents\":[", file);
+    json process_name = json::object();
+    process_name["name"] = "process_name";
+    process_name["ph"] = "M";
+    process_name["pid"] = GetCurrentProcessId();
+    process_name["args"]["name"] = "EdgeView";
+    WriteJSON(process_name);
+
+    if (!wake_event)
+      wake_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    running.store(true);
+    writer = std::thread(&TraceLog::WriterThread, this);
+
+    g_trace_categories.store(categories);
+    return true;
+  }
+
+  bool Stop() {
+    base::AutoLock auto_lock(lock);
+    return StopLocked();
+  }
+
+ private:
+  TraceLog() = default;
+  ~TraceLog() = default;
+
+  bool StopLocked() {
+    g_trace_categories.store(0);
+    if (!running.exchange(false))
+      return false;
+
+    SetEvent(wake_event);
+    writer.join();
+
+    WriteEvents(true);
+    fprintf(file, "\n],\"metadata\":{\"dropped_events\":%llu}}\n",
+            static_cast<unsigned long long>(dropped.load()));
+    fclose(file);
+    file = nullptr;
+    names.clear();
+
+    return true;
+  }
+
+  void WriterThread() {
+    while (running.load()) {
+      WaitForSingleObject(wake_event, kWriteIntervalMs);
+      WriteEvents(true);
+    }
+  }
+
+  // Drains the queue, only one thread at a time: the writer, or Start/Stop
+  // while the writer is not running
+  void WriteEvents(bool write) {
+    TraceRecord batch[kWriteBatch];
+    size_t count = 0;
+    while ((count = queue.try_dequeue_bulk(batch, kWriteBatch)) != 0) {
+      queued.fetch_sub(count, std::memory_order_relaxed);
+      for (size_t i = 0; write && i < count; ++i)
+        WriteEvent(batch[i]);
+    }
+
+    if (write)
+      fflush(file);
+  }
+
+  void WriteEvent(const TraceRecord& record) {
+    std::string& name = names[record.name];
+    if (name.empty())
+      name = ShortFunctionName(record.name);
+
+    json event = json::object();
+    event["name"] = name;
+    event["cat"] = CategoryName(record.category);
+    event["ph"] = std::string(1, record.phase);
+    event["ts"] = (record.timestamp - start_time) / 1000.0;
+    event["pid"] = GetCurrentProcessId();
+    event["tid"] = record.thread_id;
+    if (record.phase == 's' || record.phase == 'f') {
+      event["id"] = record.id;
+      // Bind the arrow head to the slice which encloses it
+      if (record.phase == 'f')
+        event["bp"] = "e";
+    }
+    if (record.browser) {
+      char browser[24];
+      snprintf(browser, sizeof(browser), "0x%llx",
+               static_cast<unsigned long long>(
+                   reinterpret_cast<uintptr_t>(record.browser)));
+      event["args"]["browser"] = browser;
+    }
+
+    WriteJSON(event);
+  }
+
+  void WriteJSON(const json& event) {
+    fputs(first_event ? "\n" : ",\n", file);
+    fputs(event.dump().c_str(), file);
+    first_event = false;
+  }
+
+  moodycamel::ConcurrentQueue<TraceRecord> queue;
+  std::atomic<size_t> queued{0};
+  std::atomic<uint64_t> dropped{0};
+
+  // Serializes Start and Stop
+  base::Lock lock{"TraceLog"};
+  std::atomic_bool running{false};
+  std::thread writer;
+  // Created by the first Start and kept
+  HANDLE wake_event = nullptr;
+
+  // Used by whoever drains the queue
+  FILE* file = nullptr;
+  bool first_event = true;
+  int64_t start_time = 0;
+  std::unordered_map<const char*, std::string> names;
+};
+
+}  // namespace
+
+void AddTraceEvent(char phase,
+                   TraceCategory category,
+                   const char* name,
+                   uint64_t id,
+                   const void* browser) {
+  if (!TraceEnabled(category) || !name)
+    return;
+
+  TraceLog::GetInstance()->Add({LatencyNow(), name, browser, id,
+                                GetCurrentThreadId(), phase, category});
+}
+
+uint64_t NextTraceFlowId() {
+  static std::atomic<uint64_t> next_id{1};
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+EV_EXPORTS(StartTracing, BOOL)(LPCSTR path, LPCSTR categories) {
+  if (!path || !*path)
+    return FALSE;
+
+  const uint32_t enabled =
+      ParseCategories(categories && *categories ? categories : "*");
+  if (!enabled)
+    return FALSE;
+
+  return TraceLog::GetInstance()->Start(Utf8Conv::Utf8ToUtf16(path), enabled);
+}
+
+EV_EXPORTS(StopTracing, BOOL)() {
+  return TraceLog::GetInstance()->Stop();
+}
+
+}  // namespace edgeview
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+
+#include "util.h"
+
+namespace edgeview {
+
+// Categories accepted by edgeview_StartTracing, as a bit mask
+enum TraceCategory : uint32_t {
+  kTraceTasks = 1 << 0,      // "task": posting and running ui thread tasks
+  kTraceHostCalls = 1 << 1,  // "host": dispatcher methods calling into E
+};
+
+// Enabled categories, 0 while no trace is being recorded
+extern std::atomic<uint32_t> g_trace_categories;
+
+inline bool TraceEnabled(TraceCategory category) {
+  return g_trace_categories.load(std::memory_order_relaxed) & category;
+}
+
+// Phases of the Trace Event Format used here: 'B'/'E' open and close a slice
+// on the calling thread, 's'/'f' start and finish the flow arrow |id|.
+// |name| must be a string with static storage, a std::source_location
+// function name is shortened when written out. |browser| tags the event.
+// Safe to call from any thread, never blocks.
+void AddTraceEvent(char phase,
+                   TraceCategory category,
+                   const char* name,
+                   uint64_t id = 0,
+                   const void* browser = nullptr);
+
+// Id for a new flow, unique within the process
+uint64_t NextTraceFlowId();
+
+// Streams the events into |path| as JSON for chrome://tracing or Perfetto.
+// |categories| is a comma separated list of the names above, empty or "*"
+// records all of them.
+EV_EXPORTS(StartTracing, BOOL)(LPCSTR path, LPCSTR categories);
+// Writes out the events recorded so far and closes the file
+EV_EXPORTS(StopTracing, BOOL)();
+
+}  // namespace edgeview
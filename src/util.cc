@@ -2,14 +2,19 @@
 
 #include <atlconv.h>
 
+#include "mem_accounting.h"
+
 namespace edgeview {
 
-LPSTR WrapComString(LPCWSTR oriStr) {
+namespace {
+
+LPSTR WrapComStringAt(LPCWSTR oriStr, const void* site) {
   if (!oriStr) return nullptr;
   INT wideStrLen = wcslen(oriStr);
   INT utf8Len =
       WideCharToMultiByte(CP_UTF8, 0, oriStr, wideStrLen, NULL, 0, NULL, NULL);
-  LPSTR utf8Str = static_cast<LPSTR>(edgeview_MemAlloc(utf8Len + 1));
+  LPSTR utf8Str = static_cast<LPSTR>(
+      AccountedAlloc(utf8Len + 1, AllocCategory::kString, site));
   if (!utf8Str) return nullptr;
   WideCharToMultiByte(CP_UTF8, 0, oriStr, wideStrLen, utf8Str, utf8Len, NULL,
                       NULL);
@@ -17,20 +22,28 @@ LPSTR WrapComString(LPCWSTR oriStr) {
   return utf8Str;
 }
 
+}  // namespace
+
+LPSTR WrapComString(LPCWSTR oriStr) {
+  return WrapComStringAt(oriStr, _ReturnAddress());
+}
+
 LPSTR WrapComString(LPCSTR oriStr) {
   size_t s = strlen(oriStr);
-  LPSTR pstr = (LPSTR)edgeview_MemAlloc(s + 1);
+  LPSTR pstr = (LPSTR)AccountedAlloc(s + 1, AllocCategory::kString,
+                                     _ReturnAddress());
   RtlCopyMemory(pstr, oriStr, s);
 
   return pstr;
 }
 
 LPSTR WrapComString(const wil::unique_cotaskmem_string& str) {
-  return WrapComString(str.get());
+  return WrapComStringAt(str.get(), _ReturnAddress());
 }
 
 LPBYTE WrapEStream(const std::string& mem) {
-  LPBYTE ptr = (LPBYTE)edgeview_MemAlloc(mem.size() + 4);
+  LPBYTE ptr = (LPBYTE)AccountedAlloc(mem.size() + 4, AllocCategory::kBuffer,
+                                      _ReturnAddress());
 
   *(int*)ptr = mem.size();
   memcpy(ptr + 4, mem.data(), mem.size());
@@ -68,44 +81,11 @@ void FreeAryElement(void* pAryData) {
 }
 
 EV_EXPORTS(MemAlloc, LPVOID)(size_t size) {
-  return ::HeapAlloc(::GetProcessHeap(), HEAP_ZERO_MEMORY, size);
+  return AccountedAlloc(size, AllocCategory::kRaw, _ReturnAddress());
 }
 
 EV_EXPORTS(MemFree, BOOL)(LPVOID mem) {
-  return ::HeapFree(::GetProcessHeap(), 0, mem);
-}
-
-std::vector<std::string> SplitString(const std::string& str,
-                                     const std::string& delimiter) {
-  std::vector<std::string> result;
-  std::string::size_type start = 0;
-  std::string::size_type end = str.find(delimiter, start);
-
-  while (end != std::string::npos) {
-    result.push_back(str.substr(start, end - start));
-    start = end + delimiter.length();
-    end = str.find(delimiter, start);
-  }
-
-  result.push_back(str.substr(start));
-
-  return result;
-}
-
-std::string TrimString(const std::string& str) {
-  std::string result = str;
-
-  size_t start = result.find_first_not_of(" \t\n\r\f\v");
-  if (start != std::string::npos) {
-    result = result.substr(start);
-  }
-
-  size_t end = result.find_last_not_of(" \t\n\r\f\v");
-  if (end != std::string::npos) {
-    result = result.substr(0, end + 1);
-  }
-
-  return result;
+  return AccountedFree(mem);
 }
 
 }  // namespace edgeview
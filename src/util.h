@@ -15,6 +15,7 @@
 #include "WebView2.h"
 #include "WebView2EnvironmentOptions.h"
 #include "nlohmann/json.hpp"
+#include "string_util.h"
 
 using namespace Microsoft;
 using json = nlohmann::json;
@@ -40,9 +41,4 @@ EV_EXPORTS(MemFree, BOOL)(LPVOID mem);
 LPBYTE GetAryElementInf(void* pAryData, LPINT pnElementCount);
 void FreeAryElement(void* pAryData);
 
-std::vector<std::string> SplitString(const std::string& str,
-                                     const std::string& delimiter);
-
-std::string TrimString(const std::string& str);
-
 }  // namespace edgeview
@@ -0,0 +1,102 @@
+#include "webview_cdp_backend.h"
+
+#include <memory>
+
+namespace edgeview {
+
+namespace {
+
+class WebViewCDPBackend : public CDPBackend {
+ public:
+  WebViewCDPBackend(const void* browser,
+                    WRL::ComPtr<ICoreWebView2_16> webview)
+      : CDPBackend(browser), webview(webview) {}
+
+ protected:
+  void SendMethod(const std::string& method,
+                  const std::string& params,
+                  const std::string& session,
+                  ReplyCallback callback) override {
+    WRL::ComPtr<ICoreWebView2CallDevToolsProtocolMethodCompletedHandler>
+        handler = nullptr;
+    if (callback) {
+      // The COM handler needs a copyable functor
+      auto reply = std::make_shared<ReplyCallback>(std::move(callback));
+      handler = WRL::Callback<
+          ICoreWebView2CallDevToolsProtocolMethodCompletedHandler>(
+          [reply](HRESULT errorCode, LPCWSTR returnObjectAsJson) {
+            if (*reply) {
+              std::move(*reply).Run(
+                  errorCode, returnObjectAsJson
+                                 ? Utf8Conv::Utf16ToUtf8(returnObjectAsJson)
+                                 : std::string());
+            }
+            return S_OK;
+          });
+    }
+
+    if (session.empty()) {
+      webview->CallDevToolsProtocolMethod(
+          Utf8Conv::Utf8ToUtf16(method).c_str(),
+          Utf8Conv::Utf8ToUtf16(params).c_str(), handler.Get());
+    } else {
+      webview->CallDevToolsProtocolMethodForSession(
+          Utf8Conv::Utf8ToUtf16(session).c_str(),
+          Utf8Conv::Utf8ToUtf16(method).c_str(),
+          Utf8Conv::Utf8ToUtf16(params).c_str(), handler.Get());
+    }
+  }
+
+  void SubscribeEvent(const std::string& event) override {
+    WRL::ComPtr<ICoreWebView2DevToolsProtocolEventReceiver> receiver =
+        nullptr;
+    webview->GetDevToolsProtocolEventReceiver(
+        Utf8Conv::Utf8ToUtf16(event).c_str(), &receiver);
+    if (!receiver)
+      return;
+
+    // Weak, the webview holds the handler and outlives a swapped backend
+    receiver->add_DevToolsProtocolEventReceived(
+        WRL::Callback<ICoreWebView2DevToolsProtocolEventReceivedEventHandler>(
+            [weak_ptr = GetWeakPtr(), event](
+                ICoreWebView2* sender,
+                ICoreWebView2DevToolsProtocolEventReceivedEventArgs* args) {
+              if (!weak_ptr)
+                return S_OK;
+
+              WRL::ComPtr<ICoreWebView2DevToolsProtocolEventReceivedEventArgs2>
+                  event_args = nullptr;
+              args->QueryInterface<
+                  ICoreWebView2DevToolsProtocolEventReceivedEventArgs2>(
+                  &event_args);
+
+              wil::unique_cotaskmem_string raw_json = nullptr;
+              event_args->get_ParameterObjectAsJson(&raw_json);
+              wil::unique_cotaskmem_string raw_session = nullptr;
+              event_args->get_SessionId(&raw_session);
+
+              weak_ptr->DispatchEvent(
+                  event, Utf8Conv::Utf16ToUtf8(raw_json.get()),
+                  Utf8Conv::Utf16ToUtf8(raw_session.get()));
+
+              return S_OK;
+            })
+            .Get(),
+        nullptr);
+  }
+
+ private:
+  ~WebViewCDPBackend() override = default;
+
+  WRL::ComPtr<ICoreWebView2_16> webview;
+};
+
+}  // namespace
+
+scoped_refptr<CDPBackend> CreateWebViewCDPBackend(
+    const void* browser,
+    WRL::ComPtr<ICoreWebView2_16> webview) {
+  return base::MakeRefCounted<WebViewCDPBackend>(browser, webview);
+}
+
+}  // namespace edgeview
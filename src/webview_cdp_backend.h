@@ -0,0 +1,14 @@
+#pragma once
+
+#include "cdp_backend.h"
+#include "util.h"
+
+namespace edgeview {
+
+// CDPBackend over the DevTools protocol methods and event receivers of
+// |webview|. |browser| identifies the page to the traffic observer.
+scoped_refptr<CDPBackend> CreateWebViewCDPBackend(
+    const void* browser,
+    WRL::ComPtr<ICoreWebView2_16> webview);
+
+}  // namespace edgeview